@@ -0,0 +1,216 @@
+#ifndef AABB_TREE_HPP_INCLUDED
+#define AABB_TREE_HPP_INCLUDED
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "trillek.hpp"
+#include "graphics/frustum.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief An axis aligned bounding box
+ */
+struct AABB {
+    AABB() : min(0.0f), max(0.0f) { }
+    AABB(const glm::vec3 &min, const glm::vec3 &max) : min(min), max(max) { }
+
+    /**
+     * \brief The box around this box once transformed by a matrix.
+     */
+    AABB Transform(const glm::mat4 &matrix) const;
+
+    AABB Union(const AABB &other) const {
+        return AABB(glm::min(this->min, other.min), glm::max(this->max, other.max));
+    }
+
+    bool Contains(const AABB &other) const {
+        return this->min.x <= other.min.x && this->min.y <= other.min.y && this->min.z <= other.min.z
+            && other.max.x <= this->max.x && other.max.y <= this->max.y && other.max.z <= this->max.z;
+    }
+
+    bool Overlaps(const AABB &other) const {
+        return this->min.x <= other.max.x && other.min.x <= this->max.x
+            && this->min.y <= other.max.y && other.min.y <= this->max.y
+            && this->min.z <= other.max.z && other.min.z <= this->max.z;
+    }
+
+    bool OverlapsSphere(const glm::vec3 &center, float radius) const {
+        glm::vec3 nearest = glm::min(glm::max(center, this->min), this->max);
+        glm::vec3 offset = nearest - center;
+        return glm::dot(offset, offset) <= radius * radius;
+    }
+
+    /**
+     * \brief Slab test of a ray given by its origin and inverse direction.
+     * \param float& distance receives the entry distance along the ray
+     * \return bool true if the ray enters the box between 0 and max_distance
+     */
+    bool IntersectRay(const glm::vec3 &origin, const glm::vec3 &inv_direction,
+        float max_distance, float &distance) const;
+
+    float SurfaceArea() const {
+        glm::vec3 size = this->max - this->min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+/**
+ * \brief A dynamic bounding volume hierarchy of entity boxes
+ *
+ * Leaves store a box enlarged by a margin, so small moves do not touch
+ * the tree. A leaf that leaves its enlarged box is removed and inserted
+ * again, and the branches are kept balanced with AVL rotations, giving
+ * queries of O(log n) plus the number of results.
+ */
+class AABBTree final {
+public:
+    static const int32_t NULL_NODE = -1;
+
+    /**
+     * \param float margin the distance the leaf boxes are enlarged by
+     */
+    explicit AABBTree(float margin = 0.25f);
+
+    /**
+     * \brief Insert the box of an entity.
+     * \return int32_t the proxy to move or destroy the entry with
+     */
+    int32_t CreateProxy(const AABB &box, id_t entity_id);
+
+    void DestroyProxy(int32_t proxy);
+
+    /**
+     * \brief Update the box of an entry.
+     * \return bool true if the entry had to be inserted again
+     */
+    bool MoveProxy(int32_t proxy, const AABB &box);
+
+    id_t GetEntity(int32_t proxy) const { return this->nodes[proxy].entity_id; }
+    const AABB& GetFatBox(int32_t proxy) const { return this->nodes[proxy].box; }
+    size_t Size() const { return this->proxy_count; }
+    int32_t GetHeight() const {
+        return this->root == NULL_NODE ? 0 : this->nodes[this->root].height;
+    }
+
+    /**
+     * \brief Call func(entity_id) for each entry whose box overlaps the box.
+     */
+    template<class F>
+    void QueryBox(const AABB &box, F func) const {
+        Query([&box] (const AABB &node_box) { return node_box.Overlaps(box); }, func);
+    }
+
+    /**
+     * \brief Call func(entity_id) for each entry whose box overlaps the sphere.
+     */
+    template<class F>
+    void QuerySphere(const glm::vec3 &center, float radius, F func) const {
+        Query([&center, radius] (const AABB &node_box) {
+            return node_box.OverlapsSphere(center, radius);
+        }, func);
+    }
+
+    /**
+     * \brief Call func(entity_id) for each entry whose box may be inside the frustum.
+     */
+    template<class F>
+    void QueryFrustum(const Frustum &frustum, F func) const {
+        Query([&frustum] (const AABB &node_box) {
+            return frustum.TestBox(node_box.min, node_box.max);
+        }, func);
+    }
+
+    /**
+     * \brief Walk the entries whose box is hit by a ray.
+     *
+     * func(entity_id, distance) receives the entry distance of the ray in
+     * the box and returns the new maximum distance: max_distance to keep
+     * going, the distance of an exact hit to only look for closer hits,
+     * or 0 to stop.
+     * \param glm::vec3 direction the ray direction, distances are in its units
+     */
+    template<class F>
+    void RayCast(const glm::vec3 &origin, const glm::vec3 &direction, float max_distance, F func) const {
+        if(this->root == NULL_NODE) {
+            return;
+        }
+        const glm::vec3 inv_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        std::vector<int32_t> stack;
+        stack.push_back(this->root);
+        while(!stack.empty() && max_distance > 0.0f) {
+            const Node &node = this->nodes[stack.back()];
+            stack.pop_back();
+            float distance;
+            if(!node.box.IntersectRay(origin, inv_direction, max_distance, distance)) {
+                continue;
+            }
+            if(node.IsLeaf()) {
+                max_distance = std::min(max_distance, static_cast<float>(func(node.entity_id, distance)));
+            }
+            else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+private:
+    struct Node {
+        bool IsLeaf() const { return this->child1 == NULL_NODE; }
+
+        AABB box; // enlarged by the margin for leaves
+        int32_t parent; // next free node when the node is free
+        int32_t child1;
+        int32_t child2;
+        int32_t height; // 0 for leaves, -1 for free nodes
+        id_t entity_id;
+    };
+
+    template<class T, class F>
+    void Query(T test, F func) const {
+        if(this->root == NULL_NODE) {
+            return;
+        }
+        std::vector<int32_t> stack;
+        stack.push_back(this->root);
+        while(!stack.empty()) {
+            const Node &node = this->nodes[stack.back()];
+            stack.pop_back();
+            if(!test(node.box)) {
+                continue;
+            }
+            if(node.IsLeaf()) {
+                func(node.entity_id);
+            }
+            else {
+                stack.push_back(node.child1);
+                stack.push_back(node.child2);
+            }
+        }
+    }
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t index);
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    void Refit(int32_t index);
+    int32_t Balance(int32_t index);
+
+    std::vector<Node> nodes;
+    int32_t root;
+    int32_t free_list;
+    size_t proxy_count;
+    float margin;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef ANIMATION_CLIP_HPP_INCLUDED
+#define ANIMATION_CLIP_HPP_INCLUDED
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "graphics/matrix-store.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief The bone matrices of every frame of an animation, baked once
+ *
+ * Each bone matrix of a frame is kept as a rotation and a translation, so
+ * the pose between two frames is built straight into the caller's matrices.
+ * The baked matrices already hold the inverse bind pose, so it costs nothing
+ * when a pose is sampled. A clip is never changed once built, so it can be
+ * sampled from any thread.
+ *
+ * The tracks are compressed. A rotation takes 48 bits, its three smallest
+ * components with the index of the largest one, which is rebuilt from
+ * them. A translation takes 16 bits per component, within the range of its
+ * track. The bones that do not move keep one matrix for the whole clip. The
+ * moving tracks of a frame are stored as arrays of components, decoded and
+ * sampled 4 tracks at a time with SSE2 when it is available.
+ *
+ * Most bones hang from a joint of another bone, the point b of the bone
+ * stays on the point a of the other one, so their translation follows from
+ * the rotations: M_other a - R b. These pinned tracks keep no translation,
+ * it is rebuilt once the other bone is sampled.
+ */
+class AnimationClip final {
+public:
+    typedef std::vector<float, AlignedAllocator<float, 16>> float_array;
+
+    /**
+     * \brief Bake a clip from the bone matrices of each frame.
+     *
+     * The matrices must be rigid, a rotation and a translation.
+     * \param size_t bone_count the matrices per frame
+     * \param float frame_rate the frames per second
+     * \param const std::vector<glm::mat4>& matrices bone_count matrices per frame, frame after frame
+     */
+    AnimationClip(size_t bone_count, float frame_rate, const std::vector<glm::mat4> &matrices);
+
+    AnimationClip(const AnimationClip &) = delete;
+    AnimationClip& operator=(const AnimationClip &) = delete;
+
+    /**
+     * \brief Tells the clips apart, an id is never given to another clip.
+     *
+     * A clip built where a freed one was has the same address, not the same id.
+     */
+    uint32_t GetId() const { return this->id; }
+
+    size_t GetBoneCount() const { return this->bone_count; }
+    size_t GetFrameCount() const { return this->frame_count; }
+    float GetFrameRate() const { return this->frame_rate; }
+
+    /**
+     * \brief The number of bones moving during the clip.
+     */
+    size_t GetTrackCount() const { return this->track_bones.size(); }
+
+    /**
+     * \brief The number of moving bones whose translation follows from another bone.
+     */
+    size_t GetPinnedCount() const { return this->pin_bones.size(); }
+
+    /**
+     * \brief How far a bone matrix of the clip moves the origin of the model, at most.
+     *
+     * The bones are rigid, so a vertex within a sphere of center c and
+     * radius r stays within r + 2 |c| + GetReach() of c once skinned.
+     */
+    float GetReach() const { return this->reach; }
+
+    /**
+     * \brief The bytes taken by the tracks and the still bones.
+     */
+    size_t GetMemorySize() const;
+
+    /**
+     * \brief Write the bone matrices of a pose between two frames.
+     *
+     * The rotations are blended by normalized lerp on the shortest path.
+     * \param size_t frame0 the frame of the pose at blend 0
+     * \param size_t frame1 the frame of the pose at blend 1
+     * \param float blend how far the pose is from frame0 to frame1
+     * \param glm::mat4* out GetBoneCount() matrices to write
+     */
+    void Sample(size_t frame0, size_t frame1, float blend, glm::mat4 *out) const;
+
+private:
+    /**
+     * \brief Sample the tracks in [first, last), all with a translation or all pinned.
+     *
+     * The pinned tracks get their rotation only.
+     */
+    void SampleTracks(size_t frame0, size_t frame1, float blend, size_t first, size_t last, glm::mat4 *out) const;
+
+    /**
+     * \brief Sample one track, for the tracks left after the groups of 4.
+     */
+    void SampleScalar(size_t frame0, size_t frame1, float blend, size_t track, glm::mat4 *out) const;
+
+    uint32_t id;
+    size_t bone_count;
+    size_t frame_count;
+    float frame_rate;
+    float reach;
+
+    std::vector<uint32_t> still_bones;
+    std::vector<glm::mat4> still_matrices;
+
+    std::vector<uint32_t> track_bones; // the bone of each track, the pinned tracks last, by bone
+    size_t translation_count; // the tracks before the pinned ones
+    std::vector<uint16_t> r0, r1, r2; // the smallest three, track_bones.size() per frame, frame after frame
+    std::vector<uint16_t> tx, ty, tz; // translation_count per frame
+    float_array min_x, min_y, min_z; // the translation range of each track
+    float_array step_x, step_y, step_z;
+
+    std::vector<int32_t> pin_bones; // the other bone of each pinned track, -1 for the model
+    std::vector<glm::vec4> pin_points; // (a, 1), on the other bone
+    std::vector<glm::vec4> pin_offsets; // (b, 0), on the bone of the track
+
+    static std::atomic<uint32_t> next_id;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
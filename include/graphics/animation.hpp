@@ -1,10 +1,12 @@
 #ifndef ANIMATION_HPP_INCLUDED
 #define ANIMATION_HPP_INCLUDED
 
+#include <cstdint>
 #include <vector>
 #include <memory>
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
+#include "graphics/animation-clip.hpp"
 
 namespace trillek {
 namespace resource {
@@ -15,39 +17,81 @@ class MD5Anim;
 
 namespace graphics {
 
+/**
+ * \brief How often and how finely the pose of an animation follows its time
+ */
+struct AnimationLOD {
+    uint32_t interval; // frames between two updates of the pose, 0 to hold it
+    bool snap; // pose on the nearest key frame instead of between two
+};
+
 class Animation final {
 public:
-    Animation() : animation_time(0.0f) { }
+    Animation() : current_frame_index(0), frame_count(0), frame_blend(0.0f), animation_time(0.0f),
+        frame_duration(0.0f), frame_rate(0.0f), pose_frame(0), pose_blend(0.0f), pose_stale(true),
+        lod_visible(true), lod_distance(0.0f), pose_request(~0u) { }
 
     /**
     * \brief Updates the current animation based on a change in time.
     *
+    * Only moves the time, the pose at that time is evaluated by the pose
+    * cache of the render system, once for all the animations sharing it.
     * \param[in] float delta The change in time
     * \return void
     */
     void UpdateAnimation(const float delta);
 
+    /**
+    * \brief Choose the time of the pose drawn this frame.
+    *
+    * The pose follows the time on the frames where (frame + phase) is a
+    * multiple of lod.interval, and is held in between. A pose held with
+    * an interval of 0 follows the time again as soon as the interval is not 0.
+    * \param[in] const AnimationLOD& lod the tier of the animation
+    * \param[in] uint64_t frame the number of the frame
+    * \param[in] uint32_t phase spreads the animations of a tier over its frames
+    * \return void
+    */
+    void UpdatePose(const AnimationLOD &lod, uint64_t frame, uint32_t phase);
+
     /**
     * \brief Sets the animation file for this animation.
     *
-    * This does a run for the first set of animation from frame 0 to 1 with time 0.
     * \param[in] std::shared_ptr<resource::MD5Anim> file The animation file.
     * \return void
     */
     void SetAnimationFile(std::shared_ptr<resource::MD5Anim> file);
 
-    friend class RenderSystem;
-private:
-    std::vector<glm::mat4> animation_matricies;
+    /**
+    * \brief Sets the clip this animation plays.
+    *
+    * \param[in] std::shared_ptr<const AnimationClip> clip The clip, null to stop playing.
+    * \return void
+    */
+    void SetClip(std::shared_ptr<const AnimationClip> clip);
 
-    std::shared_ptr<resource::MD5Anim> animation_file;
+    friend class DrawFrame;
+private:
+    std::shared_ptr<const AnimationClip> clip;
 
     size_t current_frame_index;
     size_t frame_count;
+    float frame_blend; // from the current frame to the next one
 
     float animation_time;
     float frame_duration;
     float frame_rate;
+
+    // the time of the pose drawn
+    size_t pose_frame;
+    float pose_blend;
+    bool pose_stale; // held while culled, updated on the next frame it is seen
+
+    // set by the render system from the last culling, to choose the tier
+    bool lod_visible; // drawn by the camera or a shadow view
+    float lod_distance; // from the camera to the closest of its meshes
+
+    uint32_t pose_request; // in the pose cache, for the frame being built
 };
 
 } // End of graphics
@@ -0,0 +1,98 @@
+#ifndef BONE_PALETTE_HPP_INCLUDED
+#define BONE_PALETTE_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include <glm/glm.hpp>
+#include "graphics/stream-buffer.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief Texture unit the bone palettes are bound to during the geometry passes.
+ *
+ * The last of the 16 units GL 3.x guarantees, the materials count from 0.
+ */
+static const GLuint BONE_PALETTE_UNIT = 15;
+
+/**
+ * \brief GLSL declaration of the palette buffer texture, added to the shaders asking for it.
+ *
+ * A palette is given to a draw as the texel of its first matrix, -1 for
+ * meshes without animation.
+ */
+static const char BONE_PALETTE_SOURCE[] =
+    "uniform samplerBuffer bone_palettes;\n"
+    "mat4 BoneMatrix(int palette, int bone) {\n"
+    "    int texel = palette + bone * 4;\n"
+    "    return mat4(texelFetch(bone_palettes, texel), texelFetch(bone_palettes, texel + 1),\n"
+    "        texelFetch(bone_palettes, texel + 2), texelFetch(bone_palettes, texel + 3));\n"
+    "}\n";
+
+/**
+ * \brief The bone matrices of every animated mesh drawn in a frame
+ *
+ * The palettes are packed in a stream buffer, read by the shaders through
+ * one RGBA32F buffer texture covering the whole buffer. Each matrix takes
+ * 4 texels, one per column.
+ */
+class BonePaletteBuffer final {
+public:
+    BonePaletteBuffer();
+    ~BonePaletteBuffer();
+
+    BonePaletteBuffer(const BonePaletteBuffer &) = delete;
+    BonePaletteBuffer& operator=(const BonePaletteBuffer &) = delete;
+
+    /**
+     * \brief Create the buffer and its texture, needs a current context.
+     *
+     * \param size_t matrix_count the matrices a frame holds before the buffer grows
+     * \return bool true when the buffer is persistently mapped
+     */
+    bool Create(size_t matrix_count);
+
+    /**
+     * \brief Take the storage of the palettes of a new frame.
+     *
+     * \param size_t matrix_count the matrices of all the palettes of the frame
+     * \return glm::mat4* where to write the matrices, null if they don't fit the buffer texture
+     */
+    glm::mat4* BeginFrame(size_t matrix_count);
+
+    /**
+     * \brief The texel of a matrix written in the storage given by the last BeginFrame().
+     */
+    GLint GetTexel(size_t matrix_index) const {
+        return static_cast<GLint>(this->range.offset / sizeof(glm::vec4) + matrix_index * 4);
+    }
+
+    /**
+     * \brief Make the palettes visible to GL, before the draws reading them.
+     */
+    void Commit() const;
+
+    /**
+     * \brief Bind the buffer texture to a texture unit.
+     */
+    void Bind(GLuint unit) const;
+
+    /**
+     * \brief Fence the palettes of the frame, after the draws reading them were submitted.
+     */
+    void EndFrame();
+
+    bool IsCreated() const { return this->texture != 0; }
+
+private:
+    StreamBuffer stream;
+    StreamBuffer::Range range; // palettes of the frame
+    GLuint texture;
+    GLuint texture_buffer; // buffer the texture points to, it changes when the stream grows
+    GLint max_texels;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef DRAW_FRAME_HPP_INCLUDED
+#define DRAW_FRAME_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "graphics/animation.hpp"
+#include "graphics/draw-list.hpp"
+#include "graphics/frustum.hpp"
+#include "graphics/gl-state.hpp"
+#include "graphics/matrix-store.hpp"
+#include "graphics/stream-buffer.hpp"
+#include "graphics/bone-palette.hpp"
+#include "graphics/pose-cache.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief Uniform and attribute locations used to draw packets with a shader
+ *
+ * Resolved once per link of the shader, link_id tells which link.
+ */
+struct DrawBindings {
+    DrawBindings() : link_id(0), view(-1), projection(-1), model(-1), palette(-1), bone_palettes(-1),
+        animated(-1), instance_model(-1), instance_palette(-1), light_pos(-1), light_vp(-1) { }
+
+    uint32_t link_id;
+    GLint view;
+    GLint projection;
+    GLint model;
+    GLint palette; // first texel of the bone palette, without the instance_palette attribute
+    GLint bone_palettes; // the sampler of BONE_PALETTE_SOURCE
+    GLint animated;
+    GLint instance_model; // first of 4 vec4 attributes, -1 if not instanced
+    GLint instance_palette; // int attribute, first texel of the bone palette of the instance
+    GLint light_pos; // depth pass only
+    GLint light_vp;
+};
+
+/**
+ * \brief The camera the passes of a frame are built for
+ */
+struct DrawCamera {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 position; // world space
+    float viewport_height; // pixels
+    float near_plane;
+    float far_plane; // also the range of the draw packet depths
+};
+
+/**
+ * \brief A shadow casting light with a tile of the shadow atlas
+ */
+struct ShadowView {
+    glm::vec3 light_pos;
+    glm::mat4 light_matrix; // view projection of the light
+    glm::vec4 tile; // x, y and side in the atlas
+    DrawPass pass; // the animated casters, drawn every frame
+    DrawPass static_pass; // the other casters, empty when the cache is up to date
+    bool refresh_static;
+    std::vector<uint8_t> visible; // culling results of the last frame, per sorted packet
+    std::vector<uint8_t> static_visible;
+};
+
+/**
+ * \brief The draw list of a scene, and the passes drawing it each frame
+ *
+ * Each frame the animations move and ask for their pose, then Build()
+ * keys, sorts and culls the packets for the camera and the shadow views,
+ * packs the bone palettes and gathers the instances. The passes are then
+ * submitted with SubmitPass(). The callers own the shaders, the lights
+ * and the camera, the render system and the benchmarks both draw through
+ * this class.
+ */
+class DrawFrame final {
+public:
+    static const size_t ANIMATION_LOD_COUNT = 4;
+
+    /**
+     * \param ModelMatrixStore& model_matrices the matrices of the entities, read by each frame
+     */
+    explicit DrawFrame(ModelMatrixStore &model_matrices);
+
+    DrawFrame(const DrawFrame &) = delete;
+    DrawFrame& operator=(const DrawFrame &) = delete;
+
+    /**
+     * \brief Where each animation tier after the first starts, in increasing order.
+     */
+    void SetAnimationLODDistances(const std::vector<float> &distances) { this->animation_lod_distances = distances; }
+
+    /**
+     * \brief The simplification error a mesh level may show, in pixels, 0 always draws the full meshes.
+     */
+    void SetMeshLODPixels(float pixels) { this->mesh_lod_pixels = pixels; }
+
+    /**
+     * \brief Forget the poses asked for by the previous frame.
+     */
+    void BeginAnimations();
+
+    /**
+     * \brief Move the time of an animation, then ask for its pose at the rate of its tier.
+     *
+     * \param Animation& animation the animation, it must live until the next BeginAnimations()
+     * \param float delta seconds since the last frame
+     * \param uint32_t phase spreads the animations of a tier over its frames
+     */
+    void UpdateAnimation(Animation &animation, float delta, uint32_t phase);
+
+    /**
+     * \brief Evaluate each distinct pose asked for once, split between threads.
+     */
+    void EvaluatePoses();
+
+    /**
+     * \brief Key, sort and cull the packets, then gather their palettes and instances.
+     *
+     * The passes of the camera and of each shadow view are rebuilt. The
+     * shadow views must be set before, the static casters of a view are
+     * only batched when its refresh_static is set.
+     * \param const DrawCamera& camera the camera of the frame
+     */
+    void Build(const DrawCamera &camera);
+
+    /**
+     * \brief Make the instances and the palettes of the frame visible to GL, before the passes.
+     */
+    void Commit() const;
+
+    /**
+     * \brief Bind the bone palettes to BONE_PALETTE_UNIT, if they were created.
+     */
+    void BindBonePalettes() const;
+
+    /**
+     * \brief Draw the batches of a pass, binding the mesh of each one.
+     *
+     * \param const DrawPass& pass a pass of the last Build()
+     * \param const Use& use called with the first packet of each batch,
+     * it makes its shader current and returns its DrawBindings
+     */
+    template<class Use>
+    void SubmitPass(const DrawPass &pass, const Use &use) const {
+        GLuint vao = 0;
+        for(const auto &batch : pass.batches) {
+            const DrawPacket &head = this->draw_list[pass.packets[batch.first_packet]];
+            const DrawBindings &bindings = use(head);
+            if(head.vao != vao) {
+                vao = head.vao;
+                GLState::BindVertexArray(vao);
+                GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, head.ibo);
+            }
+            SubmitBatch(pass, batch, bindings);
+        }
+    }
+
+    /**
+     * \brief Draws a batch of packets, with one instanced call when the shader allows it.
+     *
+     * The VAO and index buffer of the first packet must be bound.
+     */
+    void SubmitBatch(const DrawPass &pass, const DrawBatch &batch, const DrawBindings &bindings) const;
+
+    /**
+     * \brief Fence the instances and the palettes of the frame, after the passes were submitted.
+     */
+    void EndFrame() const;
+
+    DrawList& GetDrawList() { return this->draw_list; }
+    const DrawList& GetDrawList() const { return this->draw_list; }
+
+    /**
+     * \brief The packets the camera sees.
+     */
+    const DrawPass& GetColorPass() const { return this->color_pass; }
+
+    /**
+     * \brief The views of the shadow casting lights, set by the caller before Build().
+     */
+    std::vector<ShadowView>& GetShadowViews() { return this->shadow_views; }
+    const std::vector<ShadowView>& GetShadowViews() const { return this->shadow_views; }
+
+    /**
+     * \brief The model matrices of the instanced batches, created by the caller to draw instances.
+     */
+    StreamBuffer& GetInstanceStream() { return this->instance_stream; }
+
+    /**
+     * \brief The palettes of the animated packets, created by the caller to draw them posed.
+     */
+    BonePaletteBuffer& GetBonePalettes() { return this->bone_palettes; }
+
+    /**
+     * \brief The palette matrices of the last Build() that did not fit the buffer texture.
+     *
+     * The animated packets are then drawn in their bind pose.
+     */
+    size_t GetPaletteOverflow() const { return this->palette_overflow; }
+
+private:
+    /**
+     * \brief The tier of an animation, from what the last culling found of it.
+     */
+    AnimationLOD GetAnimationLOD(const Animation &animation) const;
+
+    /**
+     * \brief Pack the bone matrices of the animated packets in the palette buffer,
+     * and find the first texel of the palette of each sorted packet.
+     */
+    void UpdateBonePalettes();
+
+    ModelMatrixStore &model_matrices;
+    DrawList draw_list;
+    BoundingSpheres world_bounds; /// bounds of the sorted packets
+    std::vector<uint8_t> visible; /// visibility of the sorted packets by the camera
+    DrawPass color_pass;
+    std::vector<ShadowView> shadow_views;
+    // The streams are written by Build(), then committed and fenced around the passes.
+    mutable StreamBuffer instance_stream; /// per frame model matrices of the instanced batches
+    StreamBuffer::Range instance_range; /// the instances of the frame being built
+    StreamBuffer::Range instance_palette_range; /// their palette texels, after the matrices
+    mutable BonePaletteBuffer bone_palettes; /// the palettes of the frame being built
+    std::vector<GLint> palette_texels; /// first palette texel of the sorted packets, -1 without animation
+    std::vector<GLint> pose_palettes; /// first palette matrix of each pose, -1 if no packet is drawn with it
+    size_t palette_overflow;
+    PoseCache pose_cache; /// the poses of the animations of the frame being built
+    std::vector<float> animation_lod_distances;
+    uint64_t animation_frame; /// counts the frames, to spread the reduced rate updates
+    float mesh_lod_pixels;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
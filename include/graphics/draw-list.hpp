@@ -0,0 +1,219 @@
+#ifndef DRAW_LIST_HPP_INCLUDED
+#define DRAW_LIST_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include "trillek.hpp"
+#include "graphics/matrix-store.hpp"
+#include "graphics/mesh-simplifier.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+class Animation;
+
+/**
+ * \brief A single draw of one buffer group for one entity
+ *
+ * Everything the render passes need is stored inline, so walking
+ * the packets does not touch the Renderable or its buffer groups.
+ */
+struct DrawPacket {
+    uint64_t sort_key;
+    id_t entity_id;
+    MatrixSlot matrix; // slot of the entity in the model matrix store
+    uint32_t material_index; // index into RenderSystem::material_groups
+    uint32_t texture_set; // index into MaterialGroup::texture_sets
+    GLuint vao;
+    GLuint ibo;
+    unsigned int ibo_first; // first index of the level drawn
+    unsigned int ibo_count;
+    Animation *animation; // owned by the Renderable, null if not animated
+    glm::vec4 bounds; // bounding sphere in model space, center and radius
+    const MeshLevel *levels; // owned by the buffer group, null if it has a single level
+    uint32_t level_count;
+    uint32_t level; // the level drawn, chosen each frame
+};
+
+/**
+ * \brief A run of consecutive packets that can be drawn with one call
+ */
+struct DrawBatch {
+    uint32_t first_packet; // index into DrawPass::packets
+    uint32_t packet_count;
+    uint32_t instance_offset; // first model matrix of the run in the instance buffer
+};
+
+/**
+ * \brief The packets of a draw list visible from one view, grouped in batches
+ */
+struct DrawPass {
+    std::vector<uint32_t> packets; // indices into the draw list, in key order
+    std::vector<DrawBatch> batches;
+};
+
+/**
+ * \brief A flat array of draw packets ordered by a 64 bit sort key
+ *
+ * Key layout, from the most significant bits:
+ * pass (4), shader (12), texture set (12), mesh (14), level (2), depth (20).
+ * Packets are added and removed as components come and go, and the
+ * array is radix sorted once per frame after the depths are updated.
+ */
+class DrawList final {
+public:
+    static const unsigned int PASS_BITS = 4;
+    static const unsigned int SHADER_BITS = 12;
+    static const unsigned int TEXTURE_BITS = 12;
+    static const unsigned int MESH_BITS = 14;
+    static const unsigned int LEVEL_BITS = 2;
+    static const unsigned int DEPTH_BITS = 20;
+
+    static const unsigned int DEPTH_SHIFT = 0;
+    static const unsigned int LEVEL_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+    static const unsigned int MESH_SHIFT = LEVEL_SHIFT + LEVEL_BITS;
+    static const unsigned int TEXTURE_SHIFT = MESH_SHIFT + MESH_BITS;
+    static const unsigned int SHADER_SHIFT = TEXTURE_SHIFT + TEXTURE_BITS;
+    static const unsigned int PASS_SHIFT = SHADER_SHIFT + SHADER_BITS;
+
+    static const uint64_t DEPTH_MASK = ((1ull << DEPTH_BITS) - 1) << DEPTH_SHIFT;
+    static const uint64_t LEVEL_MASK = ((1ull << LEVEL_BITS) - 1) << LEVEL_SHIFT;
+
+    /**
+     * \brief Builds a sort key from its fields, each field is truncated to its width.
+     *
+     * The level starts at 0, it is set with SetLevel().
+     */
+    static uint64_t MakeKey(uint32_t pass, uint32_t shader, uint32_t texture_set,
+        uint32_t mesh, uint32_t depth) {
+        return (static_cast<uint64_t>(pass & ((1u << PASS_BITS) - 1)) << PASS_SHIFT)
+            | (static_cast<uint64_t>(shader & ((1u << SHADER_BITS) - 1)) << SHADER_SHIFT)
+            | (static_cast<uint64_t>(texture_set & ((1u << TEXTURE_BITS) - 1)) << TEXTURE_SHIFT)
+            | (static_cast<uint64_t>(mesh & ((1u << MESH_BITS) - 1)) << MESH_SHIFT)
+            | (static_cast<uint64_t>(depth & ((1u << DEPTH_BITS) - 1)) << DEPTH_SHIFT);
+    }
+
+    /**
+     * \brief Quantize a view space distance into the depth field of the key.
+     *
+     * \param float view_depth distance in front of the camera
+     * \param float far_plane the distance mapped to the largest depth value
+     * \return uint32_t the quantized depth, near objects have lower values
+     */
+    static uint32_t QuantizeDepth(float view_depth, float far_plane) {
+        const uint32_t max_depth = (1u << DEPTH_BITS) - 1;
+        if(!(view_depth > 0.0f)) {
+            return 0;
+        }
+        if(view_depth >= far_plane) {
+            return max_depth;
+        }
+        return static_cast<uint32_t>(view_depth / far_plane * max_depth);
+    }
+
+    /**
+     * \brief Replace the depth field of a packet key.
+     */
+    static void SetDepth(DrawPacket &packet, uint32_t depth) {
+        packet.sort_key = (packet.sort_key & ~DEPTH_MASK)
+            | (static_cast<uint64_t>(depth) << DEPTH_SHIFT & DEPTH_MASK);
+    }
+
+    /**
+     * \brief Draw another level of a packet.
+     *
+     * The level is part of the key, so the packets drawing the same level
+     * of a mesh sort and batch together.
+     * \param DrawPacket& packet the packet, the level must be one of its levels
+     * \param uint32_t level the level to draw
+     */
+    static void SetLevel(DrawPacket &packet, uint32_t level) {
+        if(!packet.levels || level >= packet.level_count) {
+            return;
+        }
+        packet.level = level;
+        packet.ibo_first = packet.levels[level].first_index;
+        packet.ibo_count = packet.levels[level].index_count;
+        packet.sort_key = (packet.sort_key & ~LEVEL_MASK)
+            | (static_cast<uint64_t>(level) << LEVEL_SHIFT & LEVEL_MASK);
+    }
+
+    /**
+     * \brief Append a packet, the list is out of order until the next Sort().
+     */
+    void Add(const DrawPacket &packet) {
+        this->packets.push_back(packet);
+    }
+
+    /**
+     * \brief Remove the packets an entity has now, those added after stay.
+     *
+     * The removal is only recorded, the packets stay in the list until the
+     * next Compact() or Sort(), so removing many entities in a frame costs
+     * a single pass over the list.
+     */
+    void Remove(const id_t entity_id) {
+        this->removals.push_back(std::make_pair(entity_id, this->packets.size()));
+    }
+
+    /**
+     * \brief Drop the packets of the removed entities.
+     *
+     * The relative order of the remaining packets is kept.
+     * \return size_t the number of dropped packets
+     */
+    size_t Compact();
+
+    /**
+     * \brief Sort the packets by key with a LSD radix sort, after a Compact().
+     *
+     * Byte passes where every key has the same value are skipped, so
+     * a frame where only the depths changed costs 3 passes.
+     */
+    void Sort();
+
+    /**
+     * \brief Group the visible packets that can share an instanced draw.
+     *
+     * Visible packets are batched when their keys only differ by depth,
+     * they draw the same material, textures and index range, and they are
+     * all animated or all static, since the animated ones also need their
+     * palette per instance. Only batches of more than one packet are
+     * given instance data, instance_offset counts those packets in order
+     * starting at first_instance. Must be called after Sort().
+     * \param const uint8_t* visible one flag per packet, in the sorted order
+     * \param uint32_t first_instance instance offset of the first batch
+     * \param DrawPass& pass receives the visible packets and their batches
+     * \return uint32_t the number of instanced packets
+     */
+    uint32_t BuildBatches(const uint8_t *visible, uint32_t first_instance, DrawPass &pass) const;
+
+    DrawPacket& operator[](size_t index) { return this->packets[index]; }
+    const DrawPacket& operator[](size_t index) const { return this->packets[index]; }
+
+    size_t Size() const { return this->packets.size(); }
+    bool Empty() const { return this->packets.empty(); }
+
+    std::vector<DrawPacket>::iterator begin() { return this->packets.begin(); }
+    std::vector<DrawPacket>::iterator end() { return this->packets.end(); }
+    std::vector<DrawPacket>::const_iterator begin() const { return this->packets.begin(); }
+    std::vector<DrawPacket>::const_iterator end() const { return this->packets.end(); }
+
+private:
+    /**
+     * \brief Whether a packet can be drawn by the call of the batch started by head.
+     */
+    static bool SameBatch(const DrawPacket &head, const DrawPacket &packet);
+
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+    std::vector<std::pair<id_t, size_t>> removals; // the entity and the packet count when it was removed
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
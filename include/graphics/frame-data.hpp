@@ -0,0 +1,94 @@
+#ifndef FRAME_DATA_HPP_INCLUDED
+#define FRAME_DATA_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include <glm/glm.hpp>
+#include "graphics/stream-buffer.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief The per frame data shared by all shaders, with the std140 layout
+ *
+ * Matches the FrameData uniform block of FRAME_DATA_SOURCE, only mat4 and
+ * vec4 members so the C++ layout is the std140 one.
+ */
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 inv_view;
+    glm::mat4 inv_projection;
+    glm::vec4 viewport; // x, y, width and height in pixels
+    glm::vec4 time; // seconds since start, seconds since the last frame
+};
+
+/**
+ * \brief Binding point of the FrameData uniform block in every shader.
+ */
+static const GLuint FRAME_DATA_BINDING = 0;
+
+/**
+ * \brief Name of the uniform block, a linked shader declaring it is bound
+ * to FRAME_DATA_BINDING.
+ */
+static const char FRAME_DATA_BLOCK[] = "FrameData";
+
+/**
+ * \brief GLSL declaration of the block, added to the shaders asking for it.
+ */
+static const char FRAME_DATA_SOURCE[] =
+    "layout(std140) uniform FrameData {\n"
+    "    mat4 view;\n"
+    "    mat4 projection;\n"
+    "    mat4 inv_view;\n"
+    "    mat4 inv_projection;\n"
+    "    vec4 viewport;\n"
+    "    vec4 time;\n"
+    "} frame;\n";
+
+/**
+ * \brief The uniform buffer holding the FrameData of the frame being rendered
+ *
+ * Each frame writes its data in its own region of a stream buffer, so the
+ * previous frames still read theirs.
+ */
+class FrameUniformBuffer final {
+public:
+    FrameUniformBuffer();
+
+    FrameUniformBuffer(const FrameUniformBuffer &) = delete;
+    FrameUniformBuffer& operator=(const FrameUniformBuffer &) = delete;
+
+    /**
+     * \brief Create the buffer, needs a current context.
+     */
+    void Create();
+
+    /**
+     * \brief Write the data of a frame and bind it to FRAME_DATA_BINDING.
+     *
+     * Called once before the passes of the frame are rendered.
+     * \param const FrameData& data the data of the frame
+     */
+    void Upload(const FrameData &data);
+
+    /**
+     * \brief Fence the data of the frame, after its passes were submitted.
+     */
+    void EndFrame();
+
+    /**
+     * \brief false until Create() was called.
+     */
+    bool IsCreated() const { return this->stream.IsCreated(); }
+
+private:
+    StreamBuffer stream;
+    GLint alignment; // of the offsets bound to a uniform block
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef FRUSTUM_HPP_INCLUDED
+#define FRUSTUM_HPP_INCLUDED
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "graphics/matrix-store.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief World space bounding spheres stored as arrays of components
+ */
+class BoundingSpheres final {
+public:
+    typedef std::vector<float, AlignedAllocator<float, 16>> float_array;
+
+    void Add(const glm::vec3 &center, float radius) {
+        this->x.push_back(center.x);
+        this->y.push_back(center.y);
+        this->z.push_back(center.z);
+        this->radius.push_back(radius);
+    }
+
+    /**
+     * \brief Set the size, spheres can then be written by index from several threads.
+     */
+    void Resize(size_t count) {
+        this->x.resize(count);
+        this->y.resize(count);
+        this->z.resize(count);
+        this->radius.resize(count);
+    }
+
+    void Set(size_t index, const glm::vec3 &center, float radius) {
+        this->x[index] = center.x;
+        this->y[index] = center.y;
+        this->z[index] = center.z;
+        this->radius[index] = radius;
+    }
+
+    void Clear() {
+        this->x.clear();
+        this->y.clear();
+        this->z.clear();
+        this->radius.clear();
+    }
+
+    size_t Size() const { return this->radius.size(); }
+
+    float_array x, y, z;
+    float_array radius;
+};
+
+/**
+ * \brief The 6 planes of a view projection volume
+ */
+class Frustum final {
+public:
+    Frustum() { }
+
+    /**
+     * \brief Extract the planes of a projection * view matrix.
+     *
+     * Plane normals point inside the volume and are normalized,
+     * so plane distances are in world units.
+     */
+    explicit Frustum(const glm::mat4 &view_projection);
+
+    /**
+     * \brief Test a single sphere.
+     * \return bool false if the sphere is entirely outside a plane
+     */
+    bool TestSphere(const glm::vec3 &center, float radius) const;
+
+    /**
+     * \brief Test an axis aligned box.
+     * \return bool false if the box is entirely outside a plane
+     */
+    bool TestBox(const glm::vec3 &min, const glm::vec3 &max) const;
+
+    /**
+     * \brief Test every sphere of the set, 4 at a time with SSE when it is available.
+     *
+     * \param uint8_t* visible receives 1 for each sphere that may be visible, 0 otherwise
+     */
+    void CullSpheres(const BoundingSpheres &spheres, uint8_t *visible) const;
+
+private:
+    // plane i is (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside
+    float a[6], b[6], c[6], d[6];
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef GL_STATE_HPP_INCLUDED
+#define GL_STATE_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include <cstdint>
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief Cache of the GL context state, filtering redundant changes
+ *
+ * The graphics code binds programs, vertex arrays, buffers, textures and
+ * framebuffers, and toggles capabilities through this class, so a call
+ * that would not change the state is not sent to GL. The state is the
+ * one of the context current on the graphics thread. Invalidate() must be
+ * called once a context is made current, and after code changed the state
+ * directly.
+ *
+ * The changes sent to GL are counted per frame, EndFrame() closes the
+ * counts of a frame.
+ */
+class GLState final {
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+    /**
+     * \brief State changes sent to GL during a frame
+     */
+    struct Counters {
+        uint32_t program;
+        uint32_t vertex_array;
+        uint32_t buffer;
+        uint32_t texture;
+        uint32_t framebuffer;
+        uint32_t capability; // enable, disable and polygon mode
+        uint32_t skipped; // redundant calls that were filtered
+    };
+
+    static void UseProgram(GLuint program);
+    static void BindVertexArray(GLuint vao);
+
+    /**
+     * \brief Bind a buffer, the element array buffer is tracked per vertex array.
+     */
+    static void BindBuffer(GLenum target, GLuint buffer);
+
+    /**
+     * \param GLenum unit GL_TEXTURE0 + the index of the unit
+     */
+    static void ActiveTexture(GLenum unit);
+
+    /**
+     * \brief Bind a texture to the active unit.
+     */
+    static void BindTexture(GLenum target, GLuint texture);
+
+    /**
+     * \brief Bind a framebuffer, GL_FRAMEBUFFER sets both the draw and read bindings.
+     */
+    static void BindFramebuffer(GLenum target, GLuint fbo);
+
+    static void Enable(GLenum capability);
+    static void Disable(GLenum capability);
+
+    /**
+     * \brief Set the polygon mode of both faces.
+     */
+    static void PolygonMode(GLenum mode);
+
+    // Deleting objects also unbinds them.
+    static void DeleteTextures(GLsizei count, const GLuint *textures);
+    static void DeleteBuffers(GLsizei count, const GLuint *buffers);
+    static void DeleteFramebuffers(GLsizei count, const GLuint *fbos);
+    static void DeleteVertexArrays(GLsizei count, const GLuint *vaos);
+
+    /**
+     * \brief The bound draw framebuffer, only queried from GL when unknown.
+     */
+    static GLuint GetDrawFramebuffer();
+
+    /**
+     * \brief The bound read framebuffer, only queried from GL when unknown.
+     */
+    static GLuint GetReadFramebuffer();
+
+    /**
+     * \brief Forget the cached state, the next changes are all sent to GL.
+     */
+    static void Invalidate();
+
+    /**
+     * \brief Close the counters of the frame and start the next ones.
+     */
+    static void EndFrame();
+
+    /**
+     * \brief The counters of the last frame closed by EndFrame().
+     */
+    static const Counters& GetFrameCounters() { return last_frame; }
+
+private:
+    static GLuint program;
+    static GLuint vertex_array;
+    static GLuint array_buffer;
+    static GLuint element_buffer;
+    static GLuint texture_buffer;
+    static GLuint uniform_buffer;
+    static GLenum active_unit; // index of the unit
+    static GLuint textures_2d[MAX_TEXTURE_UNITS];
+    static GLuint textures_2d_multisample[MAX_TEXTURE_UNITS];
+    static GLuint textures_buffer[MAX_TEXTURE_UNITS];
+    static GLuint draw_framebuffer;
+    static GLuint read_framebuffer;
+    static GLenum polygon_mode;
+    static int8_t capabilities[]; // 1 enabled, 0 disabled, -1 unknown
+    static Counters frame;
+    static Counters last_frame;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef JOB_FANOUT_HPP_INCLUDED
+#define JOB_FANOUT_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief A few threads kept waiting for the parts of a call
+ *
+ * The threads are started once and sleep between calls, so a call does
+ * not create threads or allocate. The calling thread takes parts too and
+ * returns once all of them are done. One call runs at a time, a call made
+ * while the pool is busy, from one of its threads for instance, runs all
+ * its parts on the calling thread.
+ */
+class JobPool final {
+public:
+    typedef void (*Task)(const void *context, size_t part);
+
+    /**
+     * \brief The pool of the graphics jobs, started on the first use.
+     *
+     * It has a thread for each core left by the threads reserved with
+     * ReserveThreads(), unless SetThreadCount() gave its size.
+     */
+    static JobPool& Get();
+
+    /**
+     * \brief Leave a core to each of the threads the program keeps busy, before the first Get().
+     *
+     * \param size_t thread_count the threads of the program, the one calling the jobs included
+     * \return bool false if the pool is already started
+     */
+    static bool ReserveThreads(size_t thread_count);
+
+    /**
+     * \brief Start the pool with a number of threads, before the first Get().
+     *
+     * \param size_t thread_count the threads started, besides the calling ones
+     * \return bool false if the pool is already started
+     */
+    static bool SetThreadCount(size_t thread_count);
+
+    /**
+     * \param size_t thread_count the threads started, besides the calling ones
+     */
+    explicit JobPool(size_t thread_count);
+    ~JobPool();
+
+    JobPool(const JobPool &) = delete;
+    JobPool& operator=(const JobPool &) = delete;
+
+    /**
+     * \brief The number of threads a call may use, the calling one included.
+     */
+    size_t Threads() const { return this->threads.size() + 1; }
+
+    /**
+     * \brief Run task(context, part) for each part in [0, part_count).
+     */
+    void Run(Task task, const void *context, size_t part_count);
+
+private:
+    void WorkerLoop();
+
+    /**
+     * \brief Run the parts nobody took yet.
+     * \return size_t the number of parts run
+     */
+    size_t TakeParts(Task task, const void *context, size_t part_count);
+
+    std::vector<std::thread> threads;
+    std::mutex mutex; // guards the call fields below
+    std::condition_variable wake;
+    std::condition_variable done;
+    Task task;
+    const void *context;
+    size_t part_count;
+    size_t finished_parts;
+    size_t active_threads; // the threads that took the current call and have not finished it
+    uint64_t generation; // counts the calls, so a thread takes each one once
+    bool stopping;
+    std::atomic<size_t> next_part;
+    std::atomic<bool> busy; // set for the length of a call
+};
+
+/**
+ * \brief Splits independent jobs between the threads of the job pool
+ *
+ * The calling thread runs its own share of the jobs and waits for the
+ * others, so the results are complete when a call returns. Jobs must not
+ * write to data another job reads or writes.
+ */
+class JobFanout final {
+public:
+    /**
+     * \brief The number of threads a call may use, the calling one included.
+     */
+    static size_t Workers() {
+        return JobPool::Get().Threads();
+    }
+
+    /**
+     * \brief Run job(i) for each i in [0, count).
+     *
+     * Jobs are dealt to the threads in turn, so jobs of uneven cost are
+     * spread between them.
+     * \param bool parallel false to run every job on the calling thread
+     */
+    template<class Job>
+    static void Run(size_t count, bool parallel, const Job &job) {
+        const size_t threads = parallel ? std::min(Workers(), count) : 1;
+        if(threads < 2) {
+            for(size_t i = 0; i < count; i++) {
+                job(i);
+            }
+            return;
+        }
+        const Share<Job> share = { &job, count, threads };
+        JobPool::Get().Run(&Share<Job>::RunPart, &share, threads);
+    }
+
+    /**
+     * \brief Run job(first, last) over parts of the range [0, count).
+     *
+     * \param size_t min_per_job the smallest part given to a thread
+     */
+    template<class Job>
+    static void ForRanges(size_t count, size_t min_per_job, const Job &job) {
+        size_t jobs = std::min(Workers(), count / std::max<size_t>(1, min_per_job));
+        if(jobs < 2) {
+            job(size_t(0), count);
+            return;
+        }
+        const size_t part = (count + jobs - 1) / jobs;
+        Run(jobs, true, [&job, count, part] (size_t i) {
+            job(i * part, std::min(count, (i + 1) * part));
+        });
+    }
+
+private:
+    // the jobs of one thread: first, first + threads, ...
+    template<class Job>
+    struct Share {
+        const Job *job;
+        size_t count;
+        size_t threads;
+
+        static void RunPart(const void *context, size_t first) {
+            const Share &share = *static_cast<const Share*>(context);
+            for(size_t i = first; i < share.count; i += share.threads) {
+                (*share.job)(i);
+            }
+        }
+    };
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef LIGHT_GRID_HPP_INCLUDED
+#define LIGHT_GRID_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+class Shader;
+
+/**
+ * \brief A light as seen by the cluster grid, in view space
+ */
+struct GridLight {
+    glm::vec3 position;
+    float radius; // infinite for lights that reach every cluster
+    glm::vec3 color;
+    glm::vec3 direction;
+    uint32_t type;
+};
+
+/**
+ * \brief Lights binned into a 3D grid of view space clusters
+ *
+ * The grid splits the screen in CLUSTER_X by CLUSTER_Y tiles and the
+ * view depth in CLUSTER_Z slices, exponentially spaced between the near
+ * and far planes. Each cluster keeps the range of its lights in a shared
+ * index list, so a single lighting pass can shade each pixel with only
+ * the lights that reach its cluster.
+ *
+ * The data is given to the lighting shader as buffer textures:
+ * - cluster_lights (samplerBuffer): 3 texels per light, position and radius,
+ *   color and type, direction
+ * - cluster_cells (usamplerBuffer): first index and light count per cluster,
+ *   cluster x + y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y
+ * - cluster_indices (usamplerBuffer): light indices
+ * with the uniforms cluster_dims (uvec3), cluster_depth (vec2: near plane,
+ * slices / log(far / near)) and light_count.
+ */
+class LightGrid final {
+public:
+    static const uint32_t CLUSTER_X = 16;
+    static const uint32_t CLUSTER_Y = 9;
+    static const uint32_t CLUSTER_Z = 24;
+    static const uint32_t CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+    LightGrid();
+    ~LightGrid();
+
+    LightGrid(const LightGrid &) = delete;
+    LightGrid& operator=(const LightGrid &) = delete;
+
+    /**
+     * \brief Bin the lights of a frame into the clusters.
+     *
+     * \param const std::vector<GridLight>& lights the lights in view space
+     * \param const glm::mat4& projection the symmetric perspective projection of the view
+     * \param float near_plane distance of the near plane
+     * \param float far_plane distance of the far plane
+     */
+    void Build(const std::vector<GridLight> &lights, const glm::mat4 &projection,
+        float near_plane, float far_plane);
+
+    /**
+     * \brief Create the GL buffers and textures, needs a current context.
+     */
+    void CreateBuffers();
+
+    /**
+     * \brief Upload the data of the last Build() to the buffers.
+     */
+    void Upload() const;
+
+    /**
+     * \brief Look up the uniforms of the clustered lighting shader, once per link.
+     *
+     * \param Shader& shader the clustered lighting shader
+     */
+    void ResolveBindings(Shader &shader);
+
+    /**
+     * \brief Bind the 3 buffer textures starting at a texture unit, and set the uniforms.
+     *
+     * The shader the bindings were resolved with must be in use.
+     * \param GLuint first_unit the first texture unit to use
+     */
+    void Bind(GLuint first_unit) const;
+
+    uint32_t GetLightCount() const { return this->light_count; }
+    size_t GetIndexCount() const { return this->light_indices.size(); }
+
+    /**
+     * \brief The first index and the light count of a cluster, after Build().
+     */
+    const uint32_t* GetCluster(uint32_t x, uint32_t y, uint32_t z) const {
+        return &this->cluster_data[(x + y * CLUSTER_X + z * CLUSTER_X * CLUSTER_Y) * 2];
+    }
+    uint32_t GetLightIndex(size_t index) const { return this->light_indices[index]; }
+
+private:
+    /**
+     * \brief Depth slice of a view distance, clamped to the grid.
+     */
+    uint32_t GetSlice(float depth) const;
+
+    /**
+     * \brief View distance where a depth slice starts.
+     */
+    float GetSliceDepth(uint32_t slice) const;
+
+    uint32_t light_count;
+    float near_plane;
+    float depth_scale; // CLUSTER_Z / log(far / near)
+
+    std::vector<glm::vec4> light_data;
+    std::vector<uint32_t> cluster_data; // first index, count
+    std::vector<uint32_t> light_indices;
+    std::vector<uint32_t> light_bounds; // per slice of each light: light, z, x0, x1, y0, y1
+
+    GLuint buffers[3];
+    GLuint textures[3];
+
+    uint32_t bound_link_id;
+    GLint sampler_locations[3];
+    GLint dims_location;
+    GLint depth_location;
+    GLint count_location;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -10,6 +10,9 @@
 namespace trillek {
 namespace graphics {
 
+class Shader;
+class Texture;
+
 /**
  * \brief The base light component acts as a simple point light in the scene
  */
@@ -20,6 +23,8 @@ public:
         enabled = true;
         shadows = false;
         lighttype = 0;
+        radius = 200.0f;
+        bound_link_id = 0;
     }
     virtual ~LightBase() { }
 
@@ -31,12 +36,25 @@ public:
      */
     virtual bool Initialize(const std::vector<Property> &properties);
 
+    /**
+     * \brief Resolve the uniform locations of the properties in a lighting shader.
+     *
+     * Only looks up names when the shader was linked again, or the shadow
+     * texture was not found yet.
+     * \param Shader& shader the lighting shader
+     */
+    void ResolveBindings(Shader &shader);
+
     bool enabled;
     bool shadows;
     GLuint lighttype;
+    float radius;
     glm::vec3 color;
     glm::mat4x4 depthmatrix;
     std::vector<Property> light_props;
+    std::vector<GLint> prop_locations; // per light_props entry, -1 if not a uniform
+    std::shared_ptr<Texture> shadow_texture; // named by the "shadow" property
+    uint32_t bound_link_id; // link of the shader prop_locations are from
 };
 
 } // namespace graphics
@@ -60,7 +60,7 @@ public:
      * \param GLuint target Target texture unit to make active.
      * \return void
      */
-    void ActivateTexture(const size_t index, const GLuint target);
+    void ActivateTexture(const size_t index, const GLuint target) const;
 
     /**
      * \brief Deactivates the specified texture unit.
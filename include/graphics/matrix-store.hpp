@@ -0,0 +1,119 @@
+#ifndef MATRIX_STORE_HPP_INCLUDED
+#define MATRIX_STORE_HPP_INCLUDED
+
+#include "trillek.hpp"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief A minimal allocator returning storage aligned to ALIGN bytes
+ *
+ * Used so the matrix array can be copied into GPU buffers
+ * or read with aligned SIMD loads.
+ */
+template<class T, std::size_t ALIGN>
+class AlignedAllocator {
+public:
+    typedef T value_type;
+    template<class U> struct rebind { typedef AlignedAllocator<U, ALIGN> other; };
+
+    AlignedAllocator() { }
+    template<class U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGN> &) { }
+
+    T* allocate(std::size_t count) {
+        // keep the original pointer just before the aligned block
+        std::size_t padding = ALIGN + sizeof(void*);
+        char *base = static_cast<char*>(::operator new(count * sizeof(T) + padding));
+        std::uintptr_t aligned = (reinterpret_cast<std::uintptr_t>(base) + padding) & ~(std::uintptr_t)(ALIGN - 1);
+        reinterpret_cast<void**>(aligned)[-1] = base;
+        return reinterpret_cast<T*>(aligned);
+    }
+    void deallocate(T *block, std::size_t) {
+        ::operator delete(reinterpret_cast<void**>(block)[-1]);
+    }
+
+    template<class U>
+    bool operator==(const AlignedAllocator<U, ALIGN> &) const { return true; }
+    template<class U>
+    bool operator!=(const AlignedAllocator<U, ALIGN> &) const { return false; }
+};
+
+/**
+ * \brief Handle to a model matrix slot
+ *
+ * The generation changes when the slot is released, so a handle kept
+ * after its entity lost its transform can be detected as stale.
+ */
+struct MatrixSlot {
+    MatrixSlot() : index(~0u), generation(0) { }
+    uint32_t index;
+    uint32_t generation;
+};
+
+/**
+ * \brief Dense storage of the model matrices of the graphics system
+ *
+ * Matrices live in one aligned array indexed by slot. Slots are stable
+ * while the entity has a transform, and freed slots are reused.
+ * Entities are mapped to slots with a table indexed by entity ID.
+ */
+class ModelMatrixStore final {
+public:
+    typedef std::vector<glm::mat4, AlignedAllocator<glm::mat4, 16>> matrix_array;
+
+    /**
+     * \brief Get the slot of an entity, allocating an identity matrix if it has none.
+     */
+    MatrixSlot Acquire(const id_t entity_id);
+
+    /**
+     * \brief Free the slot of an entity, handles to it become stale.
+     */
+    void Release(const id_t entity_id);
+
+    /**
+     * \brief Get the current slot of an entity without allocating.
+     * \return bool false if the entity has no slot
+     */
+    bool Find(const id_t entity_id, MatrixSlot &slot) const;
+
+    /**
+     * \brief Check that a handle still refers to the slot it was given for.
+     */
+    bool IsValid(const MatrixSlot &slot) const {
+        return slot.index < this->generations.size()
+            && this->generations[slot.index] == slot.generation;
+    }
+
+    glm::mat4& operator[](const uint32_t index) { return this->matrices[index]; }
+    const glm::mat4& operator[](const uint32_t index) const { return this->matrices[index]; }
+    glm::mat4& operator[](const MatrixSlot &slot) { return this->matrices[slot.index]; }
+    const glm::mat4& operator[](const MatrixSlot &slot) const { return this->matrices[slot.index]; }
+
+    /**
+     * \brief The whole matrix array, free slots included, for block uploads.
+     */
+    glm::mat4* Data() { return this->matrices.data(); }
+    const glm::mat4* Data() const { return this->matrices.data(); }
+    size_t Size() const { return this->matrices.size(); }
+
+private:
+    static const uint32_t NO_SLOT = ~0u;
+
+    matrix_array matrices;
+    std::vector<uint32_t> generations;
+    std::vector<uint32_t> entity_slots; // indexed by entity ID
+    std::vector<uint32_t> free_slots;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef MESH_SIMPLIFIER_HPP_INCLUDED
+#define MESH_SIMPLIFIER_HPP_INCLUDED
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief A level of detail of a mesh, a range of its index buffer
+ */
+struct MeshLevel {
+    unsigned int first_index;
+    unsigned int index_count;
+    float error; // model space bound of the distance of the full mesh vertices to this level
+};
+
+/**
+ * \brief The indices of a mesh followed by those of its simplified levels
+ */
+struct MeshLevelChain {
+    std::vector<unsigned int> indices;
+    std::vector<MeshLevel> levels; // the full mesh first
+};
+
+/**
+ * \brief Builds the levels of detail of a mesh by quadric error decimation
+ *
+ * An edge is collapsed by moving one of its vertices onto the other, the
+ * cost of the move is the distance of the kept vertex to the planes of the
+ * triangles around both, weighted by their area. The vertices are never
+ * moved or added, so every level draws from the vertex buffer of the full
+ * mesh with its own indices, and the skinning and texture coordinates stay
+ * valid. The vertices on open edges, which include the seams where the
+ * mesh splits its vertices, are never moved, so the levels keep the outline
+ * and the seams of the mesh. The error of a level is measured once it is
+ * built, from each vertex of the full mesh to the triangles of the level
+ * near the vertex it was moved onto, so it is never less than how far the
+ * vertices of the mesh are from the level.
+ */
+class MeshSimplifier final {
+public:
+    static const unsigned int MAX_LEVELS = 4;
+    // the chain stops at a level with fewer triangles than this
+    static const unsigned int LEVEL_MIN_TRIANGLES = 32;
+
+    /**
+     * \brief Append the indices of the simplified levels to the indices of a mesh.
+     *
+     * Each level has about half the triangles of the one before. The chain
+     * stops early when a level would be too coarse or would not save enough.
+     * \param const std::vector<glm::vec3>& positions the vertex positions
+     * \param std::vector<unsigned int>& indices the triangles of the full mesh, the levels are appended
+     * \param float max_error the largest error of a level, in model space
+     * \return std::vector<MeshLevel> the levels, the full mesh first, with an increasing error
+     */
+    static std::vector<MeshLevel> BuildLevels(const std::vector<glm::vec3> &positions,
+        std::vector<unsigned int> &indices, float max_error);
+
+    /**
+     * \brief Collapse the edges of a mesh until it has few enough indices.
+     *
+     * \param const std::vector<glm::vec3>& positions the vertex positions
+     * \param const unsigned int* indices the triangles
+     * \param size_t index_count the number of indices
+     * \param size_t target_count the number of indices to reach
+     * \param float max_error no edge is collapsed for more than this distance
+     * \param std::vector<unsigned int>& out receives the triangles left
+     * \return float a bound of the distance of the mesh vertices to the result, in model space
+     */
+    static float Simplify(const std::vector<glm::vec3> &positions, const unsigned int *indices,
+        size_t index_count, size_t target_count, float max_error, std::vector<unsigned int> &out);
+
+    /**
+     * \brief Choose the level to draw for the size of the mesh on screen.
+     *
+     * The coarsest level whose error covers at most max_pixels is drawn. A
+     * level coarser than the current one must fit within a fraction
+     * 1 - hysteresis of it, so a mesh at the threshold does not flicker
+     * between two levels.
+     * \param const MeshLevel* levels the levels, with an increasing error
+     * \param uint32_t level_count the number of levels
+     * \param uint32_t current the level drawn the last time
+     * \param float pixels_per_unit the size on screen of a model space unit at the mesh
+     * \param float max_pixels the error allowed on screen
+     * \param float hysteresis the part of max_pixels a coarser level must be under
+     * \return uint32_t the level to draw
+     */
+    static uint32_t SelectLevel(const MeshLevel *levels, uint32_t level_count, uint32_t current,
+            float pixels_per_unit, float max_pixels, float hysteresis) {
+        uint32_t level = 0;
+        for(uint32_t l = 1; l < level_count; l++) {
+            const float limit = l > current ? max_pixels * (1.0f - hysteresis) : max_pixels;
+            if(!(levels[l].error * pixels_per_unit <= limit)) {
+                break;
+            }
+            level = l;
+        }
+        return level;
+    }
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef NULL_GL_HPP_INCLUDED
+#define NULL_GL_HPP_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief A GL backend recording the calls of the engine instead of rendering
+ *
+ * Built in place of the GL and GLEW libraries when TRILLEK_HEADLESS_GL is
+ * defined, with the TCC_HEADLESS_GL CMake option, so the render system
+ * runs without a GPU or a window. It hands out object names, tracks the
+ * bound state and the uniforms declared in the shader sources, counts the
+ * calls, and can write a trace of every call.
+ *
+ * Only the entry points the engine calls are implemented.
+ */
+class NullGL final {
+public:
+    /**
+     * \brief What the engine asked of GL
+     */
+    struct Counters {
+        uint64_t calls;
+        uint64_t draws;
+        uint64_t triangles;
+        uint64_t upload_bytes; // buffer and texture data sent
+        uint64_t uniforms;
+        uint64_t binds; // programs, buffers, textures, vertex arrays and framebuffers
+        uint64_t objects; // names created
+    };
+
+    /**
+     * \brief Write a line for each call to a stream, nullptr to stop.
+     *
+     * The stream must outlive the trace.
+     */
+    static void SetTrace(std::ostream *out);
+
+    /**
+     * \brief Close the counters of a frame.
+     *
+     * \param std::chrono::nanoseconds cpu_time the time the frame took to submit
+     */
+    static void EndFrame(std::chrono::nanoseconds cpu_time);
+
+    /**
+     * \brief Set the number of frames to run, 0 to run until closed.
+     */
+    static void SetFrameLimit(uint64_t frames);
+
+    /**
+     * \brief Check if the frames set by SetFrameLimit() were all closed.
+     *
+     * \return bool true when the application should close
+     */
+    static bool FrameLimitReached();
+
+    /**
+     * \brief The counters of the last frame closed by EndFrame().
+     */
+    static const Counters& GetFrameCounters();
+
+    /**
+     * \brief The counters of all the closed frames.
+     */
+    static const Counters& GetTotalCounters();
+
+    static uint64_t GetFrameCount();
+    static std::chrono::nanoseconds GetTotalTime();
+
+    /**
+     * \brief Write the averages per frame of the closed frames.
+     */
+    static void Report(std::ostream &out);
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
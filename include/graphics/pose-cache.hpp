@@ -0,0 +1,122 @@
+#ifndef POSE_CACHE_HPP_INCLUDED
+#define POSE_CACHE_HPP_INCLUDED
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "graphics/animation-clip.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief The distinct poses of the animations of a frame, each evaluated once
+ *
+ * The animations ask for a pose of their clip at their time. The time is
+ * quantized to STEPS_PER_FRAME steps between two frames of the clip, so
+ * the animations playing the same clip in step, like a crowd or a row of
+ * machines, share one pose and one palette.
+ *
+ * The poses of the previous frame are kept. Those asked for again, like
+ * the poses held by the animations updated at a reduced rate, are copied
+ * instead of sampled. The storage is kept between frames, so a frame with
+ * no more poses than the previous ones does not allocate.
+ */
+class PoseCache final {
+public:
+    static const uint32_t STEPS_PER_FRAME = 8;
+    static const uint32_t NO_POSE = ~0u;
+
+    PoseCache() : copied_count(0) { }
+
+    /**
+     * \brief Forget the requests of the previous frame, its poses are kept until Evaluate().
+     */
+    void Clear();
+
+    /**
+     * \brief Ask for the pose of a clip at a time.
+     *
+     * \param const AnimationClip& clip the clip, it must live until the Evaluate() of the next frame
+     * \param size_t frame the frame before the time
+     * \param float blend how far the time is from that frame to the next one
+     * \return uint32_t the request, to find its pose after Evaluate()
+     */
+    uint32_t Request(const AnimationClip &clip, size_t frame, float blend);
+
+    /**
+     * \brief Find the distinct poses of the requests and write their matrices.
+     *
+     * \param size_t min_per_job the smallest number of poses given to a thread
+     */
+    void Evaluate(size_t min_per_job);
+
+    /**
+     * \brief The pose of a request of this frame, NO_POSE for an unknown request.
+     */
+    uint32_t GetPose(uint32_t request) const {
+        return request < this->request_poses.size() ? this->request_poses[request] : NO_POSE;
+    }
+
+    const glm::mat4* GetMatrices(uint32_t pose) const { return this->matrices.data() + this->poses[pose].first; }
+    size_t GetBoneCount(uint32_t pose) const { return this->poses[pose].bone_count; }
+
+    /**
+     * \brief The number of distinct poses.
+     */
+    size_t Size() const { return this->poses.size(); }
+
+    /**
+     * \brief The number of requests since Clear().
+     */
+    size_t GetRequestCount() const { return this->requests.size(); }
+
+    /**
+     * \brief The number of poses of the last Evaluate() copied from the frame before.
+     */
+    size_t GetCopiedCount() const { return this->copied_count; }
+
+private:
+    // The clip is told apart by its id, a clip freed since the last frame
+    // may have left its address to a new one.
+    struct PoseKey {
+        const AnimationClip *clip;
+        uint32_t clip_id;
+        uint32_t frame;
+        uint32_t step;
+
+        bool operator<(const PoseKey &other) const {
+            if(this->clip_id != other.clip_id) {
+                return this->clip_id < other.clip_id;
+            }
+            return this->frame != other.frame ? this->frame < other.frame : this->step < other.step;
+        }
+        bool operator!=(const PoseKey &other) const {
+            return this->clip_id != other.clip_id || this->frame != other.frame || this->step != other.step;
+        }
+    };
+
+    struct Pose {
+        PoseKey key;
+        size_t first; // first matrix of the pose
+        size_t bone_count;
+        size_t source; // first matrix of the same pose in the previous frame, or NO_SOURCE
+    };
+
+    static const size_t NO_SOURCE = ~size_t(0);
+
+    std::vector<std::pair<PoseKey, uint32_t>> requests; // the request index with its key
+    std::vector<uint32_t> request_poses;
+    std::vector<Pose> poses;
+    std::vector<glm::mat4> matrices;
+    std::vector<Pose> previous_poses; // in key order
+    std::vector<glm::mat4> previous_matrices;
+    size_t copied_count;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
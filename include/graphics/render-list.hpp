@@ -33,8 +33,6 @@ class RenderCommandItem final {
 public:
     RenderCommandItem(RenderCmd c, Container &&cv, std::list<Property> &&prop) {
         cmd = c;
-        resolved = false;
-        resolve_error = false;
         cmdvalue = std::move(cv);
         load_properties = std::move(prop);
     }
@@ -46,26 +44,18 @@ public:
     RenderCommandItem(RenderCommandItem&& other) {
         this->cmd = std::move(other.cmd);
         this->cmdvalue = std::move(other.cmdvalue);
-        this->resolved = other.resolved;
-        this->resolve_error = other.resolve_error;
-        this->run_values = std::move(other.run_values);
         this->load_properties = std::move(other.load_properties);
     }
 
     RenderCommandItem& operator=(RenderCommandItem&& other) {
         this->cmd = std::move(other.cmd);
         this->cmdvalue = std::move(other.cmdvalue);
-        this->resolved = other.resolved;
-        this->resolve_error = other.resolve_error;
-        this->run_values = std::move(other.run_values);
         this->load_properties = std::move(other.load_properties);
+        return *this;
     }
 
     RenderCmd cmd;
     Container cmdvalue;
-    bool resolved;
-    bool resolve_error;
-    std::list<Container> run_values;
     std::list<Property> load_properties;
 };
 /**
@@ -0,0 +1,86 @@
+#ifndef RENDER_PROGRAM_HPP_INCLUDED
+#define RENDER_PROGRAM_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include "render-layer.hpp"
+#include <memory>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+class Shader;
+class RenderList;
+
+enum class RenderOpCode : unsigned int {
+    CLEAR_SCREEN = 0,
+    DRAW_GEOMETRY,
+    DRAW_DEPTH,
+    DRAW_LIGHTING,
+    DRAW_POST,
+    READ_LAYER,
+    WRITE_LAYER,
+    RENDER_LAYER,
+    BIND_LAYER_TEXTURES,
+    COPY_LAYER,
+};
+
+/**
+ * \brief A resolved render command, with its operands bound
+ *
+ * A null layer is the default framebuffer. Rects without has_rect are
+ * the viewport of the camera, read when the command runs.
+ */
+struct RenderOp {
+    RenderOpCode code;
+    GLbitfield copy_bits; // COPY_LAYER buffers
+    RenderLayer *layer; // the layer to bind, or the source of COPY_LAYER
+    RenderLayer *target; // the destination of COPY_LAYER
+    Shader *shader; // DRAW_POST
+    GLint layer_locations[4]; // DRAW_POST samplers of the 4 layers
+    bool has_rect;
+    bool has_target_rect;
+    ViewRect rect;
+    ViewRect target_rect;
+};
+
+/**
+ * \brief A RenderList compiled into a flat array of commands
+ *
+ * Built once by the render system resolvers, so running a frame does not
+ * look up names or unpack containers. It holds a reference to the
+ * objects the commands point to.
+ */
+class RenderProgram final {
+public:
+    RenderProgram() : source(nullptr) { }
+
+    /**
+     * \brief Start compiling a list, dropping the previous commands.
+     */
+    void Reset(const RenderList *list) {
+        this->source = list;
+        this->ops.clear();
+        this->references.clear();
+    }
+
+    void Add(const RenderOp &op) { this->ops.push_back(op); }
+
+    /**
+     * \brief Keep an object used by the commands alive.
+     */
+    void Hold(std::shared_ptr<const void> object) { this->references.push_back(std::move(object)); }
+
+    const RenderList* GetSource() const { return this->source; }
+    const std::vector<RenderOp>& GetOps() const { return this->ops; }
+
+private:
+    const RenderList *source;
+    std::vector<RenderOp> ops;
+    std::vector<std::shared_ptr<const void>> references;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
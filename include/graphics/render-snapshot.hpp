@@ -0,0 +1,58 @@
+#ifndef RENDER_SNAPSHOT_HPP_INCLUDED
+#define RENDER_SNAPSHOT_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "graphics/render-layer.hpp"
+#include "graphics/frame-data.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief The value of a light property, with the location it is set to
+ */
+struct LightUniform {
+    GLint location;
+    GLint components; // number of floats in value, 1 to 4
+    glm::vec4 value;
+};
+
+/**
+ * \brief What the lighting pass needs of an enabled light
+ */
+struct LightSnapshot {
+    glm::vec3 position; // world space
+    glm::vec3 direction;
+    glm::vec3 color;
+    GLuint type;
+    bool shadows; // drawn with its own quad in clustered mode
+    int32_t shadow_view; // index in the shadow views, -1 without a tile
+    GLuint shadow_texture; // 0 when the light has no shadow texture
+    glm::mat4 depth_matrix;
+    uint32_t first_uniform; // in RenderSnapshot::light_uniforms
+    uint32_t uniform_count;
+};
+
+/**
+ * \brief The camera and lights a frame is rendered from
+ *
+ * Taken by the render system at the end of HandleEvents, then left
+ * unchanged while the frame is rendered. The light components are shared
+ * with Lua, which may change them while a pipelined frame is rendered, so
+ * the lighting pass only reads their copies. The rest of the render state
+ * belongs to the render system and is read in place.
+ */
+struct RenderSnapshot {
+    ViewRect viewport;
+    FrameData frame; // camera matrices and time
+    std::vector<LightSnapshot> lights;
+    std::vector<LightUniform> light_uniforms;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -3,9 +3,11 @@
 
 #include "opengl.hpp"
 #include "type-id.hpp"
+#include <glm/glm.hpp>
 #include <memory>
 #include <vector>
 #include "components/component.hpp"
+#include "graphics/mesh-simplifier.hpp"
 
 namespace trillek {
 namespace resource {
@@ -32,6 +34,10 @@ public:
         GLuint ibo;
         unsigned int ibo_count;
         std::vector<std::shared_ptr<Texture>> textures;
+        glm::vec3 bounds_min; // model space box around the vertices
+        glm::vec3 bounds_max;
+        glm::vec4 bounding_sphere; // model space center and radius, infinite radius if there are no vertices
+        std::shared_ptr<const MeshLevelChain> level_chain; // the contents of the ibo, shared by the renderables of the mesh
     };
 
     /**
@@ -39,6 +45,9 @@ public:
      *
      * This will take the buffers from the mesh resource mesh groups and put
      * them in OpenGL buffers. This will create new buffer groups if needed.
+     * The bounds of each group are computed from the mesh vertices. The
+     * simplified levels of each mesh group are built the first time it is
+     * used, and stored after its indices in the same ibo.
      * \return void
      */
     void UpdateBufferGroups();
@@ -31,6 +31,16 @@ enum class ShaderOutputType {
     DEFAULT_TARGETS
 };
 
+/**
+ * \brief An active uniform of a linked program
+ */
+struct UniformInfo {
+    std::string name;
+    GLint location;
+    GLenum type;
+    GLint size; // array length, 1 if not an array
+};
+
 class Shader final : public GraphicsBase {
 public:
     Shader();
@@ -69,9 +79,26 @@ public:
 
     /**
      * \brief Link the program from loaded shader source
+     *
+     * The active uniforms are reflected once linked, so looking up a
+     * uniform does not query GL. A FrameData uniform block is bound to
+     * FRAME_DATA_BINDING.
      * \return false on link errors, true for success
      */
     bool LinkProgram();
+
+    /**
+     * \brief Identifies the last successful link, 0 when not linked.
+     *
+     * Unique across all shaders, so locations resolved from a shader can
+     * be checked with a single compare.
+     */
+    uint32_t GetLinkID() const { return link_id; }
+
+    /**
+     * \brief The active uniforms, in the order GL reported them.
+     */
+    const std::vector<UniformInfo>& GetUniforms() const { return uniform_table; }
     void Use();
     static void UnUse();
     GLuint GetProgram();
@@ -82,6 +109,12 @@ public:
     GLint operator()(const std::string & uniform);
 
     GLint Attribute(const std::string & attribute);
+
+    /**
+     * \brief Location of a uniform, -1 when it is not active.
+     *
+     * Meant to resolve bindings, not for the per frame path.
+     */
     GLint Uniform(const std::string & uniform);
 
     //Program deletion
@@ -90,7 +123,14 @@ public:
 
     static void InitializeTypes();
 private:
+    /**
+     * \brief Fill the uniform table from the active uniforms of the program.
+     */
+    void ReflectUniforms();
+
     GLuint program;
+    uint32_t link_id;
+    std::vector<UniformInfo> uniform_table;
     std::vector<GLuint> shaders;
     std::vector<std::pair<std::string, GLuint>> output_bindings;
     std::map<std::string, GLint> attributes_list;
@@ -98,6 +138,7 @@ private:
 
     static std::once_flag types_once;
     static std::map<std::string, ShaderType> shaderclass;
+    static std::atomic<uint32_t> next_link_id;
 };
 
 } // End of graphics
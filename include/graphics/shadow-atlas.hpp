@@ -0,0 +1,47 @@
+#ifndef SHADOW_ATLAS_HPP_INCLUDED
+#define SHADOW_ATLAS_HPP_INCLUDED
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief Splits one shadow depth target between the shadow casting lights
+ *
+ * Tiles are square with a side of the atlas side divided by a power of 2,
+ * the level of the tile. They are handed out from the largest to the
+ * smallest in Z order, which packs them without gaps.
+ */
+class ShadowAtlas final {
+public:
+    static const uint32_t MAX_LEVEL = 4; // the smallest tile is 1/16 of the atlas side
+
+    /**
+     * \brief Give a tile to each light, sized by its importance.
+     *
+     * A light of importance 1 asks for the whole atlas, each halving of
+     * the importance halves the side of the tile. When the tiles do not
+     * fit, the largest ones are shrunk first, then the least important
+     * lights are left without a tile.
+     * \param const std::vector<float>& importance of each light, in (0, 1]
+     * \param std::vector<glm::vec4>& tiles receives x, y and side of each tile
+     * as fractions of the atlas, a side of 0 when the light got no tile
+     */
+    static void Allocate(const std::vector<float> &importance, std::vector<glm::vec4> &tiles);
+
+    /**
+     * \brief Matrix mapping the clip space of a light to its tile of the atlas.
+     *
+     * Multiplied before the light view projection, so the shadow lookup of
+     * the lighting shader lands in the tile.
+     */
+    static glm::mat4 GetTileMatrix(const glm::vec4 &tile);
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef SHADOW_CACHE_HPP_INCLUDED
+#define SHADOW_CACHE_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include "graphics/texture.hpp"
+#include <cstdint>
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief Depth of the static shadow casters, kept between frames
+ *
+ * A depth only framebuffer with the layout of the shadow atlas. A tile is
+ * only rendered again when its light or a static caster in its frustum
+ * changed, then the whole cache is copied to the atlas before the dynamic
+ * casters are drawn on top.
+ */
+class ShadowCache final {
+public:
+    ShadowCache();
+    ~ShadowCache();
+
+    ShadowCache(const ShadowCache &) = delete;
+    ShadowCache& operator=(const ShadowCache &) = delete;
+
+    /**
+     * \brief Size the cache to cover the atlas, needs a current context.
+     *
+     * The content is lost when the size changes, and the generation is
+     * incremented so the render system knows to render every tile again.
+     * \param GLsizei width the width of the atlas
+     * \param GLsizei height the height of the atlas
+     * \return bool false if the framebuffer is not complete
+     */
+    bool Resize(GLsizei width, GLsizei height);
+
+    /**
+     * \brief Bind the cache as the draw framebuffer.
+     */
+    void BindToRender() const;
+
+    /**
+     * \brief Copy the depth of a rectangle of the cache to the same
+     * rectangle of a draw framebuffer.
+     *
+     * Leaves the cache bound for reading and the atlas for drawing.
+     * \param GLuint draw_fbo the framebuffer of the atlas
+     * \param const GLint* rect x, y, width and height
+     */
+    void CopyTo(GLuint draw_fbo, const GLint *rect) const;
+
+    /**
+     * \brief Incremented each time the content is lost.
+     */
+    uint32_t GetGeneration() const { return this->generation; }
+
+    /**
+     * \brief false until the first successful Resize().
+     */
+    bool IsComplete() const { return this->complete; }
+
+private:
+    GLuint fbo_id;
+    Texture depth;
+    GLsizei width;
+    GLsizei height;
+    uint32_t generation;
+    bool complete;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
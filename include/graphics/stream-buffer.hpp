@@ -0,0 +1,119 @@
+#ifndef STREAM_BUFFER_HPP_INCLUDED
+#define STREAM_BUFFER_HPP_INCLUDED
+
+#include "opengl.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "graphics/matrix-store.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief A buffer the CPU writes every frame without waiting on the GPU
+ *
+ * The storage is split into FRAMES regions that are used in turn. A fence
+ * is placed after the draws that read a region. The region is written
+ * again only once that fence has passed, so the GPU reads one frame while
+ * the next ones are written.
+ *
+ * With ARB_buffer_storage, the buffer is mapped once, persistently and
+ * coherently, and allocations point straight into it. Without it,
+ * allocations point into a copy in memory, which Commit() sends to an
+ * orphaned buffer.
+ *
+ * Allocate() and writes to the allocations can happen on any thread.
+ * The other calls need the context.
+ */
+class StreamBuffer final {
+public:
+    static const unsigned int FRAMES = 3;
+
+    /**
+     * \brief Part of the buffer given to a frame
+     */
+    struct Range {
+        Range() : data(nullptr), offset(0), size(0) { }
+
+        void *data; // where to write, null if the allocation failed
+        GLintptr offset; // in the buffer, for the draws of the frame that allocated it
+        GLsizeiptr size;
+    };
+
+    StreamBuffer();
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer& operator=(const StreamBuffer &) = delete;
+
+    /**
+     * \brief Create the buffer, or create it again with another size.
+     *
+     * \param GLenum target the binding used to create and fill the buffer
+     * \param size_t frame_size the bytes a frame can allocate
+     * \return bool true when the buffer is persistently mapped
+     */
+    bool Create(GLenum target, size_t frame_size);
+
+    /**
+     * \brief Grow the regions to hold at least size bytes.
+     *
+     * Waits for the GPU to finish with every region if the buffer has to
+     * be created again, so it should be called rarely.
+     */
+    void Reserve(size_t size);
+
+    /**
+     * \brief Move to the next region, waiting until the GPU finished reading it.
+     */
+    void BeginFrame();
+
+    /**
+     * \brief Take a part of the region of the frame.
+     *
+     * \param size_t size the number of bytes
+     * \param size_t alignment a power of two up to 256, for the offset in the buffer
+     * \return Range the allocation, with null data if the region is full
+     */
+    Range Allocate(size_t size, size_t alignment = 16);
+
+    /**
+     * \brief Make the data written in the region visible to GL, before the draws reading it.
+     */
+    void Commit() const;
+
+    /**
+     * \brief Fence the region after the draws reading it were submitted.
+     */
+    void EndFrame();
+
+    GLuint GetBuffer() const { return this->buffer; }
+    size_t GetFrameSize() const { return this->frame_size; }
+    bool IsCreated() const { return this->buffer != 0; }
+    bool IsPersistent() const { return this->mapped != nullptr; }
+
+    /**
+     * \brief The number of BeginFrame() calls that had to wait for the GPU.
+     */
+    uint64_t GetStallCount() const { return this->stalls; }
+
+private:
+    void Destroy();
+
+    GLenum target;
+    GLuint buffer;
+    size_t frame_size;
+    unsigned int frame; // region being written
+    GLsync fences[FRAMES];
+    char *mapped; // the whole buffer when persistently mapped, else null
+    std::vector<char, AlignedAllocator<char, 256>> staging; // one region, without persistent mapping
+    std::atomic<size_t> used; // bytes allocated in the region
+    uint64_t stalls;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
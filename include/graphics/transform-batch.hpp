@@ -0,0 +1,62 @@
+#ifndef TRANSFORM_BATCH_HPP_INCLUDED
+#define TRANSFORM_BATCH_HPP_INCLUDED
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstdint>
+#include <vector>
+#include "graphics/matrix-store.hpp"
+
+namespace trillek {
+namespace graphics {
+
+/**
+ * \brief Translation, orientation and scale of many transforms, stored as arrays of components
+ *
+ * Each transform is composed into translate * mat4_cast(orientation) * scale
+ * and written to a target index of an output matrix array. Groups of 4
+ * transforms are composed together with SSE when it is available.
+ */
+class TransformBatch final {
+public:
+    typedef std::vector<float, AlignedAllocator<float, 16>> float_array;
+
+    /**
+     * \brief Queue a transform, its matrix is written to out[target] by Compose().
+     */
+    void Add(const glm::vec3 &translation, const glm::quat &orientation,
+        const glm::vec3 &scale, uint32_t target);
+
+    void Clear();
+    void Reserve(size_t count);
+    size_t Size() const { return this->targets.size(); }
+
+    /**
+     * \brief Compose the matrices of the transforms [first, first + count).
+     *
+     * \param glm::mat4* out the output array, indexed by the transform targets
+     */
+    void Compose(glm::mat4 *out, size_t first, size_t count) const;
+
+    /**
+     * \brief Compose all the matrices, splitting the batch between threads when it is large.
+     *
+     * The calling thread composes one part of the batch and waits for the others.
+     * Targets must be unique, every thread writes to its own output matrices.
+     * \param size_t min_per_job the smallest number of transforms given to a thread
+     */
+    void ComposeAll(glm::mat4 *out, size_t min_per_job = 2048) const;
+
+private:
+    void ComposeScalar(glm::mat4 *out, size_t index) const;
+
+    float_array tx, ty, tz;
+    float_array qx, qy, qz, qw;
+    float_array sx, sy, sz;
+    std::vector<uint32_t> targets;
+};
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -8,8 +8,11 @@
 
 #include <list>
 #include <memory>
+#include <set>
 #include <vector>
 #include <future>
+#include <mutex>
+#include <atomic>
 #include <iostream>
 #include "trillek.hpp"
 #include "type-id.hpp"
@@ -21,6 +24,24 @@
 #include "graphics/material.hpp"
 #include "graphics/render-layer.hpp"
 #include "graphics/texture.hpp"
+#include "graphics/draw-list.hpp"
+#include "graphics/matrix-store.hpp"
+#include "graphics/transform-batch.hpp"
+#include "graphics/frustum.hpp"
+#include "graphics/aabb-tree.hpp"
+#include "graphics/light-grid.hpp"
+#include "graphics/shadow-atlas.hpp"
+#include "graphics/shadow-cache.hpp"
+#include "graphics/render-program.hpp"
+#include "graphics/gl-state.hpp"
+#include "graphics/frame-data.hpp"
+#include "graphics/stream-buffer.hpp"
+#include "graphics/bone-palette.hpp"
+#include "graphics/draw-frame.hpp"
+#include "graphics/mesh-simplifier.hpp"
+#include "graphics/job-fanout.hpp"
+#include "graphics/render-snapshot.hpp"
+#include "graphics/null-gl.hpp"
 #include <map>
 #include "systems/dispatcher.hpp"
 #include "os.hpp"
@@ -30,29 +51,24 @@ namespace trillek {
 
 class Transform;
 
+namespace resource {
+class Mesh;
+} // namespace resource
+
 namespace graphics {
 
 enum class RenderCmd : unsigned int;
 class RenderCommandItem;
 class Renderable;
 class CameraBase;
-class Animation;
 class LightBase;
 class RenderList;
 
 struct MaterialGroup {
     Material material;
-    struct TextureGroup {
-        std::vector<size_t> texture_indicies;
-        struct RenderableGroup {
-            std::shared_ptr<Renderable> renderable;
-            std::map<id_t, std::shared_ptr<Animation>> animations;
-            std::list<id_t> instances;
-            size_t buffer_group_index;
-        };
-        std::list<RenderableGroup> renderable_groups;
-    };
-    std::list<TextureGroup> texture_groups;
+    DrawBindings bindings;
+    // each set is a list of texture indicies in the material, referenced by DrawPacket::texture_set
+    std::vector<std::vector<size_t>> texture_sets;
 };
 
 class RenderSystem final : public SystemBase, public util::Parser,
@@ -91,8 +107,11 @@ public:
     void RenderColorPass(const float *viewmatrix, const float *projmatrix) const;
 
     /** \brief Renders all geometry for the scene, but only the depth channel.
+     *
+     * \param const ViewRect& atlas_rect the viewport of the bound layer, split between the shadow views
      */
-    void RenderDepthOnlyPass(const float *view_matrix, const float *proj_matrix) const;
+    void RenderDepthOnlyPass(const float *view_matrix, const float *proj_matrix,
+        const ViewRect &atlas_rect) const;
 
     /** \brief Renders all deferred lighting passes for the scene.
      */
@@ -100,7 +119,7 @@ public:
 
     /** \brief Renders post processing passes for the scene.
      */
-    void RenderPostPass(std::shared_ptr<Shader>) const;
+    void RenderPostPass(Shader &postshader, const GLint *layer_locations) const;
 
     /**
      * \brief Causes an update in the system based on the change in time.
@@ -137,6 +156,19 @@ public:
      */
     void AddDynamicComponent(const id_t entity_id, std::shared_ptr<Container> component) override;
 
+    /**
+     * \brief true when Lua and physics simulate the next frame while this one is rendered.
+     *
+     * Set with the "frame-mode" setting, "pipelined" or "sequential".
+     * Only Lua and physics overlap the rendering, HandleEvents() and
+     * RunBatch() still run one after the other on the graphics thread, so
+     * the draw list, the passes and the model matrices are read in place.
+     * The lights, which Lua may change, are read from the snapshot taken
+     * by HandleEvents(). Components added to the system are queued until
+     * HandleEvents().
+     */
+    bool IsPipelined() const { return this->pipelined_frames; }
+
     /**
      * \brief Removes a Renderable component from the system..
      *
@@ -197,6 +229,13 @@ public:
     void RegisterStaticParsers();
     void RegisterListResolvers();
 
+    /**
+     * \brief Resolve the active render list into the render program.
+     *
+     * A command that fails to resolve ends the program.
+     */
+    void CompileRenderList();
+
     template<class T>
     std::shared_ptr<T> Get(const std::string & instancename) const {
         unsigned int type_id = reflection::GetTypeID<T>();
@@ -234,6 +273,18 @@ public:
     // returns an entity ID
     id_t GetActiveCameraID() const { return camera_id; }
 
+    /**
+     * \brief The world space bounds of the renderables, for frustum, sphere and ray queries.
+     *
+     * Refitted when the graphic transforms are committed, only valid on the graphics thread.
+     */
+    const AABBTree& GetRenderableIndex() const { return this->renderable_index; }
+
+    /**
+     * \brief The boxes around the spheres the lights reach, for frustum, sphere and ray queries.
+     */
+    const AABBTree& GetLightIndex() const { return this->light_index; }
+
     void Notify(const KeyboardEvent* key_event) {
         switch(key_event->action) {
         case KeyboardEvent::KEY_DOWN:
@@ -264,6 +315,117 @@ private:
 
     void UpdateModelMatrices(const frame_tp& timepoint);
 
+    /**
+     * \brief Copy the camera and the enabled lights of the frame into the snapshot.
+     */
+    void TakeSnapshot();
+
+    /**
+     * \brief Add the components queued while the frame was pipelined.
+     */
+    void AddPendingComponents();
+
+    /**
+     * \brief Add a renderable, light or camera component to the lists.
+     */
+    void AddComponentNow(const id_t entity_id, const std::shared_ptr<Container> &component);
+
+    /**
+     * \brief Fill the shared per frame data from the camera, once its view is updated.
+     *
+     * \param frame_tp now the time of the frame in nanoseconds
+     * \param frame_tp delta nanoseconds since the last frame
+     */
+    void UpdateFrameData(frame_tp now, frame_tp delta);
+
+    // uniform locations of the lighting shaders
+    struct LightingBindings {
+        LightingBindings() : link_id(0), layers{-1, -1, -1, -1}, inv_proj(-1), light_pos(-1),
+            light_color(-1), light_dir(-1), light_type(-1), shadow_enabled(-1),
+            shadow_matrix(-1), shadow_depth(-1) { }
+
+        uint32_t link_id;
+        GLint layers[4];
+        GLint inv_proj;
+        GLint light_pos;
+        GLint light_color;
+        GLint light_dir;
+        GLint light_type;
+        GLint shadow_enabled;
+        GLint shadow_matrix;
+        GLint shadow_depth;
+    };
+
+    /**
+     * \brief Look up the draw locations of a shader, unless they are from its current link.
+     */
+    void ResolveDrawBindings(Shader &shader, DrawBindings &bindings) const;
+
+    /**
+     * \brief Look up the lighting locations of a shader, unless they are from its current link.
+     */
+    static void ResolveLightingBindings(Shader &shader, LightingBindings &bindings);
+
+    /**
+     * \brief Resolve the locations used by the passes before a frame is rendered.
+     *
+     * The passes then set uniforms without looking up names.
+     */
+    void UpdateShaderBindings();
+
+    /**
+     * \brief Give each shadow casting light a tile of the shadow atlas and a view.
+     *
+     * The static casters of a view are only drawn again when its cached
+     * depth is stale.
+     */
+    void UpdateShadowViews();
+
+    /**
+     * \brief Record the current bounds of a static caster, so the cached
+     * shadows that see them are drawn again.
+     */
+    void AddShadowChange(const id_t entity_id);
+
+    /**
+     * \brief Adds the draw packets of each buffer group of a renderable.
+     */
+    void AddDrawPackets(const id_t entity_id, const std::shared_ptr<Renderable> &ren);
+
+    /**
+     * \brief Set the shadow views, then build the passes of the frame for the camera.
+     */
+    void UpdateDrawList();
+
+    /**
+     * \brief Get the sort key ID of a mesh group, allocating one if needed.
+     */
+    uint32_t GetMeshKeyID(const resource::Mesh *mesh, size_t buffer_group_index);
+
+    /**
+     * \brief Bin the lights without shadows into the cluster grid of the camera.
+     */
+    void UpdateLightGrid();
+
+    // an entry of a spatial index, with the bounds of the entity in model space
+    struct SpatialProxy {
+        int32_t proxy;
+        AABB local_bounds;
+    };
+
+    /**
+     * \brief Add an entity to a spatial index, or replace its bounds.
+     */
+    void SetSpatialProxy(AABBTree &index, std::map<id_t, SpatialProxy> &proxies,
+        const id_t entity_id, const AABB &local_bounds);
+
+    /**
+     * \brief Refit an entry to the current model matrix of its entity.
+     */
+    void MoveSpatialProxy(AABBTree &index, const id_t entity_id, const SpatialProxy &proxy);
+
+    void RemoveSpatialProxy(AABBTree &index, std::map<id_t, SpatialProxy> &proxies, const id_t entity_id);
+
     int gl_version[3];
     int debugmode;
     bool frame_drop;
@@ -278,14 +440,37 @@ private:
     unsigned int window_width; // Store the width of our window
     unsigned int window_height; // Store the height of our window
     bool multisample;
+    bool instancing;
+    bool clustered_lighting; /// "lighting-mode" setting, shade the lights without shadows in one pass
+    FrameData frame_data; /// copied to the snapshot once per frame
+    mutable FrameUniformBuffer frame_buffer;
+    frame_tp start_time;
+    bool pipelined_frames;
+    RenderSnapshot snapshot; /// what the frame is rendered from of the components shared with the other systems
+    std::mutex pending_mutex;
+    std::vector<std::pair<id_t, std::shared_ptr<Container>>> pending_components;
 
     std::map<std::string, std::function<bool(const rapidjson::Value&)>> parser_functions;
 
     // A list of the renderables in the system. Stored as a pair (entity ID, Renderable).
     std::list<std::pair<id_t, std::shared_ptr<Renderable>>> renderables;
 
-    // A list of the lights in the system. Stored as a pair (entity ID, LightBase).
-    std::list<std::pair<id_t, std::shared_ptr<LightBase>>> alllights;
+    // A light in the system, with the slot of its model matrix.
+    struct LightEntry {
+        id_t entity_id;
+        std::shared_ptr<LightBase> light;
+        MatrixSlot matrix;
+        float indexed_radius; // the radius of the light's box in the light index
+        int32_t shadow_view; // index in shadow_views for this frame, -1 without a tile
+        // what the static casters in the shadow cache were drawn with
+        bool shadow_cached;
+        uint32_t cache_generation;
+        glm::vec4 cached_tile;
+        glm::mat4 cached_matrix;
+    };
+
+    // A list of the lights in the system.
+    std::list<LightEntry> alllights;
 
     // A list of all dynamic textures in the system
     std::list<std::weak_ptr<Texture>> dyn_textures;
@@ -297,14 +482,34 @@ private:
     std::shared_ptr<RenderList> activerender;
     std::shared_ptr<Shader> lightingshader;
     std::shared_ptr<Shader> depthpassshader;
+    std::shared_ptr<Shader> clusteredshader;
+    DrawBindings depth_bindings;
+    LightingBindings lighting_bindings;
+    LightingBindings clustered_bindings;
     std::shared_ptr<CameraBase> camera;
     id_t camera_id;
 
-    std::map<RenderCmd, std::function<bool(RenderCommandItem&)>> list_resolvers;
+    // append the ops of a command to the program, false on errors
+    std::map<RenderCmd, std::function<bool(const RenderCommandItem&, RenderProgram&)>> list_resolvers;
+    RenderProgram render_program; /// the compiled active render list
 
     std::map<unsigned int, std::map<std::string, std::shared_ptr<GraphicsBase>>> graphics_instances;
-    std::map<unsigned int, glm::mat4> model_matrices;
-    std::list<MaterialGroup> material_groups;
+    ModelMatrixStore model_matrices;
+    TransformBatch transform_batch; /// modified transforms of the frame, reused between frames
+    std::vector<MaterialGroup> material_groups;
+    std::map<std::pair<const resource::Mesh*, size_t>, uint32_t> mesh_key_ids;
+    DrawFrame draw_frame; /// the draw list and the passes of the frame, written by HandleEvents
+    std::vector<float> shadow_importance;
+    std::vector<glm::vec4> shadow_tiles;
+    std::unique_ptr<ShadowCache> shadow_cache; /// null before Start()
+    std::vector<AABB> shadow_changes; /// world bounds of the static casters changed since the last frame
+    std::set<id_t> animated_entities; /// renderables always drawn as dynamic casters
+    AABBTree renderable_index;
+    AABBTree light_index;
+    std::map<id_t, SpatialProxy> renderable_proxies;
+    std::map<id_t, SpatialProxy> light_proxies;
+    LightGrid light_grid;
+    std::vector<GridLight> grid_lights;
 };
 
 /**
@@ -2,16 +2,49 @@
 #define METAENGINESYSTEM_HPP_INCLUDED
 
 #include "systems/system-base.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace trillek {
 class MetaEngineSystem final : public SystemBase {
+public:
+    MetaEngineSystem();
+    ~MetaEngineSystem();
+
+private:
     void ThreadInit() override;
 
+    /**
+     * \brief Run the batches of the systems.
+     *
+     * When the graphics system is pipelined, it renders while Lua and
+     * physics simulate the next frame on the simulation thread, and waits
+     * for them before returning, so the rendered state is one frame old at most.
+     */
     void RunBatch() const override;
 
     void HandleEvents(frame_tp timepoint) override;
 
     void Terminate() override;
+
+    /**
+     * \brief Simulate the frames posted by HandleEvents, until the system terminates.
+     */
+    void SimulationLoop();
+
+    /**
+     * \brief Stop the simulation thread once its frame is simulated.
+     */
+    void StopSimulation();
+
+    // Lua and physics of the pipelined frames, started with the first one
+    std::thread simulation_thread;
+    mutable std::mutex simulation_mutex;
+    mutable std::condition_variable simulation_cv;
+    frame_tp simulation_timepoint; // of the frame posted to the thread
+    mutable bool simulation_pending; // a frame is posted and not simulated yet
+    bool simulation_stop;
 };
 }
 
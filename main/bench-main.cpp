@@ -0,0 +1,626 @@
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <random>
+#include <string>
+#include <vector>
+#include "opengl.hpp"
+#include "graphics/matrix-store.hpp"
+#include "graphics/transform-batch.hpp"
+#include "graphics/draw-list.hpp"
+#include "graphics/job-fanout.hpp"
+#include "graphics/gl-state.hpp"
+#include "graphics/null-gl.hpp"
+#include "graphics/bone-palette.hpp"
+#include "graphics/animation-clip.hpp"
+#include "graphics/animation.hpp"
+#include "graphics/draw-frame.hpp"
+#include "graphics/mesh-simplifier.hpp"
+
+size_t gAllocatedSize = 0;
+
+namespace {
+
+typedef std::chrono::high_resolution_clock bench_clock;
+
+struct TransformSet {
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> orientations;
+    std::vector<glm::vec3> scales;
+};
+
+TransformSet MakeTransforms(size_t count) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.5f, 2.0f);
+    TransformSet set;
+    for(size_t i = 0; i < count; i++) {
+        set.translations.push_back(glm::vec3(position(rng), position(rng), position(rng)));
+        set.orientations.push_back(glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng))));
+        set.scales.push_back(glm::vec3(size(rng), size(rng), size(rng)));
+    }
+    return set;
+}
+
+// nanoseconds per transform, best of the runs
+template<class F>
+double Measure(size_t count, unsigned int runs, F func) {
+    double best = 0.0;
+    for(unsigned int r = 0; r < runs; r++) {
+        auto start = bench_clock::now();
+        func();
+        double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+        if(r == 0 || ns < best) {
+            best = ns;
+        }
+    }
+    return best / count;
+}
+
+float MaxDifference(const glm::mat4 *a, const glm::mat4 *b, size_t count) {
+    float diff = 0.0f;
+    for(size_t i = 0; i < count; i++) {
+        for(unsigned int c = 0; c < 4; c++) {
+            for(unsigned int r = 0; r < 4; r++) {
+                diff = std::max(diff, std::abs(a[i][c][r] - b[i][c][r]));
+            }
+        }
+    }
+    return diff;
+}
+
+void BenchModelMatrices(size_t count, unsigned int runs) {
+    const TransformSet set = MakeTransforms(count);
+    trillek::graphics::ModelMatrixStore::matrix_array reference(count);
+    trillek::graphics::ModelMatrixStore::matrix_array batched(count);
+
+    double glm_ns = Measure(count, runs, [&] () {
+        for(size_t i = 0; i < count; i++) {
+            reference[i] = glm::translate(set.translations[i]) *
+                glm::mat4_cast(set.orientations[i]) *
+                glm::scale(set.scales[i]);
+        }
+    });
+
+    trillek::graphics::TransformBatch batch;
+    double gather_ns = Measure(count, runs, [&] () {
+        batch.Clear();
+        batch.Reserve(count);
+        for(size_t i = 0; i < count; i++) {
+            batch.Add(set.translations[i], set.orientations[i], set.scales[i], i);
+        }
+    });
+    double serial_ns = Measure(count, runs, [&] () {
+        batch.Compose(batched.data(), 0, count);
+    });
+    double parallel_ns = Measure(count, runs, [&] () {
+        batch.ComposeAll(batched.data());
+    });
+
+    std::cout << "model matrices x" << count
+        << ": glm " << glm_ns << " ns"
+        << ", gather " << gather_ns << " ns"
+        << ", batch " << serial_ns << " ns"
+        << ", batch parallel " << parallel_ns << " ns"
+        << ", max error " << MaxDifference(reference.data(), batched.data(), count)
+        << std::endl;
+}
+
+// The poses of a rig: the path of MD5Anim, slerp and matrices per joint then
+// the inverse bind pose, against the clip decoding and sampling groups of
+// joints with the inverse bind pose baked in. The joints hang from one of the
+// few joints before them and turn a little each frame, the root also walks.
+// A quarter of the joints stay still, like the props of a model.
+void BenchSkeleton(size_t joints, unsigned int runs) {
+    const size_t frames = 120;
+    const size_t poses = 64;
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<glm::quat> orientations(joints * frames);
+    std::vector<glm::vec3> positions(joints * frames);
+    std::vector<glm::mat4> inverse_binds(joints);
+    std::vector<glm::mat4> baked(joints * frames);
+    const glm::vec3 walk(unit(rng) * 0.01f, 0.0f, unit(rng) * 0.01f);
+    for(size_t j = 0; j < joints; j++) {
+        const bool still = j % 4 == 3;
+        const int parent = j == 0 || still ? -1 : static_cast<int>(j - 1 - rng() % std::min<size_t>(j, 3));
+        const glm::quat base = glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng)));
+        const glm::vec3 step = still ? glm::vec3(0.0f) :
+            glm::vec3(unit(rng) * 0.01f, unit(rng) * 0.01f, unit(rng) * 0.01f);
+        const glm::vec3 offset(unit(rng), unit(rng), unit(rng));
+        inverse_binds[j] = glm::translate(glm::vec3(unit(rng), unit(rng), unit(rng))) *
+            glm::mat4_cast(glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng))));
+        for(size_t f = 0; f < frames; f++) {
+            const size_t i = f * joints + j;
+            const glm::quat local = glm::normalize(base * glm::quat(1.0f, step.x * f, step.y * f, step.z * f));
+            if(parent < 0) {
+                orientations[i] = local;
+                positions[i] = offset + (j == 0 ? walk * static_cast<float>(f) : glm::vec3(0.0f));
+            }
+            else {
+                const size_t p = f * joints + parent;
+                orientations[i] = glm::normalize(orientations[p] * local);
+                positions[i] = positions[p] + orientations[p] * offset;
+            }
+            baked[i] = glm::translate(positions[i]) * glm::mat4_cast(orientations[i]) * inverse_binds[j];
+        }
+    }
+    const trillek::graphics::AnimationClip clip(joints, 24.0f, baked);
+    std::vector<glm::mat4> reference(joints * poses);
+    std::vector<glm::mat4> sampled(joints * poses);
+
+    double glm_ns = Measure(joints * poses, runs, [&] () {
+        for(size_t p = 0; p < poses; p++) {
+            // between neighbouring frames, not across the end of the clip
+            const size_t first0 = (p % (frames - 1)) * joints, first1 = first0 + joints;
+            const float blend = static_cast<float>(p % 7) / 7.0f;
+            for(size_t j = 0; j < joints; j++) {
+                reference[p * joints + j] =
+                    glm::translate(glm::mix(positions[first0 + j], positions[first1 + j], blend)) *
+                    glm::mat4_cast(glm::slerp(orientations[first0 + j], orientations[first1 + j], blend)) *
+                    inverse_binds[j];
+            }
+        }
+    });
+    double clip_ns = Measure(joints * poses, runs, [&] () {
+        for(size_t p = 0; p < poses; p++) {
+            const size_t frame = p % (frames - 1);
+            clip.Sample(frame, frame + 1, static_cast<float>(p % 7) / 7.0f, sampled.data() + p * joints);
+        }
+    });
+
+    std::cout << "skeleton x" << joints
+        << ": glm " << glm_ns << " ns"
+        << ", clip " << clip_ns << " ns"
+        << ", max error " << MaxDifference(reference.data(), sampled.data(), joints * poses)
+        << ", pinned " << clip.GetPinnedCount() << " of " << clip.GetTrackCount()
+        << ", memory " << clip.GetMemorySize()
+        << " bytes, float tracks " << joints * frames * 7 * sizeof(float)
+        << " bytes, matrices " << joints * frames * sizeof(glm::mat4) << " bytes"
+        << std::endl;
+}
+
+
+// Synthetic scenes: entities spread over meshes and materials, a fraction of
+// them animated, and lights casting shadows. Each frame goes through the
+// draw frame of the render system: the animations move and ask for their
+// poses, the moving transforms are composed, the draw list is keyed, sorted,
+// culled and batched for the camera and each light, then the passes are
+// submitted to the null GL backend.
+
+struct SceneConfig {
+    std::string name;
+    size_t entities;
+    size_t meshes;
+    size_t materials;
+    float animated; // fraction of the entities with a skeleton, they also move
+    size_t lights; // each one renders a shadow pass
+};
+
+const unsigned int SCENE_BONES = 32;
+const size_t SCENE_CLIPS = 4;
+const size_t SCENE_CLIP_FRAMES = 60;
+const float SCENE_CLIP_RATE = 30.0f;
+// the animations of a clip start at one of these many times, like a crowd walking in step
+const unsigned int SCENE_CLIP_PHASES = 16;
+const float SCENE_FRAME_TIME = 1.0f / 60.0f;
+const float SCENE_FAR_PLANE = 1000.0f;
+const float SCENE_VIEWPORT_HEIGHT = 1080.0f;
+
+// the simplification error a mesh level may show, in pixels, 0 draws the full meshes
+float gLodPixels = 1.0f;
+
+// A sphere of rings by 2 * rings quads, with a seam where the texture wraps
+void MakeSphere(unsigned int rings, float radius, std::vector<glm::vec3> &positions,
+        std::vector<unsigned int> &indices) {
+    const unsigned int segments = rings * 2;
+    for(unsigned int r = 0; r <= rings; r++) {
+        for(unsigned int s = 0; s <= segments; s++) {
+            const float theta = 3.14159265f * r / rings;
+            const float phi = 2.0f * 3.14159265f * s / segments;
+            positions.push_back(radius * glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta),
+                std::sin(theta) * std::sin(phi)));
+        }
+    }
+    for(unsigned int r = 0; r < rings; r++) {
+        for(unsigned int s = 0; s < segments; s++) {
+            const unsigned int a = r * (segments + 1) + s, b = a + 1, c = a + segments + 1, d = c + 1;
+            // the quads at the poles are single triangles
+            if(r > 0) {
+                indices.push_back(a); indices.push_back(c); indices.push_back(b);
+            }
+            if(r + 1 < rings) {
+                indices.push_back(b); indices.push_back(c); indices.push_back(d);
+            }
+        }
+    }
+}
+
+// nanoseconds spent in each stage, one entry per frame
+struct StageTimes {
+    std::vector<double> update;
+    std::vector<double> draw_list;
+    std::vector<double> submit;
+    std::vector<double> frame;
+};
+
+class SyntheticScene final {
+public:
+    explicit SyntheticScene(const SceneConfig &config);
+
+    void Update(double time);
+    void BuildDrawList();
+    void Submit();
+
+private:
+    SceneConfig config;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> orientations;
+    std::vector<glm::vec3> scales;
+    std::vector<float> speeds;
+    std::vector<uint32_t> animated; // entity indices
+    trillek::graphics::ModelMatrixStore model_matrices;
+    std::vector<trillek::graphics::MatrixSlot> slots;
+    trillek::graphics::TransformBatch transform_batch;
+    std::vector<std::shared_ptr<const trillek::graphics::AnimationClip>> clips;
+    std::vector<trillek::graphics::Animation> animations; // of the animated entities, in their order
+    trillek::graphics::DrawFrame draw_frame;
+    trillek::graphics::DrawCamera camera;
+    bool shadows_cached; // the static casters never move, their depth is drawn once
+    std::vector<trillek::graphics::MeshLevelChain> mesh_levels; // per mesh
+    std::vector<GLuint> programs; // per material
+    std::vector<GLuint> textures; // per material
+    GLuint depth_program;
+    trillek::graphics::DrawBindings color_bindings;
+    trillek::graphics::DrawBindings depth_bindings;
+};
+
+SyntheticScene::SyntheticScene(const SceneConfig &config) : config(config), draw_frame(this->model_matrices),
+        shadows_cached(false) {
+    using namespace trillek::graphics;
+    std::mt19937 rng(4321);
+    // keep the density of the scene when the entity count grows
+    const float extent = 10.0f * std::cbrt(static_cast<float>(config.entities));
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> size(0.5f, 2.0f);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+    std::uniform_int_distribution<size_t> mesh_pick(0, std::max<size_t>(1, config.meshes) - 1);
+    std::uniform_int_distribution<size_t> material_pick(0, std::max<size_t>(1, config.materials) - 1);
+    std::uniform_int_distribution<unsigned int> phase_pick(0, SCENE_CLIP_PHASES - 1);
+
+    this->programs.resize(std::max<size_t>(1, config.materials));
+    this->textures.resize(this->programs.size());
+    for(auto &program : this->programs) {
+        program = glCreateProgram();
+    }
+    glGenTextures(static_cast<GLsizei>(this->textures.size()), this->textures.data());
+    this->depth_program = glCreateProgram();
+    // the locations a linked shader would give, every shader reads per instance attributes
+    this->color_bindings.view = 0;
+    this->color_bindings.projection = 1;
+    this->color_bindings.bone_palettes = 2;
+    this->color_bindings.animated = 3;
+    this->color_bindings.instance_model = 4;
+    this->color_bindings.instance_palette = 8;
+    this->depth_bindings = this->color_bindings;
+    this->depth_bindings.light_pos = 5;
+    this->depth_bindings.light_vp = 6;
+    this->draw_frame.GetInstanceStream().Create(GL_ARRAY_BUFFER, 4096 * sizeof(glm::mat4));
+    this->draw_frame.GetBonePalettes().Create(4096);
+    this->draw_frame.SetMeshLODPixels(gLodPixels);
+    std::vector<GLuint> vaos(std::max<size_t>(1, config.meshes));
+    std::vector<GLuint> ibos(vaos.size());
+    glGenVertexArrays(static_cast<GLsizei>(vaos.size()), vaos.data());
+    glGenBuffers(static_cast<GLsizei>(ibos.size()), ibos.data());
+    // spheres of 300 to 2500 triangles, with their simplified levels
+    this->mesh_levels.resize(vaos.size());
+    for(size_t mesh = 0; mesh < this->mesh_levels.size(); mesh++) {
+        std::vector<glm::vec3> vertices;
+        MeshLevelChain &chain = this->mesh_levels[mesh];
+        MakeSphere(static_cast<unsigned int>(8 + mesh % 16), 1.5f, vertices, chain.indices);
+        chain.levels = MeshSimplifier::BuildLevels(vertices, chain.indices, 0.15f);
+    }
+    // clips swinging the bones of a chain, each at its own pace
+    for(size_t c = 0; c < SCENE_CLIPS; c++) {
+        std::vector<glm::mat4> matrices;
+        for(size_t f = 0; f < SCENE_CLIP_FRAMES; f++) {
+            const float time = 6.2831853f * (c + 1) * f / SCENE_CLIP_FRAMES;
+            for(unsigned int b = 0; b < SCENE_BONES; b++) {
+                const float angle = std::sin(time + b * 0.3f) * 0.5f;
+                matrices.push_back(glm::translate(glm::vec3(0.0f, 0.1f * b, 0.0f)) *
+                    glm::mat4_cast(glm::angleAxis(angle, glm::vec3(1.0f, 0.0f, 0.0f))));
+            }
+        }
+        this->clips.push_back(std::make_shared<AnimationClip>(SCENE_BONES, SCENE_CLIP_RATE, matrices));
+    }
+    // the packets point at the animations, they must not move
+    this->animations.reserve(config.entities);
+
+    for(size_t i = 0; i < config.entities; i++) {
+        const trillek::id_t entity_id = static_cast<trillek::id_t>(i + 1);
+        this->positions.push_back(glm::vec3(position(rng), position(rng), position(rng)));
+        this->orientations.push_back(glm::normalize(glm::quat(unit(rng), unit(rng), unit(rng), unit(rng))));
+        this->scales.push_back(glm::vec3(size(rng)));
+        this->speeds.push_back(unit(rng));
+        this->slots.push_back(this->model_matrices.Acquire(entity_id));
+        this->model_matrices[this->slots.back()] = glm::translate(this->positions.back()) *
+            glm::mat4_cast(this->orientations.back()) * glm::scale(this->scales.back());
+        Animation *animation = nullptr;
+        if(chance(rng) < config.animated) {
+            this->animated.push_back(static_cast<uint32_t>(i));
+            this->animations.push_back(Animation());
+            animation = &this->animations.back();
+            animation->SetClip(this->clips[this->animated.size() % SCENE_CLIPS]);
+            animation->UpdateAnimation(SCENE_CLIP_FRAMES / SCENE_CLIP_RATE * phase_pick(rng) / SCENE_CLIP_PHASES);
+        }
+
+        const size_t mesh = mesh_pick(rng);
+        DrawPacket packet;
+        packet.entity_id = entity_id;
+        packet.matrix = this->slots.back();
+        packet.material_index = static_cast<uint32_t>(material_pick(rng));
+        packet.texture_set = 0;
+        packet.sort_key = DrawList::MakeKey(0, packet.material_index, 0, static_cast<uint32_t>(mesh), 0);
+        packet.vao = vaos[mesh];
+        packet.ibo = ibos[mesh];
+        packet.ibo_first = 0;
+        packet.ibo_count = this->mesh_levels[mesh].levels[0].index_count;
+        packet.animation = animation;
+        packet.bounds = glm::vec4(0.0f, 0.0f, 0.0f, 1.5f);
+        packet.levels = this->mesh_levels[mesh].levels.data();
+        packet.level_count = static_cast<uint32_t>(this->mesh_levels[mesh].levels.size());
+        packet.level = 0;
+        this->draw_frame.GetDrawList().Add(packet);
+    }
+
+    const glm::vec3 eye(0.0f, extent * 0.25f, extent * 1.5f);
+    this->camera.view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    this->camera.projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, SCENE_FAR_PLANE);
+    this->camera.position = eye;
+    this->camera.viewport_height = SCENE_VIEWPORT_HEIGHT;
+    this->camera.near_plane = 0.1f;
+    this->camera.far_plane = SCENE_FAR_PLANE;
+    std::vector<ShadowView> &views = this->draw_frame.GetShadowViews();
+    views.resize(config.lights);
+    for(auto &view : views) {
+        view.light_pos = glm::vec3(position(rng), position(rng), position(rng));
+        glm::vec3 light_dir = glm::normalize(glm::vec3(unit(rng), -1.0f, unit(rng)));
+        view.light_matrix = glm::perspective(glm::radians(90.0f), 1.0f, 0.5f, extent) *
+            glm::lookAt(view.light_pos, view.light_pos + light_dir, glm::vec3(0.0f, 0.0f, 1.0f));
+        view.tile = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+        view.refresh_static = true;
+    }
+}
+
+void SyntheticScene::Update(double time) {
+    // the animations move and ask for their pose, the entity ids stagger the reduced rates
+    this->draw_frame.BeginAnimations();
+    for(size_t a = 0; a < this->animations.size(); a++) {
+        this->draw_frame.UpdateAnimation(this->animations[a], SCENE_FRAME_TIME, this->animated[a] + 1);
+    }
+    this->draw_frame.EvaluatePoses();
+
+    // the animated entities turn around the vertical axis
+    this->transform_batch.Clear();
+    this->transform_batch.Reserve(this->animated.size());
+    for(uint32_t i : this->animated) {
+        glm::quat turn = glm::angleAxis(static_cast<float>(time * this->speeds[i]), glm::vec3(0.0f, 1.0f, 0.0f));
+        this->transform_batch.Add(turn * this->positions[i], turn * this->orientations[i],
+            this->scales[i], this->slots[i].index);
+    }
+    this->transform_batch.ComposeAll(this->model_matrices.Data());
+}
+
+void SyntheticScene::BuildDrawList() {
+    for(auto &view : this->draw_frame.GetShadowViews()) {
+        view.refresh_static = !this->shadows_cached;
+    }
+    this->draw_frame.Build(this->camera);
+}
+
+void SyntheticScene::Submit() {
+    using namespace trillek::graphics;
+    this->draw_frame.Commit();
+    this->draw_frame.BindBonePalettes();
+    GLState::Enable(GL_DEPTH_TEST);
+
+    // the static casters of the lights go to the cache when it is stale, then the animated ones
+    const DrawBindings &depth = this->depth_bindings;
+    auto use_depth = [&depth] (const DrawPacket &) -> const DrawBindings& {
+        return depth;
+    };
+    GLState::UseProgram(this->depth_program);
+    glUniform1i(depth.bone_palettes, BONE_PALETTE_UNIT);
+    for(const auto &view : this->draw_frame.GetShadowViews()) {
+        glUniform3f(depth.light_pos, view.light_pos.x, view.light_pos.y, view.light_pos.z);
+        glUniformMatrix4fv(depth.light_vp, 1, GL_FALSE, &view.light_matrix[0][0]);
+        this->draw_frame.SubmitPass(view.static_pass, use_depth);
+        this->draw_frame.SubmitPass(view.pass, use_depth);
+    }
+
+    uint32_t material_index = ~0u;
+    const DrawBindings &color = this->color_bindings;
+    this->draw_frame.SubmitPass(this->draw_frame.GetColorPass(), [&] (const DrawPacket &head) -> const DrawBindings& {
+        if(head.material_index != material_index) {
+            material_index = head.material_index;
+            GLState::UseProgram(this->programs[material_index]);
+            glUniformMatrix4fv(color.view, 1, GL_FALSE, &this->camera.view[0][0]);
+            glUniformMatrix4fv(color.projection, 1, GL_FALSE, &this->camera.projection[0][0]);
+            glUniform1i(color.bone_palettes, BONE_PALETTE_UNIT);
+            GLState::ActiveTexture(GL_TEXTURE0);
+            GLState::BindTexture(GL_TEXTURE_2D, this->textures[material_index]);
+        }
+        return color;
+    });
+    this->draw_frame.EndFrame();
+    GLState::EndFrame();
+    this->shadows_cached = true;
+}
+
+double Percentile(std::vector<double> values, double fraction) {
+    if(values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(std::ceil(fraction * values.size()));
+    return values[std::min(values.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+void WriteStage(std::ostream &out, const char *name, const std::vector<double> &times, bool last) {
+    double sum = 0.0;
+    for(double t : times) {
+        sum += t;
+    }
+    out << "        \"" << name << "\": {"
+        << "\"mean\": " << (times.empty() ? 0.0 : sum / times.size() / 1000.0)
+        << ", \"p50\": " << Percentile(times, 0.5) / 1000.0
+        << ", \"p90\": " << Percentile(times, 0.9) / 1000.0
+        << ", \"p99\": " << Percentile(times, 0.99) / 1000.0
+        << ", \"max\": " << Percentile(times, 1.0) / 1000.0
+        << "}" << (last ? "\n" : ",\n");
+}
+
+// Runs the frames of a scene and writes its JSON object, times in microseconds
+void BenchScene(const SceneConfig &config, unsigned int frames, std::ostream &json, bool last) {
+    using trillek::graphics::NullGL;
+    SyntheticScene scene(config);
+    StageTimes times;
+    const unsigned int warmup = std::min(10u, frames);
+    const NullGL::Counters gl_start = NullGL::GetTotalCounters();
+    const uint64_t gl_start_frame = NullGL::GetFrameCount();
+    for(unsigned int f = 0; f < warmup + frames; f++) {
+        auto start = bench_clock::now();
+        scene.Update(f / 60.0);
+        auto updated = bench_clock::now();
+        scene.BuildDrawList();
+        auto built = bench_clock::now();
+        scene.Submit();
+        auto submitted = bench_clock::now();
+        NullGL::EndFrame(std::chrono::duration_cast<std::chrono::nanoseconds>(submitted - built));
+        if(f < warmup) {
+            continue;
+        }
+        times.update.push_back(std::chrono::duration<double, std::nano>(updated - start).count());
+        times.draw_list.push_back(std::chrono::duration<double, std::nano>(built - updated).count());
+        times.submit.push_back(std::chrono::duration<double, std::nano>(submitted - built).count());
+        times.frame.push_back(std::chrono::duration<double, std::nano>(submitted - start).count());
+    }
+    const NullGL::Counters &gl_end = NullGL::GetTotalCounters();
+    const double gl_frames = static_cast<double>(std::max<uint64_t>(1, NullGL::GetFrameCount() - gl_start_frame));
+
+    std::cout << "scene " << config.name << " x" << config.entities
+        << ": update " << Percentile(times.update, 0.5) / 1000.0 << " us"
+        << ", draw list " << Percentile(times.draw_list, 0.5) / 1000.0 << " us"
+        << ", submit " << Percentile(times.submit, 0.5) / 1000.0 << " us"
+        << ", frame p99 " << Percentile(times.frame, 0.99) / 1000.0 << " us"
+        << ", draws " << (gl_end.draws - gl_start.draws) / gl_frames
+        << ", triangles " << (gl_end.triangles - gl_start.triangles) / gl_frames
+        << std::endl;
+
+    json << "    {\n"
+        << "      \"name\": \"" << config.name << "\",\n"
+        << "      \"entities\": " << config.entities << ",\n"
+        << "      \"meshes\": " << config.meshes << ",\n"
+        << "      \"materials\": " << config.materials << ",\n"
+        << "      \"animated\": " << config.animated << ",\n"
+        << "      \"lights\": " << config.lights << ",\n"
+        << "      \"frames\": " << frames << ",\n"
+        << "      \"stages_us\": {\n";
+    WriteStage(json, "update", times.update, false);
+    WriteStage(json, "draw_list", times.draw_list, false);
+    WriteStage(json, "submit", times.submit, false);
+    WriteStage(json, "frame", times.frame, true);
+    json << "      },\n"
+        << "      \"gl_per_frame\": {"
+        << "\"calls\": " << (gl_end.calls - gl_start.calls) / gl_frames
+        << ", \"draws\": " << (gl_end.draws - gl_start.draws) / gl_frames
+        << ", \"triangles\": " << (gl_end.triangles - gl_start.triangles) / gl_frames
+        << ", \"uniforms\": " << (gl_end.uniforms - gl_start.uniforms) / gl_frames
+        << ", \"binds\": " << (gl_end.binds - gl_start.binds) / gl_frames
+        << ", \"upload_bytes\": " << (gl_end.upload_bytes - gl_start.upload_bytes) / gl_frames
+        << "}\n"
+        << "    }" << (last ? "\n" : ",\n");
+}
+
+// name:entities:meshes:materials:animated:lights
+bool ParseScene(const char *text, SceneConfig &config) {
+    char name[64];
+    unsigned long entities, meshes, materials, lights;
+    float animated;
+    if(std::sscanf(text, "%63[^:]:%lu:%lu:%lu:%f:%lu", name, &entities, &meshes,
+            &materials, &animated, &lights) != 6) {
+        return false;
+    }
+    config = SceneConfig{name, entities, meshes, materials, std::min(1.0f, std::max(0.0f, animated)), lights};
+    return true;
+}
+} // namespace
+
+int main(int argCount, char **argValues) {
+    unsigned int runs = 10;
+    unsigned int frames = 200;
+    std::string json_file;
+    std::vector<SceneConfig> scenes;
+    for(int arg = 1; arg < argCount; arg++) {
+        if(!std::strcmp(argValues[arg], "--frames") && arg + 1 < argCount) {
+            frames = std::max(1, std::atoi(argValues[++arg]));
+        }
+        else if(!std::strcmp(argValues[arg], "--json") && arg + 1 < argCount) {
+            json_file = argValues[++arg];
+        }
+        else if(!std::strcmp(argValues[arg], "--lod-pixels") && arg + 1 < argCount) {
+            gLodPixels = std::max(0.0f, static_cast<float>(std::atof(argValues[++arg])));
+        }
+        else if(!std::strcmp(argValues[arg], "--scene") && arg + 1 < argCount) {
+            SceneConfig config;
+            if(!ParseScene(argValues[++arg], config)) {
+                std::cerr << "--scene takes name:entities:meshes:materials:animated:lights" << std::endl;
+                return 1;
+            }
+            scenes.push_back(config);
+        }
+        else {
+            runs = std::max(1, std::atoi(argValues[arg]));
+        }
+    }
+    if(scenes.empty()) {
+        scenes.push_back(SceneConfig{"small", 1000, 16, 8, 0.1f, 2});
+        scenes.push_back(SceneConfig{"medium", 10000, 64, 32, 0.1f, 4});
+        scenes.push_back(SceneConfig{"large", 50000, 128, 64, 0.05f, 8});
+    }
+
+    const size_t counts[] = { 256, 4096, 65536, 262144 };
+    for(size_t count : counts) {
+        BenchModelMatrices(count, runs);
+    }
+    const size_t rigs[] = { 30, 60, 120 };
+    for(size_t joints : rigs) {
+        BenchSkeleton(joints, runs);
+    }
+
+    std::ostringstream json;
+    json << "{\n  \"workers\": " << trillek::graphics::JobFanout::Workers() << ",\n  \"scenes\": [\n";
+    for(size_t i = 0; i < scenes.size(); i++) {
+        BenchScene(scenes[i], frames, json, i + 1 == scenes.size());
+    }
+    json << "  ]\n}\n";
+    if(!json_file.empty()) {
+        std::ofstream json_out(json_file);
+        if(!(json_out << json.str())) {
+            std::cerr << "Could not write " << json_file << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
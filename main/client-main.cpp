@@ -9,13 +9,39 @@
 #include "systems/meta-engine-system.hpp"
 #include "systems/sound-system.hpp"
 #include "systems/graphics.hpp"
+#include "graphics/job-fanout.hpp"
 #include <iostream>
 
 #include "systems/vcomputer-system.hpp"
 
+#ifdef TRILLEK_HEADLESS_GL
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include "graphics/null-gl.hpp"
+#endif
+
 size_t gAllocatedSize = 0;
 
 int main(int argCount, char **argValues) {
+#ifdef TRILLEK_HEADLESS_GL
+    // --frames N closes the client after N frames, --gl-trace file writes every GL call
+    std::ofstream gl_trace;
+    for(int arg = 1; arg + 1 < argCount; arg++) {
+        if(!std::strcmp(argValues[arg], "--frames")) {
+            trillek::graphics::NullGL::SetFrameLimit(std::strtoull(argValues[++arg], nullptr, 10));
+        }
+        else if(!std::strcmp(argValues[arg], "--gl-trace")) {
+            gl_trace.open(argValues[++arg]);
+            if(gl_trace) {
+                trillek::graphics::NullGL::SetTrace(&gl_trace);
+            }
+            else {
+                std::cerr << "Could not open the GL trace file " << argValues[arg] << std::endl;
+            }
+        }
+    }
+#endif
     trillek::TrillekGame::Initialize();
     std::cout << "Starting Trillek client..." << std::endl;
     // create the window
@@ -73,11 +99,15 @@ int main(int argCount, char **argValues) {
     trillek::VComputerSystem cpu1;
     systems.push(&cpu1);
 
+    // the graphics jobs take the cores the scheduler threads leave
+    const unsigned int scheduler_threads = 5;
+    trillek::graphics::JobPool::ReserveThreads(scheduler_threads);
+
     // start the scheduler in another thread
     std::thread tp(
                    &trillek::TrillekScheduler::Initialize,
                    &trillek::TrillekGame::GetScheduler(),
-                   5,
+                   scheduler_threads,
                    std::ref(systems));
 
     // Start the client network layer
@@ -92,6 +122,10 @@ int main(int argCount, char **argValues) {
         os.OSMessageLoop();
     }
     tp.join();
+#ifdef TRILLEK_HEADLESS_GL
+    trillek::graphics::NullGL::SetTrace(nullptr);
+    trillek::graphics::NullGL::Report(std::cout);
+#endif
 
     // Terminating program
     os.MakeCurrent();
@@ -9,6 +9,7 @@
 #include "systems/meta-engine-system.hpp"
 #include "systems/physics.hpp"
 #include "systems/graphics.hpp"
+#include "graphics/job-fanout.hpp"
 #include "systems/sound-system.hpp"
 #include <cstddef>
 
@@ -72,11 +73,15 @@ int main(int argCount, char **argValues) {
     // Detach the window from the current thread
     os.DetachContext();
 
+    // the graphics jobs take the cores the scheduler threads leave
+    const unsigned int scheduler_threads = 5;
+    trillek::graphics::JobPool::ReserveThreads(scheduler_threads);
+
     // start the scheduler in another thread
     std::thread tp(
                    &trillek::TrillekScheduler::Initialize,
                    &trillek::TrillekGame::GetScheduler(),
-                   5,
+                   scheduler_threads,
                    std::ref(systems));
 /*
     // Start the client network layer
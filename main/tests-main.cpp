@@ -14,6 +14,14 @@
 #include "tests/transform-system-test.h"
 #include "tests/bitmap-test.hpp"
 #include "tests/rewindable-map-test.hpp"
+#include "tests/animation-clip-test.hpp"
+#include "tests/pose-cache-test.hpp"
+#include "tests/draw-list-test.hpp"
+#include "tests/aabb-tree-test.hpp"
+#include "tests/mesh-simplifier-test.hpp"
+#include "tests/shadow-atlas-test.hpp"
+#include "tests/light-grid-test.hpp"
+#include "tests/job-fanout-test.hpp"
 
 size_t gAllocatedSize = 0;
 
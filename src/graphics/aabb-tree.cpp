@@ -0,0 +1,301 @@
+#include "graphics/aabb-tree.hpp"
+#include <cmath>
+
+namespace trillek {
+namespace graphics {
+
+const int32_t AABBTree::NULL_NODE;
+
+AABB AABB::Transform(const glm::mat4 &matrix) const {
+    // each axis of the matrix adds its smallest and largest contribution
+    const glm::vec3 translation(matrix[3].x, matrix[3].y, matrix[3].z);
+    AABB result(translation, translation);
+    for(unsigned int axis = 0; axis < 3; axis++) {
+        const glm::vec3 column(matrix[axis].x, matrix[axis].y, matrix[axis].z);
+        glm::vec3 low = column * this->min[axis];
+        glm::vec3 high = column * this->max[axis];
+        result.min += glm::min(low, high);
+        result.max += glm::max(low, high);
+    }
+    return result;
+}
+
+bool AABB::IntersectRay(const glm::vec3 &origin, const glm::vec3 &inv_direction,
+        float max_distance, float &distance) const {
+    float near = 0.0f;
+    float far = max_distance;
+    for(unsigned int axis = 0; axis < 3; axis++) {
+        float t1 = (this->min[axis] - origin[axis]) * inv_direction[axis];
+        float t2 = (this->max[axis] - origin[axis]) * inv_direction[axis];
+        // a ray parallel to the slab gives NaN when it starts on its plane
+        if(std::isnan(t1) || std::isnan(t2)) {
+            continue;
+        }
+        near = std::max(near, std::min(t1, t2));
+        far = std::min(far, std::max(t1, t2));
+        if(near > far) {
+            return false;
+        }
+    }
+    distance = near;
+    return true;
+}
+
+AABBTree::AABBTree(float margin) : root(NULL_NODE), free_list(NULL_NODE),
+    proxy_count(0), margin(margin) { }
+
+int32_t AABBTree::AllocateNode() {
+    int32_t index;
+    if(this->free_list == NULL_NODE) {
+        index = static_cast<int32_t>(this->nodes.size());
+        this->nodes.push_back(Node());
+    }
+    else {
+        index = this->free_list;
+        this->free_list = this->nodes[index].parent;
+    }
+    Node &node = this->nodes[index];
+    node.parent = NULL_NODE;
+    node.child1 = NULL_NODE;
+    node.child2 = NULL_NODE;
+    node.height = 0;
+    node.entity_id = 0;
+    return index;
+}
+
+void AABBTree::FreeNode(int32_t index) {
+    this->nodes[index].parent = this->free_list;
+    this->nodes[index].height = -1;
+    this->free_list = index;
+}
+
+int32_t AABBTree::CreateProxy(const AABB &box, id_t entity_id) {
+    int32_t proxy = AllocateNode();
+    const glm::vec3 fat(this->margin);
+    this->nodes[proxy].box = AABB(box.min - fat, box.max + fat);
+    this->nodes[proxy].entity_id = entity_id;
+    InsertLeaf(proxy);
+    this->proxy_count++;
+    return proxy;
+}
+
+void AABBTree::DestroyProxy(int32_t proxy) {
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    this->proxy_count--;
+}
+
+bool AABBTree::MoveProxy(int32_t proxy, const AABB &box) {
+    if(this->nodes[proxy].box.Contains(box)) {
+        return false;
+    }
+    RemoveLeaf(proxy);
+    const glm::vec3 fat(this->margin);
+    this->nodes[proxy].box = AABB(box.min - fat, box.max + fat);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void AABBTree::InsertLeaf(int32_t leaf) {
+    if(this->root == NULL_NODE) {
+        this->root = leaf;
+        this->nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    // Walk down to the sibling that grows the total surface area the least.
+    const AABB leaf_box = this->nodes[leaf].box;
+    int32_t index = this->root;
+    while(!this->nodes[index].IsLeaf()) {
+        const Node &node = this->nodes[index];
+        float area = node.box.SurfaceArea();
+        float combined_area = node.box.Union(leaf_box).SurfaceArea();
+        // cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combined_area;
+        // growth of the ancestors if the leaf goes further down
+        float inheritance_cost = 2.0f * (combined_area - area);
+
+        float child_cost[2];
+        const int32_t children[2] = { node.child1, node.child2 };
+        for(unsigned int c = 0; c < 2; c++) {
+            const Node &child = this->nodes[children[c]];
+            float grown_area = leaf_box.Union(child.box).SurfaceArea();
+            child_cost[c] = inheritance_cost + (child.IsLeaf() ? grown_area : grown_area - child.box.SurfaceArea());
+        }
+        if(cost < child_cost[0] && cost < child_cost[1]) {
+            break;
+        }
+        index = child_cost[0] < child_cost[1] ? node.child1 : node.child2;
+    }
+    const int32_t sibling = index;
+
+    // Make a new parent for the sibling and the leaf.
+    const int32_t old_parent = this->nodes[sibling].parent;
+    const int32_t new_parent = AllocateNode();
+    Node &parent = this->nodes[new_parent];
+    parent.parent = old_parent;
+    parent.box = leaf_box.Union(this->nodes[sibling].box);
+    parent.height = this->nodes[sibling].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    if(old_parent != NULL_NODE) {
+        if(this->nodes[old_parent].child1 == sibling) {
+            this->nodes[old_parent].child1 = new_parent;
+        }
+        else {
+            this->nodes[old_parent].child2 = new_parent;
+        }
+    }
+    else {
+        this->root = new_parent;
+    }
+    this->nodes[sibling].parent = new_parent;
+    this->nodes[leaf].parent = new_parent;
+
+    Refit(this->nodes[leaf].parent);
+}
+
+void AABBTree::RemoveLeaf(int32_t leaf) {
+    if(leaf == this->root) {
+        this->root = NULL_NODE;
+        return;
+    }
+    const int32_t parent = this->nodes[leaf].parent;
+    const int32_t grand_parent = this->nodes[parent].parent;
+    const int32_t sibling = this->nodes[parent].child1 == leaf
+        ? this->nodes[parent].child2 : this->nodes[parent].child1;
+
+    // the sibling takes the place of the parent
+    if(grand_parent != NULL_NODE) {
+        if(this->nodes[grand_parent].child1 == parent) {
+            this->nodes[grand_parent].child1 = sibling;
+        }
+        else {
+            this->nodes[grand_parent].child2 = sibling;
+        }
+        this->nodes[sibling].parent = grand_parent;
+        FreeNode(parent);
+        Refit(grand_parent);
+    }
+    else {
+        this->root = sibling;
+        this->nodes[sibling].parent = NULL_NODE;
+        FreeNode(parent);
+    }
+}
+
+void AABBTree::Refit(int32_t index) {
+    // rebalance and fix the boxes and heights up to the root
+    while(index != NULL_NODE) {
+        index = Balance(index);
+        Node &node = this->nodes[index];
+        const Node &child1 = this->nodes[node.child1];
+        const Node &child2 = this->nodes[node.child2];
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.box = child1.box.Union(child2.box);
+        index = node.parent;
+    }
+}
+
+int32_t AABBTree::Balance(int32_t index_a) {
+    Node &a = this->nodes[index_a];
+    if(a.IsLeaf() || a.height < 2) {
+        return index_a;
+    }
+    const int32_t index_b = a.child1;
+    const int32_t index_c = a.child2;
+    Node &b = this->nodes[index_b];
+    Node &c = this->nodes[index_c];
+    const int32_t balance = c.height - b.height;
+
+    // Rotate C up
+    if(balance > 1) {
+        const int32_t index_f = c.child1;
+        const int32_t index_g = c.child2;
+        Node &f = this->nodes[index_f];
+        Node &g = this->nodes[index_g];
+
+        c.child1 = index_a;
+        c.parent = a.parent;
+        a.parent = index_c;
+        if(c.parent != NULL_NODE) {
+            if(this->nodes[c.parent].child1 == index_a) {
+                this->nodes[c.parent].child1 = index_c;
+            }
+            else {
+                this->nodes[c.parent].child2 = index_c;
+            }
+        }
+        else {
+            this->root = index_c;
+        }
+
+        // the taller child of C stays under C, the other one moves to A
+        if(f.height > g.height) {
+            c.child2 = index_f;
+            a.child2 = index_g;
+            g.parent = index_a;
+            a.box = b.box.Union(g.box);
+            c.box = a.box.Union(f.box);
+            a.height = 1 + std::max(b.height, g.height);
+            c.height = 1 + std::max(a.height, f.height);
+        }
+        else {
+            c.child2 = index_g;
+            a.child2 = index_f;
+            f.parent = index_a;
+            a.box = b.box.Union(f.box);
+            c.box = a.box.Union(g.box);
+            a.height = 1 + std::max(b.height, f.height);
+            c.height = 1 + std::max(a.height, g.height);
+        }
+        return index_c;
+    }
+
+    // Rotate B up
+    if(balance < -1) {
+        const int32_t index_d = b.child1;
+        const int32_t index_e = b.child2;
+        Node &d = this->nodes[index_d];
+        Node &e = this->nodes[index_e];
+
+        b.child1 = index_a;
+        b.parent = a.parent;
+        a.parent = index_b;
+        if(b.parent != NULL_NODE) {
+            if(this->nodes[b.parent].child1 == index_a) {
+                this->nodes[b.parent].child1 = index_b;
+            }
+            else {
+                this->nodes[b.parent].child2 = index_b;
+            }
+        }
+        else {
+            this->root = index_b;
+        }
+
+        if(d.height > e.height) {
+            b.child2 = index_d;
+            a.child1 = index_e;
+            e.parent = index_a;
+            a.box = c.box.Union(e.box);
+            b.box = a.box.Union(d.box);
+            a.height = 1 + std::max(c.height, e.height);
+            b.height = 1 + std::max(a.height, d.height);
+        }
+        else {
+            b.child2 = index_e;
+            a.child1 = index_d;
+            d.parent = index_a;
+            a.box = c.box.Union(d.box);
+            b.box = a.box.Union(e.box);
+            a.height = 1 + std::max(c.height, d.height);
+            b.height = 1 + std::max(a.height, e.height);
+        }
+        return index_b;
+    }
+    return index_a;
+}
+
+} // namespace graphics
+} // namespace trillek
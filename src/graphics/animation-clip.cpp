@@ -0,0 +1,479 @@
+#include "graphics/animation-clip.hpp"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TRILLEK_ANIMATION_SSE
+#endif
+
+namespace trillek {
+namespace graphics {
+
+// the smallest three components of a unit quaternion are within +-1/sqrt(2),
+// stored on 15 bits, the top bits of the first two words hold the index of
+// the largest component
+static const float ROTATION_BIAS = 0.70710678f;
+static const float ROTATION_STEP = 2.0f * ROTATION_BIAS / 32767.0f;
+static const float TRANSLATION_STEPS = 65535.0f;
+// the difference a track can have over the clip and still be dropped
+static const float STILL_TOLERANCE = 1e-4f;
+// how far the pinned point of a bone can be from the other bone and still be pinned
+static const float PIN_TOLERANCE = 1e-4f;
+
+static void EncodeRotation(const glm::quat &rotation, uint16_t *out) {
+    const float c[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+    unsigned int largest = 0;
+    for(unsigned int i = 1; i < 4; i++) {
+        if(std::abs(c[i]) > std::abs(c[largest])) {
+            largest = i;
+        }
+    }
+    // q and -q are the same rotation, keep the largest component positive
+    const float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    unsigned int word = 0;
+    for(unsigned int i = 0; i < 4; i++) {
+        if(i == largest) {
+            continue;
+        }
+        float value = (c[i] * sign + ROTATION_BIAS) / ROTATION_STEP + 0.5f;
+        value = std::min(std::max(value, 0.0f), 32767.0f);
+        out[word++] = static_cast<uint16_t>(value);
+    }
+    out[0] |= static_cast<uint16_t>((largest & 1) << 15);
+    out[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+}
+
+static glm::quat DecodeRotation(uint16_t w0, uint16_t w1, uint16_t w2) {
+    const unsigned int largest = (w0 >> 15) | ((w1 >> 15) << 1);
+    const float a = (w0 & 0x7fff) * ROTATION_STEP - ROTATION_BIAS;
+    const float b = (w1 & 0x7fff) * ROTATION_STEP - ROTATION_BIAS;
+    const float c = w2 * ROTATION_STEP - ROTATION_BIAS;
+    const float d = std::sqrt(std::max(0.0f, 1.0f - a * a - b * b - c * c));
+    switch(largest) {
+    case 0:
+        return glm::quat(c, d, a, b);
+    case 1:
+        return glm::quat(c, a, d, b);
+    case 2:
+        return glm::quat(c, a, b, d);
+    default:
+        return glm::quat(d, a, b, c);
+    }
+}
+
+/**
+ * \brief Find a point a on the other bone and b on the bone, such that the
+ * matrices of the two bones move them to the same place on every frame.
+ *
+ * The translation of the bone is then M_other a - R b. It is solved by
+ * least squares: [R_other, -R] (a, b) = t - t_other.
+ * \param const std::vector<glm::mat4>& matrices the matrices of the clip
+ * \param size_t bone_count the matrices per frame
+ * \param size_t bone the bone to pin
+ * \param int32_t other the bone it is pinned to, -1 for the model
+ * \param glm::vec3& point a, set when the bone can be pinned
+ * \param glm::vec3& offset b, set when the bone can be pinned
+ * \return bool true if every frame is within PIN_TOLERANCE
+ */
+static bool FitPin(const std::vector<glm::mat4> &matrices, size_t bone_count, size_t bone, int32_t other,
+        glm::vec3 &point, glm::vec3 &offset) {
+    const size_t frame_count = matrices.size() / bone_count;
+    // the normal equations, with the right hand side in the last column
+    double normal[6][7] = {};
+    for(size_t frame = 0; frame < frame_count; frame++) {
+        const glm::mat4 &m = matrices[frame * bone_count + bone];
+        const glm::mat4 o = other >= 0 ? matrices[frame * bone_count + other] : glm::mat4(1.0f);
+        double columns[7][3];
+        for(unsigned int c = 0; c < 3; c++) {
+            for(unsigned int r = 0; r < 3; r++) {
+                columns[c][r] = o[c][r];
+                columns[c + 3][r] = -m[c][r];
+            }
+        }
+        for(unsigned int r = 0; r < 3; r++) {
+            columns[6][r] = m[3][r] - o[3][r];
+        }
+        for(unsigned int i = 0; i < 6; i++) {
+            for(unsigned int j = 0; j < 7; j++) {
+                normal[i][j] += columns[i][0] * columns[j][0] + columns[i][1] * columns[j][1] +
+                    columns[i][2] * columns[j][2];
+            }
+        }
+    }
+    // the rotations of the two bones may keep the same difference, any
+    // solution then fits, the smallest one is taken
+    for(unsigned int i = 0; i < 6; i++) {
+        normal[i][i] += 1e-9 * frame_count;
+    }
+    for(unsigned int i = 0; i < 6; i++) {
+        unsigned int pivot = i;
+        for(unsigned int j = i + 1; j < 6; j++) {
+            if(std::abs(normal[j][i]) > std::abs(normal[pivot][i])) {
+                pivot = j;
+            }
+        }
+        for(unsigned int k = 0; k < 7; k++) {
+            std::swap(normal[i][k], normal[pivot][k]);
+        }
+        for(unsigned int j = i + 1; j < 6; j++) {
+            const double factor = normal[j][i] / normal[i][i];
+            for(unsigned int k = i; k < 7; k++) {
+                normal[j][k] -= factor * normal[i][k];
+            }
+        }
+    }
+    double solution[6];
+    for(unsigned int i = 6; i-- > 0;) {
+        double sum = normal[i][6];
+        for(unsigned int k = i + 1; k < 6; k++) {
+            sum -= normal[i][k] * solution[k];
+        }
+        solution[i] = sum / normal[i][i];
+    }
+    const glm::vec4 a(static_cast<float>(solution[0]), static_cast<float>(solution[1]),
+        static_cast<float>(solution[2]), 1.0f);
+    const glm::vec4 b(static_cast<float>(solution[3]), static_cast<float>(solution[4]),
+        static_cast<float>(solution[5]), 1.0f);
+    for(size_t frame = 0; frame < frame_count; frame++) {
+        const glm::mat4 &m = matrices[frame * bone_count + bone];
+        const glm::vec4 moved_a = other >= 0 ? matrices[frame * bone_count + other] * a : a;
+        const glm::vec4 moved_b = m * b;
+        if(std::abs(moved_a.x - moved_b.x) > PIN_TOLERANCE || std::abs(moved_a.y - moved_b.y) > PIN_TOLERANCE ||
+                std::abs(moved_a.z - moved_b.z) > PIN_TOLERANCE) {
+            return false;
+        }
+    }
+    point = glm::vec3(a);
+    offset = glm::vec3(b);
+    return true;
+}
+
+std::atomic<uint32_t> AnimationClip::next_id(1);
+
+AnimationClip::AnimationClip(size_t bone_count, float frame_rate, const std::vector<glm::mat4> &matrices) :
+    id(next_id++), bone_count(bone_count), frame_count(bone_count ? matrices.size() / bone_count : 0), frame_rate(frame_rate),
+    reach(0.0f), translation_count(0) {
+    std::vector<glm::quat> rotations(this->bone_count * this->frame_count);
+    for(size_t i = 0; i < rotations.size(); i++) {
+        // the bones are rigid, the matrix is only a rotation and a translation
+        rotations[i] = glm::normalize(glm::quat_cast(matrices[i]));
+        this->reach = std::max(this->reach, glm::length(glm::vec3(matrices[i][3])));
+    }
+    std::vector<uint32_t> pinned;
+    for(size_t bone = 0; bone < this->bone_count; bone++) {
+        const glm::quat &first = rotations[bone];
+        const glm::vec3 origin(matrices[bone][3]);
+        bool still = true;
+        for(size_t frame = 1; still && frame < this->frame_count; frame++) {
+            const size_t i = frame * this->bone_count + bone;
+            const float sign = glm::dot(first, rotations[i]) < 0.0f ? -1.0f : 1.0f;
+            const glm::vec3 translation(matrices[i][3]);
+            still = std::abs(rotations[i].x * sign - first.x) <= STILL_TOLERANCE &&
+                std::abs(rotations[i].y * sign - first.y) <= STILL_TOLERANCE &&
+                std::abs(rotations[i].z * sign - first.z) <= STILL_TOLERANCE &&
+                std::abs(rotations[i].w * sign - first.w) <= STILL_TOLERANCE &&
+                std::abs(translation.x - origin.x) <= STILL_TOLERANCE &&
+                std::abs(translation.y - origin.y) <= STILL_TOLERANCE &&
+                std::abs(translation.z - origin.z) <= STILL_TOLERANCE;
+        }
+        if(still) {
+            this->still_bones.push_back(static_cast<uint32_t>(bone));
+            this->still_matrices.push_back(matrices[bone]);
+            continue;
+        }
+        // A joint fixed in the model is pinned to it, which adds no error of
+        // another bone. Else the parent comes first in the files, so the
+        // closest bones before this one are tried first, they are sampled
+        // before it.
+        glm::vec3 point, offset;
+        int32_t other = -1;
+        bool pin = FitPin(matrices, this->bone_count, bone, other, point, offset);
+        if(!pin) {
+            for(other = static_cast<int32_t>(bone) - 1; other >= 0; other--) {
+                if(FitPin(matrices, this->bone_count, bone, other, point, offset)) {
+                    pin = true;
+                    break;
+                }
+            }
+        }
+        if(pin) {
+            pinned.push_back(static_cast<uint32_t>(bone));
+            this->pin_bones.push_back(other);
+            this->pin_points.push_back(glm::vec4(point, 1.0f));
+            this->pin_offsets.push_back(glm::vec4(offset, 0.0f));
+        }
+        else {
+            this->track_bones.push_back(static_cast<uint32_t>(bone));
+        }
+    }
+    this->translation_count = this->track_bones.size();
+    this->track_bones.insert(this->track_bones.end(), pinned.begin(), pinned.end());
+
+    const size_t track_count = this->track_bones.size();
+    const size_t size = track_count * this->frame_count;
+    this->r0.resize(size); this->r1.resize(size); this->r2.resize(size);
+    for(size_t track = 0; track < track_count; track++) {
+        for(size_t frame = 0; frame < this->frame_count; frame++) {
+            const size_t i = frame * track_count + track;
+            uint16_t words[3];
+            EncodeRotation(rotations[frame * this->bone_count + this->track_bones[track]], words);
+            this->r0[i] = words[0];
+            this->r1[i] = words[1];
+            this->r2[i] = words[2];
+        }
+    }
+
+    const size_t translation_size = this->translation_count * this->frame_count;
+    this->tx.resize(translation_size); this->ty.resize(translation_size); this->tz.resize(translation_size);
+    this->min_x.resize(this->translation_count);
+    this->min_y.resize(this->translation_count);
+    this->min_z.resize(this->translation_count);
+    this->step_x.resize(this->translation_count);
+    this->step_y.resize(this->translation_count);
+    this->step_z.resize(this->translation_count);
+    for(size_t track = 0; track < this->translation_count; track++) {
+        const size_t bone = this->track_bones[track];
+        glm::vec3 low(matrices[bone][3]), high(low);
+        for(size_t frame = 1; frame < this->frame_count; frame++) {
+            const glm::vec4 &translation = matrices[frame * this->bone_count + bone][3];
+            low = glm::vec3(std::min(low.x, translation.x), std::min(low.y, translation.y),
+                std::min(low.z, translation.z));
+            high = glm::vec3(std::max(high.x, translation.x), std::max(high.y, translation.y),
+                std::max(high.z, translation.z));
+        }
+        this->min_x[track] = low.x;
+        this->min_y[track] = low.y;
+        this->min_z[track] = low.z;
+        this->step_x[track] = (high.x - low.x) / TRANSLATION_STEPS;
+        this->step_y[track] = (high.y - low.y) / TRANSLATION_STEPS;
+        this->step_z[track] = (high.z - low.z) / TRANSLATION_STEPS;
+        for(size_t frame = 0; frame < this->frame_count; frame++) {
+            const glm::vec4 &translation = matrices[frame * this->bone_count + bone][3];
+            const size_t i = frame * this->translation_count + track;
+            this->tx[i] = static_cast<uint16_t>(this->step_x[track] > 0.0f ?
+                (translation.x - low.x) / this->step_x[track] + 0.5f : 0.0f);
+            this->ty[i] = static_cast<uint16_t>(this->step_y[track] > 0.0f ?
+                (translation.y - low.y) / this->step_y[track] + 0.5f : 0.0f);
+            this->tz[i] = static_cast<uint16_t>(this->step_z[track] > 0.0f ?
+                (translation.z - low.z) / this->step_z[track] + 0.5f : 0.0f);
+        }
+    }
+}
+
+size_t AnimationClip::GetMemorySize() const {
+    return this->still_bones.size() * (sizeof(uint32_t) + sizeof(glm::mat4)) +
+        this->track_bones.size() * sizeof(uint32_t) +
+        this->translation_count * 6 * sizeof(float) +
+        this->pin_bones.size() * (sizeof(int32_t) + 2 * sizeof(glm::vec4)) +
+        this->r0.size() * 3 * sizeof(uint16_t) +
+        this->tx.size() * 3 * sizeof(uint16_t);
+}
+
+void AnimationClip::SampleScalar(size_t frame0, size_t frame1, float blend, size_t track, glm::mat4 *out) const {
+    const size_t track_count = this->track_bones.size();
+    const size_t i0 = frame0 * track_count + track, i1 = frame1 * track_count + track;
+    const glm::quat a = DecodeRotation(this->r0[i0], this->r1[i0], this->r2[i0]);
+    glm::quat b = DecodeRotation(this->r0[i1], this->r1[i1], this->r2[i1]);
+    if(glm::dot(a, b) < 0.0f) {
+        // the other side of the sphere is the shorter way
+        b = -b;
+    }
+    float x = a.x + (b.x - a.x) * blend, y = a.y + (b.y - a.y) * blend;
+    float z = a.z + (b.z - a.z) * blend, w = a.w + (b.w - a.w) * blend;
+    const float length = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+    x *= length; y *= length; z *= length; w *= length;
+    // same terms as glm::mat4_cast
+    const float xx = x * x, yy = y * y, zz = z * z;
+    const float xy = x * y, xz = x * z, yz = y * z;
+    const float wx = w * x, wy = w * y, wz = w * z;
+    glm::mat4 &m = out[this->track_bones[track]];
+    m[0] = glm::vec4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f);
+    m[1] = glm::vec4(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f);
+    m[2] = glm::vec4(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f);
+    if(track >= this->translation_count) {
+        m[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return;
+    }
+    const size_t t0 = frame0 * this->translation_count + track, t1 = frame1 * this->translation_count + track;
+    const float t0x = this->tx[t0], t0y = this->ty[t0], t0z = this->tz[t0];
+    m[3] = glm::vec4(this->min_x[track] + (t0x + (this->tx[t1] - t0x) * blend) * this->step_x[track],
+        this->min_y[track] + (t0y + (this->ty[t1] - t0y) * blend) * this->step_y[track],
+        this->min_z[track] + (t0z + (this->tz[t1] - t0z) * blend) * this->step_z[track], 1.0f);
+}
+
+#ifdef TRILLEK_ANIMATION_SSE
+// widen 4 words to 4 integers
+static inline __m128i LoadWords(const uint16_t *words) {
+    return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(words)), _mm_setzero_si128());
+}
+
+static inline __m128 Select(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// the rotations of 4 tracks, one component per register
+static inline void DecodeRotations(const uint16_t *w0, const uint16_t *w1, const uint16_t *w2,
+        __m128 &x, __m128 &y, __m128 &z, __m128 &w) {
+    const __m128 step = _mm_set1_ps(ROTATION_STEP);
+    const __m128 bias = _mm_set1_ps(ROTATION_BIAS);
+    const __m128i low = _mm_set1_epi32(0x7fff);
+    const __m128i i0 = LoadWords(w0), i1 = LoadWords(w1), i2 = LoadWords(w2);
+    const __m128i largest = _mm_or_si128(_mm_srli_epi32(i0, 15), _mm_slli_epi32(_mm_srli_epi32(i1, 15), 1));
+    const __m128 a = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(i0, low)), step), bias);
+    const __m128 b = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(i1, low)), step), bias);
+    const __m128 c = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(i2), step), bias);
+    const __m128 d = _mm_sqrt_ps(_mm_max_ps(_mm_setzero_ps(), _mm_sub_ps(_mm_set1_ps(1.0f),
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)), _mm_mul_ps(c, c)))));
+    const __m128 is0 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_setzero_si128()));
+    const __m128 is1 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(1)));
+    const __m128 is2 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(2)));
+    const __m128 is3 = _mm_castsi128_ps(_mm_cmpeq_epi32(largest, _mm_set1_epi32(3)));
+    // the stored components are the others in order: a b c fill the slots around d
+    x = Select(is0, d, a);
+    y = Select(is0, a, Select(is1, d, b));
+    z = Select(is3, c, Select(is2, d, b));
+    w = Select(is3, d, c);
+}
+#endif
+
+void AnimationClip::Sample(size_t frame0, size_t frame1, float blend, glm::mat4 *out) const {
+    if(!this->frame_count) {
+        return;
+    }
+    for(size_t i = 0; i < this->still_bones.size(); i++) {
+        out[this->still_bones[i]] = this->still_matrices[i];
+    }
+    frame0 %= this->frame_count;
+    frame1 %= this->frame_count;
+    SampleTracks(frame0, frame1, blend, 0, this->translation_count, out);
+    SampleTracks(frame0, frame1, blend, this->translation_count, this->track_bones.size(), out);
+    // The pinned tracks are in bone order, so their other bone is done. The
+    // w of the joint is 1 and the rotation columns have a w of 0, so the
+    // translation comes out with a w of 1.
+    for(size_t pin = 0; pin < this->pin_bones.size(); pin++) {
+        glm::mat4 &m = out[this->track_bones[this->translation_count + pin]];
+#ifdef TRILLEK_ANIMATION_SSE
+        const __m128 offset = _mm_loadu_ps(&this->pin_offsets[pin][0]);
+        const __m128 moved = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m[0][0]), _mm_shuffle_ps(offset, offset, _MM_SHUFFLE(0, 0, 0, 0))),
+                _mm_mul_ps(_mm_loadu_ps(&m[1][0]), _mm_shuffle_ps(offset, offset, _MM_SHUFFLE(1, 1, 1, 1)))),
+            _mm_mul_ps(_mm_loadu_ps(&m[2][0]), _mm_shuffle_ps(offset, offset, _MM_SHUFFLE(2, 2, 2, 2))));
+        const __m128 point = _mm_loadu_ps(&this->pin_points[pin][0]);
+        if(this->pin_bones[pin] < 0) {
+            _mm_storeu_ps(&m[3][0], _mm_sub_ps(point, moved));
+            continue;
+        }
+        // the translation of the other bone may have just been written, it
+        // is added last so a chain of bones waits on one add per bone
+        const glm::mat4 &o = out[this->pin_bones[pin]];
+        const __m128 rotated = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&o[0][0]), _mm_shuffle_ps(point, point, _MM_SHUFFLE(0, 0, 0, 0))),
+                _mm_mul_ps(_mm_loadu_ps(&o[1][0]), _mm_shuffle_ps(point, point, _MM_SHUFFLE(1, 1, 1, 1)))),
+            _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(&o[2][0]), _mm_shuffle_ps(point, point, _MM_SHUFFLE(2, 2, 2, 2))),
+                moved));
+        _mm_storeu_ps(&m[3][0], _mm_add_ps(rotated, _mm_loadu_ps(&o[3][0])));
+#else
+        const glm::vec4 &offset = this->pin_offsets[pin];
+        glm::vec4 joint = this->pin_points[pin];
+        if(this->pin_bones[pin] >= 0) {
+            joint = out[this->pin_bones[pin]] * joint;
+        }
+        m[3] = joint - m[0] * offset.x - m[1] * offset.y - m[2] * offset.z;
+#endif
+    }
+}
+
+void AnimationClip::SampleTracks(size_t frame0, size_t frame1, float blend, size_t first, size_t last,
+        glm::mat4 *out) const {
+    size_t track = first;
+#ifdef TRILLEK_ANIMATION_SSE
+    const size_t track_count = this->track_bones.size();
+    const bool translated = last <= this->translation_count;
+    const __m128 t = _mm_set1_ps(blend);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for(; track + 4 <= last; track += 4) {
+        // each register holds one term of 4 tracks
+        const size_t i0 = frame0 * track_count + track, i1 = frame1 * track_count + track;
+        __m128 ax, ay, az, aw, bx, by, bz, bw;
+        DecodeRotations(&this->r0[i0], &this->r1[i0], &this->r2[i0], ax, ay, az, aw);
+        DecodeRotations(&this->r0[i1], &this->r1[i1], &this->r2[i1], bx, by, bz, bw);
+        const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+            _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        // the other side of the sphere is the shorter way
+        const __m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, zero), sign);
+        bx = _mm_xor_ps(bx, flip); by = _mm_xor_ps(by, flip);
+        bz = _mm_xor_ps(bz, flip); bw = _mm_xor_ps(bw, flip);
+        __m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t));
+        __m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t));
+        __m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t));
+        __m128 w = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+        const __m128 length = _mm_div_ps(one, _mm_sqrt_ps(_mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)))));
+        x = _mm_mul_ps(x, length); y = _mm_mul_ps(y, length);
+        z = _mm_mul_ps(z, length); w = _mm_mul_ps(w, length);
+
+        const __m128 x2 = _mm_add_ps(x, x);
+        const __m128 y2 = _mm_add_ps(y, y);
+        const __m128 z2 = _mm_add_ps(z, z);
+        const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+        __m128 rows[4][4];
+        rows[0][0] = _mm_sub_ps(one, _mm_add_ps(yy, zz));
+        rows[0][1] = _mm_add_ps(xy, wz);
+        rows[0][2] = _mm_sub_ps(xz, wy);
+        rows[0][3] = zero;
+        rows[1][0] = _mm_sub_ps(xy, wz);
+        rows[1][1] = _mm_sub_ps(one, _mm_add_ps(xx, zz));
+        rows[1][2] = _mm_add_ps(yz, wx);
+        rows[1][3] = zero;
+        rows[2][0] = _mm_add_ps(xz, wy);
+        rows[2][1] = _mm_sub_ps(yz, wx);
+        rows[2][2] = _mm_sub_ps(one, _mm_add_ps(xx, yy));
+        rows[2][3] = zero;
+        rows[3][0] = zero;
+        rows[3][1] = zero;
+        rows[3][2] = zero;
+        rows[3][3] = one;
+        if(translated) {
+            const size_t t0 = frame0 * this->translation_count + track;
+            const size_t t1 = frame1 * this->translation_count + track;
+            const __m128 t0x = _mm_cvtepi32_ps(LoadWords(&this->tx[t0]));
+            const __m128 t0y = _mm_cvtepi32_ps(LoadWords(&this->ty[t0]));
+            const __m128 t0z = _mm_cvtepi32_ps(LoadWords(&this->tz[t0]));
+            const __m128 t1x = _mm_cvtepi32_ps(LoadWords(&this->tx[t1]));
+            const __m128 t1y = _mm_cvtepi32_ps(LoadWords(&this->ty[t1]));
+            const __m128 t1z = _mm_cvtepi32_ps(LoadWords(&this->tz[t1]));
+            rows[3][0] = _mm_add_ps(_mm_load_ps(&this->min_x[track]), _mm_mul_ps(_mm_load_ps(&this->step_x[track]),
+                _mm_add_ps(t0x, _mm_mul_ps(_mm_sub_ps(t1x, t0x), t))));
+            rows[3][1] = _mm_add_ps(_mm_load_ps(&this->min_y[track]), _mm_mul_ps(_mm_load_ps(&this->step_y[track]),
+                _mm_add_ps(t0y, _mm_mul_ps(_mm_sub_ps(t1y, t0y), t))));
+            rows[3][2] = _mm_add_ps(_mm_load_ps(&this->min_z[track]), _mm_mul_ps(_mm_load_ps(&this->step_z[track]),
+                _mm_add_ps(t0z, _mm_mul_ps(_mm_sub_ps(t1z, t0z), t))));
+        }
+
+        glm::mat4 *m0 = &out[this->track_bones[track]];
+        glm::mat4 *m1 = &out[this->track_bones[track + 1]];
+        glm::mat4 *m2 = &out[this->track_bones[track + 2]];
+        glm::mat4 *m3 = &out[this->track_bones[track + 3]];
+        for(unsigned int c = 0; c < 4; c++) {
+            // turn the 4 terms of a column into the column of each matrix
+            _MM_TRANSPOSE4_PS(rows[c][0], rows[c][1], rows[c][2], rows[c][3]);
+            _mm_storeu_ps(&(*m0)[c][0], rows[c][0]);
+            _mm_storeu_ps(&(*m1)[c][0], rows[c][1]);
+            _mm_storeu_ps(&(*m2)[c][0], rows[c][2]);
+            _mm_storeu_ps(&(*m3)[c][0], rows[c][3]);
+        }
+    }
+#endif
+    for(; track < last; track++) {
+        SampleScalar(frame0, frame1, blend, track, out);
+    }
+}
+
+} // namespace graphics
+} // namespace trillek
@@ -0,0 +1,70 @@
+#include "graphics/animation.hpp"
+#include "resources/md5anim.hpp"
+
+#include <vector>
+#include <map>
+#include <mutex>
+#include <glm/glm.hpp>
+
+namespace trillek {
+namespace graphics {
+
+// The clips are baked from the animation files here, apart from the playback,
+// so the benchmarks play clips without linking the resource loaders.
+
+typedef std::weak_ptr<resource::MD5Anim> file_ref;
+
+// the clips in use, by the control block of their file
+static std::mutex clip_mutex;
+static std::map<file_ref, std::weak_ptr<const AnimationClip>, std::owner_less<file_ref>> clips;
+
+/**
+ * \brief Get the clip baked from a file, shared by all the animations playing it.
+ *
+ * \param const std::shared_ptr<resource::MD5Anim>& file the animation file
+ * \return std::shared_ptr<const AnimationClip> the clip
+ */
+static std::shared_ptr<const AnimationClip> GetClip(const std::shared_ptr<resource::MD5Anim> &file) {
+    std::lock_guard<std::mutex> lock(clip_mutex);
+    auto found = clips.find(file);
+    if (found != clips.end()) {
+        std::shared_ptr<const AnimationClip> clip = found->second.lock();
+        if (clip) {
+            return clip;
+        }
+    }
+    // forget the clips nobody plays anymore before adding one
+    for (auto itr = clips.begin(); itr != clips.end();) {
+        if (itr->second.expired()) {
+            itr = clips.erase(itr);
+        }
+        else {
+            ++itr;
+        }
+    }
+    const size_t frame_count = file->GetFrameCount();
+    size_t bone_count = 0;
+    std::vector<glm::mat4> matrices;
+    for (size_t frame = 0; frame < frame_count; frame++) {
+        auto skeleton = file->InterpolateSkeletons(frame, frame, 0.0f);
+        if (frame == 0) {
+            bone_count = skeleton.bone_matricies.size();
+            matrices.reserve(bone_count * frame_count);
+        }
+        skeleton.bone_matricies.resize(bone_count);
+        matrices.insert(matrices.end(), skeleton.bone_matricies.begin(), skeleton.bone_matricies.end());
+    }
+    std::shared_ptr<const AnimationClip> clip = std::make_shared<AnimationClip>(
+        bone_count, static_cast<float>(file->GetFrameRate()), matrices);
+    clips[file] = clip;
+    return clip;
+}
+
+void Animation::SetAnimationFile(std::shared_ptr<resource::MD5Anim> file) {
+    if (file) {
+        SetClip(GetClip(file));
+    }
+}
+
+} // End of graphics
+} // End of trillek
@@ -4,8 +4,6 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
-#include "resources/md5anim.hpp"
-
 namespace trillek {
 namespace graphics {
 
@@ -23,32 +21,41 @@ void Animation::UpdateAnimation(const float delta) {
         this->animation_time += this->frame_duration;
     }
 
-    // Figure out which frame we're on
+    // Figure out which frame we're on, and how far it is to the next one
     float frame_number = this->animation_time * frame_rate;
-    int frame_index0 = (int)floorf(frame_number);
-    int frame_index1 = (int)ceilf(frame_number);
-    frame_index0 = frame_index0 % frame_count;
-    frame_index1 = frame_index1 % frame_count;
-
-    float fInterpolate = fmodf(this->animation_time, this->frame_duration);
+    float frame_floor = floorf(frame_number);
+    this->current_frame_index = static_cast<size_t>(frame_floor) % frame_count;
+    this->frame_blend = frame_number - frame_floor;
+}
 
-    if (this->animation_file) {
-        auto frame_skeleton = this->animation_file->InterpolateSkeletons(
-            frame_index0, frame_index1, fInterpolate);
-        this->animation_matricies.assign(frame_skeleton.bone_matricies.begin(), frame_skeleton.bone_matricies.end());
+void Animation::UpdatePose(const AnimationLOD &lod, uint64_t frame, uint32_t phase) {
+    if (this->frame_count < 1) {
+        return;
+    }
+    if (lod.interval == 0) {
+        this->pose_stale = true;
+        return;
+    }
+    if (!this->pose_stale && (frame + phase) % lod.interval != 0) {
+        return;
+    }
+    this->pose_stale = false;
+    this->pose_frame = this->current_frame_index;
+    this->pose_blend = this->frame_blend;
+    if (lod.snap) {
+        if (this->pose_blend >= 0.5f) {
+            this->pose_frame = (this->pose_frame + 1) % this->frame_count;
+        }
+        this->pose_blend = 0.0f;
     }
 }
 
-void Animation::SetAnimationFile(std::shared_ptr<resource::MD5Anim> file) {
-    if (file) {
-        this->animation_file = file;
-        this->frame_count = this->animation_file->GetFrameCount();
-        this->frame_rate = static_cast<float>(this->animation_file->GetFrameRate());
+void Animation::SetClip(std::shared_ptr<const AnimationClip> clip) {
+    this->clip = std::move(clip);
+    this->frame_count = this->clip ? this->clip->GetFrameCount() : 0;
+    if (this->frame_count) {
+        this->frame_rate = this->clip->GetFrameRate();
         this->frame_duration = 1.0f / this->frame_rate * this->frame_count;
-
-        auto frame_skeleton = this->animation_file->InterpolateSkeletons(
-            0, 1, 0.0f);
-        this->animation_matricies.assign(frame_skeleton.bone_matricies.begin(), frame_skeleton.bone_matricies.end());
     }
 }
 
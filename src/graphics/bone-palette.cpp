@@ -0,0 +1,69 @@
+#include "graphics/bone-palette.hpp"
+#include "graphics/gl-state.hpp"
+#include <algorithm>
+
+namespace trillek {
+namespace graphics {
+
+BonePaletteBuffer::BonePaletteBuffer() : texture(0), texture_buffer(0), max_texels(0) { }
+
+BonePaletteBuffer::~BonePaletteBuffer() {
+    if(this->texture) {
+        GLState::DeleteTextures(1, &this->texture);
+    }
+}
+
+bool BonePaletteBuffer::Create(size_t matrix_count) {
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &this->max_texels);
+    bool persistent = this->stream.Create(GL_TEXTURE_BUFFER, sizeof(glm::mat4) * std::max<size_t>(matrix_count, 1));
+    if(!this->texture) {
+        glGenTextures(1, &this->texture);
+    }
+    this->texture_buffer = 0;
+    this->range = StreamBuffer::Range();
+    return persistent;
+}
+
+glm::mat4* BonePaletteBuffer::BeginFrame(size_t matrix_count) {
+    this->range = StreamBuffer::Range();
+    const size_t size = sizeof(glm::mat4) * matrix_count;
+    if(size > this->stream.GetFrameSize()) {
+        // Reserve() at least doubles the regions, the texture must still reach all of them
+        const size_t regions = this->stream.IsPersistent() ? StreamBuffer::FRAMES : 1;
+        const size_t grown = std::max(size, this->stream.GetFrameSize() * 2);
+        if(grown * regions / sizeof(glm::vec4) > static_cast<size_t>(this->max_texels)) {
+            this->stream.BeginFrame();
+            return nullptr;
+        }
+        this->stream.Reserve(size);
+    }
+    if(this->stream.GetBuffer() != this->texture_buffer) {
+        this->texture_buffer = this->stream.GetBuffer();
+        GLState::BindTexture(GL_TEXTURE_BUFFER, this->texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, this->texture_buffer);
+        GLState::BindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+    this->stream.BeginFrame();
+    if(!matrix_count) {
+        return nullptr;
+    }
+    this->range = this->stream.Allocate(size, sizeof(glm::vec4));
+    return static_cast<glm::mat4*>(this->range.data);
+}
+
+void BonePaletteBuffer::Commit() const {
+    this->stream.Commit();
+}
+
+void BonePaletteBuffer::Bind(GLuint unit) const {
+    GLState::ActiveTexture(GL_TEXTURE0 + unit);
+    GLState::BindTexture(GL_TEXTURE_BUFFER, this->texture);
+    GLState::ActiveTexture(GL_TEXTURE0);
+}
+
+void BonePaletteBuffer::EndFrame() {
+    this->stream.EndFrame();
+}
+
+} // namespace graphics
+} // namespace trillek
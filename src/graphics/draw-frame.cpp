@@ -0,0 +1,346 @@
+#include "graphics/draw-frame.hpp"
+#include "graphics/job-fanout.hpp"
+#include "graphics/mesh-simplifier.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace trillek {
+namespace graphics {
+
+// draw lists smaller than this are built on the calling thread alone
+static const size_t PARALLEL_MIN_PACKETS = 1024;
+
+// poses fewer than this are evaluated on the calling thread alone
+static const size_t ANIMATION_MIN_PER_JOB = 16;
+
+// The animation tiers, by distance to the camera: full rate, every 2nd
+// frame, then every 4th and 8th frame on the nearest key frame.
+static const AnimationLOD ANIMATION_LODS[DrawFrame::ANIMATION_LOD_COUNT] = { {1, false}, {2, false}, {4, true}, {8, true} };
+static const float ANIMATION_LOD_DISTANCES[DrawFrame::ANIMATION_LOD_COUNT - 1] = { 25.0f, 50.0f, 100.0f };
+
+// The mesh levels: the simplification error a level may show, in pixels, and
+// the part of it a coarser level must stay under before it is drawn, so a mesh
+// at the threshold does not switch back and forth.
+static const float MESH_LOD_PIXELS = 1.0f;
+static const float MESH_LOD_HYSTERESIS = 0.25f;
+
+DrawFrame::DrawFrame(ModelMatrixStore &model_matrices) : model_matrices(model_matrices), palette_overflow(0),
+        animation_lod_distances(ANIMATION_LOD_DISTANCES, ANIMATION_LOD_DISTANCES + ANIMATION_LOD_COUNT - 1),
+        animation_frame(0), mesh_lod_pixels(MESH_LOD_PIXELS) { }
+
+void DrawFrame::BeginAnimations() {
+    this->pose_cache.Clear();
+    this->animation_frame++;
+}
+
+void DrawFrame::UpdateAnimation(Animation &animation, float delta, uint32_t phase) {
+    animation.UpdateAnimation(delta);
+    animation.UpdatePose(GetAnimationLOD(animation), this->animation_frame, phase);
+    // measured again by the culling of this frame
+    animation.lod_visible = false;
+    animation.lod_distance = std::numeric_limits<float>::infinity();
+    animation.pose_request = PoseCache::NO_POSE;
+    if(animation.clip && animation.frame_count) {
+        animation.pose_request = this->pose_cache.Request(*animation.clip, animation.pose_frame, animation.pose_blend);
+    }
+}
+
+void DrawFrame::EvaluatePoses() {
+    this->pose_cache.Evaluate(ANIMATION_MIN_PER_JOB);
+}
+
+AnimationLOD DrawFrame::GetAnimationLOD(const Animation &animation) const {
+    if(!animation.lod_visible) {
+        // hold the pose of the animations nobody sees
+        return AnimationLOD{0, false};
+    }
+    size_t tier = 0;
+    while(tier < this->animation_lod_distances.size() && animation.lod_distance >= this->animation_lod_distances[tier]) {
+        ++tier;
+    }
+    return ANIMATION_LODS[tier];
+}
+
+void DrawFrame::Build(const DrawCamera &camera) {
+    // the packets of the entities removed since the last frame go first
+    this->draw_list.Compact();
+    const size_t packet_count = this->draw_list.Size();
+    // acquiring a slot changes the store, so it stays on this thread
+    for(auto &packet : this->draw_list) {
+        if(!this->model_matrices.IsValid(packet.matrix)) {
+            packet.matrix = this->model_matrices.Acquire(packet.entity_id);
+        }
+    }
+    // pixels covered by a unit at a distance of 1 from the camera
+    const float projection_scale = 0.5f * camera.viewport_height * camera.projection[1][1];
+    JobFanout::ForRanges(packet_count, PARALLEL_MIN_PACKETS,
+            [this, &camera, projection_scale] (size_t first, size_t last) {
+        for(size_t i = first; i < last; ++i) {
+            DrawPacket &packet = this->draw_list[i];
+            const glm::mat4 &model_matrix = this->model_matrices[packet.matrix];
+            const glm::vec4 view_position = camera.view * model_matrix[3];
+            // the camera looks down -Z in view space
+            float view_depth = -view_position.z;
+            DrawList::SetDepth(packet, DrawList::QuantizeDepth(view_depth, camera.far_plane));
+            if(packet.level_count > 1) {
+                // The level follows the distance rather than the depth, so it
+                // does not change when the camera only turns.
+                float axis_scale = std::max(glm::length(glm::vec3(model_matrix[0])),
+                    std::max(glm::length(glm::vec3(model_matrix[1])), glm::length(glm::vec3(model_matrix[2]))));
+                float distance = std::max(glm::length(glm::vec3(view_position)), camera.near_plane);
+                DrawList::SetLevel(packet, MeshSimplifier::SelectLevel(packet.levels, packet.level_count,
+                    packet.level, projection_scale * axis_scale / distance, this->mesh_lod_pixels, MESH_LOD_HYSTERESIS));
+            }
+        }
+    });
+    this->draw_list.Sort();
+
+    UpdateBonePalettes();
+
+    // Bounding spheres in world space, in the sorted order. The radius is
+    // scaled by the largest axis scale. The bones move the vertices of the
+    // animated meshes out of their bind pose sphere, by the reach of their
+    // clip at most, so their sphere grows by it.
+    this->world_bounds.Resize(packet_count);
+    JobFanout::ForRanges(packet_count, PARALLEL_MIN_PACKETS, [this] (size_t first, size_t last) {
+        for(size_t i = first; i < last; ++i) {
+            const DrawPacket &packet = this->draw_list[i];
+            const glm::mat4 &model_matrix = this->model_matrices[packet.matrix];
+            const glm::vec3 bounds_center(packet.bounds.x, packet.bounds.y, packet.bounds.z);
+            glm::vec4 center = model_matrix * glm::vec4(bounds_center, 1.0f);
+            float radius = packet.bounds.w;
+            if(packet.animation && packet.animation->clip) {
+                radius += 2.0f * glm::length(bounds_center) + packet.animation->clip->GetReach();
+            }
+            float axis_scale = std::max(glm::length(glm::vec3(model_matrix[0])),
+                std::max(glm::length(glm::vec3(model_matrix[1])), glm::length(glm::vec3(model_matrix[2]))));
+            this->world_bounds.Set(i, glm::vec3(center), radius * axis_scale);
+        }
+    });
+
+    // One job per view: the camera builds the color pass, each shadow view
+    // culls the packets against its own frustum, the animated packets are
+    // its dynamic casters. The passes are batched with instance offsets
+    // starting at 0, moved to their place in the instance buffer after.
+    const size_t view_count = this->shadow_views.size();
+    std::vector<uint32_t> pass_instances(1 + 2 * view_count, 0);
+    auto build_view = [this, &camera, &pass_instances, packet_count] (size_t job) {
+        if(job == 0) {
+            this->visible.resize(packet_count);
+            Frustum camera_frustum(camera.projection * camera.view);
+            camera_frustum.CullSpheres(this->world_bounds, this->visible.data());
+            pass_instances[0] = this->draw_list.BuildBatches(this->visible.data(), 0, this->color_pass);
+            return;
+        }
+        ShadowView &view = this->shadow_views[job - 1];
+        view.visible.resize(packet_count);
+        view.static_visible.resize(packet_count);
+        Frustum light_frustum(view.light_matrix);
+        light_frustum.CullSpheres(this->world_bounds, view.visible.data());
+        for(size_t i = 0; i < packet_count; ++i) {
+            const bool animated = this->draw_list[i].animation != nullptr;
+            view.static_visible[i] = view.visible[i] && !animated;
+            view.visible[i] = view.visible[i] && animated;
+        }
+        if(view.refresh_static) {
+            pass_instances[2 * job - 1] = this->draw_list.BuildBatches(view.static_visible.data(), 0, view.static_pass);
+        }
+        else {
+            view.static_pass.packets.clear();
+            view.static_pass.batches.clear();
+        }
+        pass_instances[2 * job] = this->draw_list.BuildBatches(view.visible.data(), 0, view.pass);
+    };
+    JobFanout::Run(1 + view_count, packet_count >= PARALLEL_MIN_PACKETS, build_view);
+
+    // What the animations need to choose their tier for the next frame:
+    // whether a view draws one of their packets, and the closest one.
+    for(size_t i = 0; i < packet_count; ++i) {
+        Animation *animation = this->draw_list[i].animation;
+        if(!animation) {
+            continue;
+        }
+        bool seen = this->visible[i] != 0;
+        for(size_t v = 0; v < view_count && !seen; ++v) {
+            seen = this->shadow_views[v].visible[i] != 0;
+        }
+        animation->lod_visible = animation->lod_visible || seen;
+        const glm::vec3 position(this->model_matrices[this->draw_list[i].matrix][3]);
+        animation->lod_distance = std::min(animation->lod_distance, glm::length(position - camera.position));
+    }
+
+    // The passes in submission order, and where their instances start.
+    std::vector<DrawPass*> passes;
+    passes.reserve(pass_instances.size());
+    passes.push_back(&this->color_pass);
+    for(auto &view : this->shadow_views) {
+        passes.push_back(&view.static_pass);
+        passes.push_back(&view.pass);
+    }
+    std::vector<uint32_t> pass_offsets(passes.size());
+    uint32_t instance_count = 0;
+    for(size_t p = 0; p < passes.size(); ++p) {
+        pass_offsets[p] = instance_count;
+        if(instance_count) {
+            for(auto &batch : passes[p]->batches) {
+                batch.instance_offset += instance_count;
+            }
+        }
+        instance_count += pass_instances[p];
+    }
+
+    // Gather the model matrices and palette texels of the instanced batches
+    // straight into the region of the instance stream given to this frame.
+    this->instance_range = StreamBuffer::Range();
+    this->instance_palette_range = StreamBuffer::Range();
+    if(!this->instance_stream.IsCreated()) {
+        return;
+    }
+    const size_t instance_bytes = sizeof(glm::mat4) * instance_count;
+    const size_t palette_bytes = sizeof(GLint) * instance_count;
+    this->instance_stream.Reserve(instance_bytes + palette_bytes);
+    this->instance_stream.BeginFrame();
+    if(!instance_count) {
+        return;
+    }
+    this->instance_range = this->instance_stream.Allocate(instance_bytes, sizeof(glm::vec4));
+    this->instance_palette_range = this->instance_stream.Allocate(palette_bytes, sizeof(GLint));
+    glm::mat4 *instances = static_cast<glm::mat4*>(this->instance_range.data);
+    GLint *instance_palettes = static_cast<GLint*>(this->instance_palette_range.data);
+    auto gather_instances = [this, &passes, &pass_offsets, instances, instance_palettes] (size_t p) {
+        const DrawPass &pass = *passes[p];
+        glm::mat4 *out = instances + pass_offsets[p];
+        GLint *palette_out = instance_palettes + pass_offsets[p];
+        for(const auto &batch : pass.batches) {
+            if(batch.packet_count > 1) {
+                for(uint32_t i = batch.first_packet; i < batch.first_packet + batch.packet_count; ++i) {
+                    const uint32_t packet_index = pass.packets[i];
+                    *out++ = this->model_matrices[this->draw_list[packet_index].matrix];
+                    *palette_out++ = this->palette_texels[packet_index];
+                }
+            }
+        }
+    };
+    JobFanout::Run(passes.size(), instance_count >= PARALLEL_MIN_PACKETS, gather_instances);
+}
+
+void DrawFrame::UpdateBonePalettes() {
+    const size_t packet_count = this->draw_list.Size();
+    this->palette_texels.assign(packet_count, -1);
+    this->palette_overflow = 0;
+    if(!this->bone_palettes.IsCreated()) {
+        return;
+    }
+    // The packets of the animations playing the same pose share its palette,
+    // each pose is written once. The texels hold the matrix index first.
+    this->pose_palettes.assign(this->pose_cache.Size(), -1);
+    size_t matrix_count = 0;
+    for(size_t i = 0; i < packet_count; ++i) {
+        const Animation *animation = this->draw_list[i].animation;
+        if(!animation || animation->pose_request >= this->pose_cache.GetRequestCount()) {
+            continue;
+        }
+        const uint32_t pose = this->pose_cache.GetPose(animation->pose_request);
+        if(this->pose_palettes[pose] < 0) {
+            this->pose_palettes[pose] = static_cast<GLint>(matrix_count);
+            matrix_count += this->pose_cache.GetBoneCount(pose);
+        }
+        this->palette_texels[i] = this->pose_palettes[pose];
+    }
+    glm::mat4 *out = this->bone_palettes.BeginFrame(matrix_count);
+    if(!out) {
+        this->palette_overflow = matrix_count;
+        std::fill(this->palette_texels.begin(), this->palette_texels.end(), -1);
+        return;
+    }
+    for(uint32_t pose = 0; pose < this->pose_palettes.size(); ++pose) {
+        if(this->pose_palettes[pose] >= 0) {
+            const glm::mat4 *matrices = this->pose_cache.GetMatrices(pose);
+            std::copy(matrices, matrices + this->pose_cache.GetBoneCount(pose), out + this->pose_palettes[pose]);
+        }
+    }
+    for(auto &texel : this->palette_texels) {
+        if(texel >= 0) {
+            texel = this->bone_palettes.GetTexel(texel);
+        }
+    }
+}
+
+void DrawFrame::Commit() const {
+    if(this->instance_stream.IsCreated()) {
+        this->instance_stream.Commit();
+    }
+    if(this->bone_palettes.IsCreated()) {
+        this->bone_palettes.Commit();
+    }
+}
+
+void DrawFrame::BindBonePalettes() const {
+    if(this->bone_palettes.IsCreated()) {
+        this->bone_palettes.Bind(BONE_PALETTE_UNIT);
+    }
+}
+
+void DrawFrame::SubmitBatch(const DrawPass &pass, const DrawBatch &batch, const DrawBindings &bindings) const {
+    const DrawPacket &head = this->draw_list[pass.packets[batch.first_packet]];
+    // animated batches are drawn one packet at a time by the shaders without per instance palettes
+    if(batch.packet_count > 1 && bindings.instance_model >= 0 && (!head.animation || bindings.instance_palette >= 0)) {
+        // Point the matrix columns at this batch's part of the instance buffer.
+        GLState::BindBuffer(GL_ARRAY_BUFFER, this->instance_stream.GetBuffer());
+        for(GLuint column = 0; column < 4; ++column) {
+            GLuint attrib = bindings.instance_model + column;
+            glEnableVertexAttribArray(attrib);
+            glVertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                (GLvoid*)(this->instance_range.offset + sizeof(glm::mat4) * batch.instance_offset + sizeof(glm::vec4) * column));
+            glVertexAttribDivisor(attrib, 1);
+        }
+        if(bindings.instance_palette >= 0) {
+            glEnableVertexAttribArray(bindings.instance_palette);
+            glVertexAttribIPointer(bindings.instance_palette, 1, GL_INT, sizeof(GLint),
+                (GLvoid*)(this->instance_palette_range.offset + sizeof(GLint) * batch.instance_offset));
+            glVertexAttribDivisor(bindings.instance_palette, 1);
+        }
+        glUniform1i(bindings.animated, head.animation ? 1 : 0);
+        glDrawElementsInstanced(GL_TRIANGLES, head.ibo_count, GL_UNSIGNED_INT,
+            (GLvoid*)(sizeof(GLuint) * head.ibo_first), batch.packet_count);
+        return;
+    }
+    for(uint32_t p = batch.first_packet; p < batch.first_packet + batch.packet_count; ++p) {
+        const uint32_t packet_index = pass.packets[p];
+        const DrawPacket &packet = this->draw_list[packet_index];
+        const glm::mat4 &model_matrix = this->model_matrices[packet.matrix];
+        if(bindings.instance_model >= 0) {
+            // With the arrays disabled the attribute reads the current generic value.
+            for(GLuint column = 0; column < 4; ++column) {
+                glDisableVertexAttribArray(bindings.instance_model + column);
+                glVertexAttrib4fv(bindings.instance_model + column, &model_matrix[column][0]);
+            }
+        }
+        else {
+            glUniformMatrix4fv(bindings.model, 1, GL_FALSE, &model_matrix[0][0]);
+        }
+        const GLint palette = this->palette_texels[packet_index];
+        if(bindings.instance_palette >= 0) {
+            glDisableVertexAttribArray(bindings.instance_palette);
+            glVertexAttribI1i(bindings.instance_palette, palette);
+        }
+        else if(bindings.palette >= 0) {
+            glUniform1i(bindings.palette, palette);
+        }
+        glUniform1i(bindings.animated, palette >= 0 ? 1 : 0);
+        glDrawElements(GL_TRIANGLES, packet.ibo_count, GL_UNSIGNED_INT, (GLvoid*)(sizeof(GLuint) * packet.ibo_first));
+    }
+}
+
+void DrawFrame::EndFrame() const {
+    // fence the streams after the draws reading them
+    if(this->instance_stream.IsCreated()) {
+        this->instance_stream.EndFrame();
+    }
+    if(this->bone_palettes.IsCreated()) {
+        this->bone_palettes.EndFrame();
+    }
+}
+
+} // namespace graphics
+} // namespace trillek
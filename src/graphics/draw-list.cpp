@@ -0,0 +1,123 @@
+#include "graphics/draw-list.hpp"
+#include <algorithm>
+#include <unordered_map>
+
+namespace trillek {
+namespace graphics {
+
+static_assert(MeshSimplifier::MAX_LEVELS <= 1u << DrawList::LEVEL_BITS, "The mesh levels do not fit the sort key");
+
+size_t DrawList::Compact() {
+    if(this->removals.empty()) {
+        return 0;
+    }
+    // the latest removal of an entity covers the others
+    std::unordered_map<id_t, size_t> removed_before(this->removals.size() * 2);
+    for(const auto &removal : this->removals) {
+        removed_before[removal.first] = removal.second;
+    }
+    size_t write = 0;
+    for(size_t i = 0; i < this->packets.size(); i++) {
+        auto removal = removed_before.find(this->packets[i].entity_id);
+        // the packets added after the removal stay
+        if(removal != removed_before.end() && i < removal->second) {
+            continue;
+        }
+        if(write != i) {
+            this->packets[write] = this->packets[i];
+        }
+        write++;
+    }
+    const size_t removed = this->packets.size() - write;
+    this->packets.resize(write);
+    this->removals.clear();
+    return removed;
+}
+
+void DrawList::Sort() {
+    Compact();
+    const size_t count = this->packets.size();
+    if(count < 2) {
+        return;
+    }
+    this->scratch.resize(count);
+
+    // one histogram per byte of the key, all gathered in a single read
+    size_t histogram[8][256] = {};
+    for(const auto &packet : this->packets) {
+        uint64_t key = packet.sort_key;
+        for(unsigned int b = 0; b < 8; b++) {
+            histogram[b][(key >> (b * 8)) & 0xff]++;
+        }
+    }
+
+    DrawPacket *src = this->packets.data();
+    DrawPacket *dst = this->scratch.data();
+    for(unsigned int b = 0; b < 8; b++) {
+        size_t *bucket = histogram[b];
+        const unsigned int shift = b * 8;
+        // every key has the same byte here, the pass would not move anything
+        if(bucket[(src[0].sort_key >> shift) & 0xff] == count) {
+            continue;
+        }
+        size_t offset = 0;
+        for(unsigned int i = 0; i < 256; i++) {
+            size_t bucket_size = bucket[i];
+            bucket[i] = offset;
+            offset += bucket_size;
+        }
+        for(size_t i = 0; i < count; i++) {
+            dst[bucket[(src[i].sort_key >> shift) & 0xff]++] = src[i];
+        }
+        std::swap(src, dst);
+    }
+    if(src != this->packets.data()) {
+        this->packets.swap(this->scratch);
+    }
+}
+
+bool DrawList::SameBatch(const DrawPacket &head, const DrawPacket &packet) {
+    // The key fields are truncated IDs, two meshes or materials may share
+    // them, so the batch only takes packets drawing exactly what the head draws.
+    return (packet.sort_key & ~DEPTH_MASK) == (head.sort_key & ~DEPTH_MASK)
+        && (packet.animation != nullptr) == (head.animation != nullptr)
+        && packet.material_index == head.material_index
+        && packet.texture_set == head.texture_set
+        && packet.vao == head.vao
+        && packet.ibo == head.ibo
+        && packet.ibo_first == head.ibo_first
+        && packet.ibo_count == head.ibo_count;
+}
+
+uint32_t DrawList::BuildBatches(const uint8_t *visible, uint32_t first_instance, DrawPass &pass) const {
+    pass.packets.clear();
+    pass.batches.clear();
+    for(uint32_t p = 0; p < this->packets.size(); p++) {
+        if(visible[p]) {
+            pass.packets.push_back(p);
+        }
+    }
+    uint32_t instance_count = 0;
+    const uint32_t count = pass.packets.size();
+    uint32_t first = 0;
+    while(first < count) {
+        const DrawPacket &head = this->packets[pass.packets[first]];
+        uint32_t last = first + 1;
+        while(last < count && SameBatch(head, this->packets[pass.packets[last]])) {
+            last++;
+        }
+        DrawBatch batch;
+        batch.first_packet = first;
+        batch.packet_count = last - first;
+        batch.instance_offset = first_instance + instance_count;
+        if(batch.packet_count > 1) {
+            instance_count += batch.packet_count;
+        }
+        pass.batches.push_back(batch);
+        first = last;
+    }
+    return instance_count;
+}
+
+} // namespace graphics
+} // namespace trillek
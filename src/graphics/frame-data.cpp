@@ -0,0 +1,37 @@
+#include "graphics/frame-data.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace trillek {
+namespace graphics {
+
+static_assert(sizeof(FrameData) == 4 * 64 + 2 * 16, "FrameData does not have the std140 layout");
+
+FrameUniformBuffer::FrameUniformBuffer() : alignment(256) { }
+
+void FrameUniformBuffer::Create() {
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->alignment);
+    this->alignment = std::max<GLint>(this->alignment, 16);
+    this->stream.Create(GL_UNIFORM_BUFFER, sizeof(FrameData));
+    CheckGLError();
+}
+
+void FrameUniformBuffer::Upload(const FrameData &data) {
+    this->stream.BeginFrame();
+    StreamBuffer::Range range = this->stream.Allocate(sizeof(FrameData), this->alignment);
+    if(!range.data) {
+        return;
+    }
+    std::memcpy(range.data, &data, sizeof(FrameData));
+    this->stream.Commit();
+    // the binding point keeps the range, whatever is bound to GL_UNIFORM_BUFFER later
+    glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, this->stream.GetBuffer(), range.offset, range.size);
+    CheckGLError();
+}
+
+void FrameUniformBuffer::EndFrame() {
+    this->stream.EndFrame();
+}
+
+} // namespace graphics
+} // namespace trillek
@@ -0,0 +1,96 @@
+#include "graphics/frustum.hpp"
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRILLEK_FRUSTUM_SSE
+#endif
+
+namespace trillek {
+namespace graphics {
+
+Frustum::Frustum(const glm::mat4 &m) {
+    // rows of the matrix, glm is column major
+    glm::vec4 row[4];
+    for(unsigned int r = 0; r < 4; r++) {
+        row[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+    }
+    // left, right, bottom, top, near, far
+    glm::vec4 planes[6] = {
+        row[3] + row[0], row[3] - row[0],
+        row[3] + row[1], row[3] - row[1],
+        row[3] + row[2], row[3] - row[2]
+    };
+    for(unsigned int p = 0; p < 6; p++) {
+        const glm::vec4 &plane = planes[p];
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        float scale = length > 0.0f ? 1.0f / length : 0.0f;
+        this->a[p] = plane.x * scale;
+        this->b[p] = plane.y * scale;
+        this->c[p] = plane.z * scale;
+        this->d[p] = plane.w * scale;
+    }
+}
+
+bool Frustum::TestSphere(const glm::vec3 &center, float radius) const {
+    for(unsigned int p = 0; p < 6; p++) {
+        float distance = this->a[p] * center.x + this->b[p] * center.y + this->c[p] * center.z + this->d[p];
+        if(!(distance > -radius)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::TestBox(const glm::vec3 &min, const glm::vec3 &max) const {
+    for(unsigned int p = 0; p < 6; p++) {
+        // the corner furthest along the plane normal
+        float x = this->a[p] >= 0.0f ? max.x : min.x;
+        float y = this->b[p] >= 0.0f ? max.y : min.y;
+        float z = this->c[p] >= 0.0f ? max.z : min.z;
+        if(this->a[p] * x + this->b[p] * y + this->c[p] * z + this->d[p] < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Frustum::CullSpheres(const BoundingSpheres &spheres, uint8_t *visible) const {
+    const size_t count = spheres.Size();
+    size_t i = 0;
+#ifdef TRILLEK_FRUSTUM_SSE
+    __m128 pa[6], pb[6], pc[6], pd[6];
+    for(unsigned int p = 0; p < 6; p++) {
+        pa[p] = _mm_set1_ps(this->a[p]);
+        pb[p] = _mm_set1_ps(this->b[p]);
+        pc[p] = _mm_set1_ps(this->c[p]);
+        pd[p] = _mm_set1_ps(this->d[p]);
+    }
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for(; i + 4 <= count; i += 4) {
+        const __m128 x = _mm_load_ps(&spheres.x[i]);
+        const __m128 y = _mm_load_ps(&spheres.y[i]);
+        const __m128 z = _mm_load_ps(&spheres.z[i]);
+        const __m128 neg_radius = _mm_xor_ps(_mm_load_ps(&spheres.radius[i]), sign);
+        __m128 inside = _mm_cmpgt_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(pa[0], x), _mm_mul_ps(pb[0], y)),
+                _mm_add_ps(_mm_mul_ps(pc[0], z), pd[0])), neg_radius);
+        for(unsigned int p = 1; p < 6; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pa[p], x), _mm_mul_ps(pb[p], y)),
+                _mm_add_ps(_mm_mul_ps(pc[p], z), pd[p]));
+            inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, neg_radius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        visible[i] = mask & 1;
+        visible[i + 1] = (mask >> 1) & 1;
+        visible[i + 2] = (mask >> 2) & 1;
+        visible[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+    for(; i < count; i++) {
+        visible[i] = TestSphere(glm::vec3(spheres.x[i], spheres.y[i], spheres.z[i]), spheres.radius[i]) ? 1 : 0;
+    }
+}
+
+} // namespace graphics
+} // namespace trillek
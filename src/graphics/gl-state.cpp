@@ -0,0 +1,277 @@
+#include "graphics/gl-state.hpp"
+
+namespace trillek {
+namespace graphics {
+
+// value of a binding that is not known
+static const GLuint UNKNOWN = ~0u;
+
+// the capabilities with a cached state, others are always sent
+static const GLenum CAPABILITIES[] = {
+    GL_DEPTH_TEST, GL_BLEND, GL_MULTISAMPLE, GL_SCISSOR_TEST, GL_CULL_FACE, GL_STENCIL_TEST
+};
+static const unsigned int CAPABILITY_COUNT = sizeof(CAPABILITIES) / sizeof(CAPABILITIES[0]);
+
+const unsigned int GLState::MAX_TEXTURE_UNITS;
+
+GLuint GLState::program = UNKNOWN;
+GLuint GLState::vertex_array = UNKNOWN;
+GLuint GLState::array_buffer = UNKNOWN;
+GLuint GLState::element_buffer = UNKNOWN;
+GLuint GLState::texture_buffer = UNKNOWN;
+GLuint GLState::uniform_buffer = UNKNOWN;
+GLenum GLState::active_unit = UNKNOWN;
+GLuint GLState::textures_2d[MAX_TEXTURE_UNITS];
+GLuint GLState::textures_2d_multisample[MAX_TEXTURE_UNITS];
+GLuint GLState::textures_buffer[MAX_TEXTURE_UNITS];
+GLuint GLState::draw_framebuffer = UNKNOWN;
+GLuint GLState::read_framebuffer = UNKNOWN;
+GLenum GLState::polygon_mode = UNKNOWN;
+int8_t GLState::capabilities[CAPABILITY_COUNT] = { -1, -1, -1, -1, -1, -1 };
+GLState::Counters GLState::frame = { 0, 0, 0, 0, 0, 0, 0 };
+GLState::Counters GLState::last_frame = { 0, 0, 0, 0, 0, 0, 0 };
+
+// Mark every unit of a texture target unknown.
+static void ForgetUnits(GLuint *units) {
+    for(unsigned int i = 0; i < GLState::MAX_TEXTURE_UNITS; i++) {
+        units[i] = UNKNOWN;
+    }
+}
+
+// Set a cached binding, true if GL must be called.
+static bool Change(GLuint &cached, GLuint value, uint32_t &counter, uint32_t &skipped) {
+    if(cached == value) {
+        skipped++;
+        return false;
+    }
+    cached = value;
+    counter++;
+    return true;
+}
+
+void GLState::UseProgram(GLuint program) {
+    if(Change(GLState::program, program, frame.program, frame.skipped)) {
+        glUseProgram(program);
+    }
+}
+
+void GLState::BindVertexArray(GLuint vao) {
+    if(Change(vertex_array, vao, frame.vertex_array, frame.skipped)) {
+        glBindVertexArray(vao);
+        // the element buffer binding belongs to the vertex array
+        element_buffer = UNKNOWN;
+    }
+}
+
+void GLState::BindBuffer(GLenum target, GLuint buffer) {
+    GLuint *cached = nullptr;
+    switch(target) {
+    case GL_ARRAY_BUFFER:
+        cached = &array_buffer;
+        break;
+    case GL_ELEMENT_ARRAY_BUFFER:
+        cached = &element_buffer;
+        break;
+    case GL_TEXTURE_BUFFER:
+        cached = &texture_buffer;
+        break;
+    case GL_UNIFORM_BUFFER:
+        cached = &uniform_buffer;
+        break;
+    default:
+        frame.buffer++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if(Change(*cached, buffer, frame.buffer, frame.skipped)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void GLState::ActiveTexture(GLenum unit) {
+    unit -= GL_TEXTURE0;
+    if(active_unit == unit) {
+        frame.skipped++;
+        return;
+    }
+    active_unit = unit;
+    glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void GLState::BindTexture(GLenum target, GLuint texture) {
+    GLuint *units = nullptr;
+    switch(target) {
+    case GL_TEXTURE_2D:
+        units = textures_2d;
+        break;
+    case GL_TEXTURE_2D_MULTISAMPLE:
+        units = textures_2d_multisample;
+        break;
+    case GL_TEXTURE_BUFFER:
+        units = textures_buffer;
+        break;
+    default:
+        break;
+    }
+    if(!units || active_unit >= MAX_TEXTURE_UNITS) {
+        frame.texture++;
+        glBindTexture(target, texture);
+        return;
+    }
+    if(Change(units[active_unit], texture, frame.texture, frame.skipped)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void GLState::BindFramebuffer(GLenum target, GLuint fbo) {
+    switch(target) {
+    case GL_DRAW_FRAMEBUFFER:
+        if(Change(draw_framebuffer, fbo, frame.framebuffer, frame.skipped)) {
+            glBindFramebuffer(target, fbo);
+        }
+        break;
+    case GL_READ_FRAMEBUFFER:
+        if(Change(read_framebuffer, fbo, frame.framebuffer, frame.skipped)) {
+            glBindFramebuffer(target, fbo);
+        }
+        break;
+    default:
+        if(draw_framebuffer == fbo && read_framebuffer == fbo) {
+            frame.skipped++;
+            return;
+        }
+        draw_framebuffer = fbo;
+        read_framebuffer = fbo;
+        frame.framebuffer++;
+        glBindFramebuffer(target, fbo);
+        break;
+    }
+}
+
+// Index of a cached capability, CAPABILITY_COUNT if it is not cached.
+static unsigned int CapabilityIndex(GLenum capability) {
+    unsigned int i = 0;
+    while(i < CAPABILITY_COUNT && CAPABILITIES[i] != capability) {
+        i++;
+    }
+    return i;
+}
+
+void GLState::Enable(GLenum capability) {
+    unsigned int index = CapabilityIndex(capability);
+    if(index < CAPABILITY_COUNT) {
+        if(capabilities[index] == 1) {
+            frame.skipped++;
+            return;
+        }
+        capabilities[index] = 1;
+    }
+    frame.capability++;
+    glEnable(capability);
+}
+
+void GLState::Disable(GLenum capability) {
+    unsigned int index = CapabilityIndex(capability);
+    if(index < CAPABILITY_COUNT) {
+        if(capabilities[index] == 0) {
+            frame.skipped++;
+            return;
+        }
+        capabilities[index] = 0;
+    }
+    frame.capability++;
+    glDisable(capability);
+}
+
+void GLState::PolygonMode(GLenum mode) {
+    if(Change(polygon_mode, mode, frame.capability, frame.skipped)) {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+    }
+}
+
+// Forget the names that are about to be deleted.
+static void Forget(GLuint &cached, GLsizei count, const GLuint *names) {
+    for(GLsizei i = 0; i < count; i++) {
+        if(cached == names[i]) {
+            cached = 0;
+        }
+    }
+}
+
+void GLState::DeleteTextures(GLsizei count, const GLuint *textures) {
+    for(unsigned int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+        Forget(textures_2d[unit], count, textures);
+        Forget(textures_2d_multisample[unit], count, textures);
+        Forget(textures_buffer[unit], count, textures);
+    }
+    glDeleteTextures(count, textures);
+}
+
+void GLState::DeleteBuffers(GLsizei count, const GLuint *buffers) {
+    Forget(array_buffer, count, buffers);
+    Forget(element_buffer, count, buffers);
+    Forget(texture_buffer, count, buffers);
+    Forget(uniform_buffer, count, buffers);
+    glDeleteBuffers(count, buffers);
+}
+
+void GLState::DeleteFramebuffers(GLsizei count, const GLuint *fbos) {
+    Forget(draw_framebuffer, count, fbos);
+    Forget(read_framebuffer, count, fbos);
+    glDeleteFramebuffers(count, fbos);
+}
+
+void GLState::DeleteVertexArrays(GLsizei count, const GLuint *vaos) {
+    for(GLsizei i = 0; i < count; i++) {
+        if(vertex_array == vaos[i]) {
+            vertex_array = 0;
+            element_buffer = UNKNOWN;
+        }
+    }
+    glDeleteVertexArrays(count, vaos);
+}
+
+GLuint GLState::GetDrawFramebuffer() {
+    if(draw_framebuffer == UNKNOWN) {
+        GLint fbo = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+        draw_framebuffer = fbo;
+    }
+    return draw_framebuffer;
+}
+
+GLuint GLState::GetReadFramebuffer() {
+    if(read_framebuffer == UNKNOWN) {
+        GLint fbo = 0;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fbo);
+        read_framebuffer = fbo;
+    }
+    return read_framebuffer;
+}
+
+void GLState::Invalidate() {
+    program = UNKNOWN;
+    vertex_array = UNKNOWN;
+    array_buffer = UNKNOWN;
+    element_buffer = UNKNOWN;
+    texture_buffer = UNKNOWN;
+    uniform_buffer = UNKNOWN;
+    active_unit = UNKNOWN;
+    ForgetUnits(textures_2d);
+    ForgetUnits(textures_2d_multisample);
+    ForgetUnits(textures_buffer);
+    draw_framebuffer = UNKNOWN;
+    read_framebuffer = UNKNOWN;
+    polygon_mode = UNKNOWN;
+    for(unsigned int i = 0; i < CAPABILITY_COUNT; i++) {
+        capabilities[i] = -1;
+    }
+}
+
+void GLState::EndFrame() {
+    last_frame = frame;
+    frame = Counters();
+}
+
+} // namespace graphics
+} // namespace trillek
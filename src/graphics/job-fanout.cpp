@@ -0,0 +1,130 @@
+#include "graphics/job-fanout.hpp"
+
+namespace trillek {
+namespace graphics {
+
+namespace {
+
+// the size of the pool, fixed once it starts
+std::mutex pool_size_mutex;
+bool pool_started = false;
+size_t reserved_threads = 1;
+size_t pool_threads = ~size_t(0);
+
+size_t StartPoolThreads() {
+    std::lock_guard<std::mutex> lock(pool_size_mutex);
+    pool_started = true;
+    if(pool_threads != ~size_t(0)) {
+        return pool_threads;
+    }
+    const size_t cores = std::max<size_t>(1, std::thread::hardware_concurrency());
+    return cores > reserved_threads ? cores - reserved_threads : 0;
+}
+
+} // namespace
+
+JobPool& JobPool::Get() {
+    static JobPool pool(StartPoolThreads());
+    return pool;
+}
+
+bool JobPool::ReserveThreads(size_t thread_count) {
+    std::lock_guard<std::mutex> lock(pool_size_mutex);
+    if(pool_started) {
+        return false;
+    }
+    reserved_threads = std::max<size_t>(1, thread_count);
+    return true;
+}
+
+bool JobPool::SetThreadCount(size_t thread_count) {
+    std::lock_guard<std::mutex> lock(pool_size_mutex);
+    if(pool_started) {
+        return false;
+    }
+    pool_threads = thread_count;
+    return true;
+}
+
+JobPool::JobPool(size_t thread_count) : task(nullptr), context(nullptr), part_count(0),
+        finished_parts(0), active_threads(0), generation(0), stopping(false), next_part(0), busy(false) {
+    this->threads.reserve(thread_count);
+    for(size_t t = 0; t < thread_count; t++) {
+        this->threads.push_back(std::thread(&JobPool::WorkerLoop, this));
+    }
+}
+
+JobPool::~JobPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->wake.notify_all();
+    for(auto &thread : this->threads) {
+        thread.join();
+    }
+}
+
+void JobPool::Run(Task task, const void *context, size_t part_count) {
+    if(this->threads.empty() || this->busy.exchange(true, std::memory_order_acquire)) {
+        for(size_t p = 0; p < part_count; p++) {
+            task(context, p);
+        }
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        // a thread waking late for the last call must be done with it
+        this->done.wait(lock, [this] () { return this->active_threads == 0; });
+        this->task = task;
+        this->context = context;
+        this->part_count = part_count;
+        this->finished_parts = 0;
+        this->next_part.store(0, std::memory_order_relaxed);
+        this->generation++;
+    }
+    this->wake.notify_all();
+    const size_t taken = TakeParts(task, context, part_count);
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->finished_parts += taken;
+    this->done.wait(lock, [this] () {
+        return this->finished_parts == this->part_count && this->active_threads == 0;
+    });
+    this->busy.store(false, std::memory_order_release);
+}
+
+size_t JobPool::TakeParts(Task task, const void *context, size_t part_count) {
+    size_t taken = 0;
+    for(size_t part = this->next_part.fetch_add(1); part < part_count; part = this->next_part.fetch_add(1)) {
+        task(context, part);
+        taken++;
+    }
+    return taken;
+}
+
+void JobPool::WorkerLoop() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    uint64_t seen = this->generation;
+    while(true) {
+        this->wake.wait(lock, [this, &seen] () { return this->stopping || this->generation != seen; });
+        if(this->stopping) {
+            return;
+        }
+        seen = this->generation;
+        const Task task = this->task;
+        const void *context = this->context;
+        const size_t part_count = this->part_count;
+        this->active_threads++;
+        lock.unlock();
+        const size_t taken = TakeParts(task, context, part_count);
+        lock.lock();
+        this->finished_parts += taken;
+        this->active_threads--;
+        if(this->active_threads == 0) {
+            this->done.notify_all();
+        }
+    }
+}
+
+} // namespace graphics
+} // namespace trillek
@@ -0,0 +1,223 @@
+#include "graphics/light-grid.hpp"
+#include "graphics/gl-state.hpp"
+#include "graphics/shader.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace trillek {
+namespace graphics {
+
+const uint32_t LightGrid::CLUSTER_X;
+const uint32_t LightGrid::CLUSTER_Y;
+const uint32_t LightGrid::CLUSTER_Z;
+const uint32_t LightGrid::CLUSTER_COUNT;
+
+LightGrid::LightGrid() : light_count(0), near_plane(0.1f), depth_scale(1.0f), bound_link_id(0),
+    dims_location(-1), depth_location(-1), count_location(-1) {
+    for(unsigned int i = 0; i < 3; i++) {
+        this->buffers[i] = 0;
+        this->textures[i] = 0;
+        this->sampler_locations[i] = -1;
+    }
+}
+
+LightGrid::~LightGrid() {
+    if(this->textures[0]) {
+        GLState::DeleteTextures(3, this->textures);
+        GLState::DeleteBuffers(3, this->buffers);
+    }
+}
+
+uint32_t LightGrid::GetSlice(float depth) const {
+    if(depth <= this->near_plane) {
+        return 0;
+    }
+    float slice = std::log(depth / this->near_plane) * this->depth_scale;
+    return std::min(static_cast<uint32_t>(slice), CLUSTER_Z - 1);
+}
+
+float LightGrid::GetSliceDepth(uint32_t slice) const {
+    return this->near_plane * std::exp(slice / this->depth_scale);
+}
+
+// Tile of a normalized device coordinate, clamped to the grid.
+static uint32_t GetTile(float ndc, uint32_t tiles) {
+    float tile = (ndc * 0.5f + 0.5f) * tiles;
+    if(!(tile > 0.0f)) {
+        return 0;
+    }
+    return std::min(static_cast<uint32_t>(tile), tiles - 1);
+}
+
+void LightGrid::Build(const std::vector<GridLight> &lights, const glm::mat4 &projection,
+        float near_plane, float far_plane) {
+    this->near_plane = near_plane;
+    this->depth_scale = CLUSTER_Z / std::log(far_plane / near_plane);
+    this->light_data.clear();
+    this->light_bounds.clear();
+    this->cluster_data.assign(CLUSTER_COUNT * 2, 0);
+    this->light_indices.clear();
+    this->light_count = 0;
+
+    // Find the clusters covered by each light, slice by slice, and count the lights of each cluster.
+    for(const auto &light : lights) {
+        const uint32_t light_index = this->light_count;
+        const size_t first_span = this->light_bounds.size();
+        if(!std::isfinite(light.radius)) {
+            for(uint32_t z = 0; z < CLUSTER_Z; z++) {
+                const uint32_t span[6] = { light_index, z, 0, CLUSTER_X - 1, 0, CLUSTER_Y - 1 };
+                this->light_bounds.insert(this->light_bounds.end(), span, span + 6);
+            }
+        }
+        else {
+            // view space looks down -Z, depths are positive in front of the camera
+            const float depth = -light.position.z;
+            const float depth_min = depth - light.radius;
+            const float depth_max = depth + light.radius;
+            if(depth_max < near_plane || depth_min > far_plane) {
+                continue;
+            }
+            const uint32_t last_slice = GetSlice(depth_max);
+            for(uint32_t z = GetSlice(depth_min); z <= last_slice; z++) {
+                // the part of the light in the slice, nothing before the near plane is seen
+                const float slab_near = std::max(std::max(depth_min, near_plane), z ? GetSliceDepth(z) : 0.0f);
+                const float slab_far = z + 1 < CLUSTER_Z ? std::min(depth_max, GetSliceDepth(z + 1)) : depth_max;
+                if(slab_far < slab_near) {
+                    continue;
+                }
+                // the sphere is widest in the slab where it is closest to its center
+                const float offset = depth < slab_near ? slab_near - depth : (depth > slab_far ? depth - slab_far : 0.0f);
+                const float radius = std::sqrt(std::max(0.0f, light.radius * light.radius - offset * offset));
+                // x / depth is monotonic in both over the box, so the corners bound the projection
+                float ndc_min[2] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+                float ndc_max[2] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+                for(unsigned int axis = 0; axis < 2; axis++) {
+                    const float scale = projection[axis][axis];
+                    const float low = light.position[axis] - radius;
+                    const float high = light.position[axis] + radius;
+                    const float depths[2] = { slab_near, slab_far };
+                    for(float d : depths) {
+                        ndc_min[axis] = std::min(ndc_min[axis], std::min(scale * low / d, scale * high / d));
+                        ndc_max[axis] = std::max(ndc_max[axis], std::max(scale * low / d, scale * high / d));
+                    }
+                }
+                if(ndc_max[0] < -1.0f || ndc_min[0] > 1.0f || ndc_max[1] < -1.0f || ndc_min[1] > 1.0f) {
+                    continue;
+                }
+                const uint32_t span[6] = { light_index, z,
+                    GetTile(ndc_min[0], CLUSTER_X), GetTile(ndc_max[0], CLUSTER_X),
+                    GetTile(ndc_min[1], CLUSTER_Y), GetTile(ndc_max[1], CLUSTER_Y) };
+                this->light_bounds.insert(this->light_bounds.end(), span, span + 6);
+            }
+            if(this->light_bounds.size() == first_span) {
+                continue;
+            }
+        }
+        for(size_t i = first_span; i < this->light_bounds.size(); i += 6) {
+            const uint32_t *span = &this->light_bounds[i];
+            for(uint32_t y = span[4]; y <= span[5]; y++) {
+                for(uint32_t x = span[2]; x <= span[3]; x++) {
+                    this->cluster_data[(x + y * CLUSTER_X + span[1] * CLUSTER_X * CLUSTER_Y) * 2 + 1]++;
+                }
+            }
+        }
+        this->light_data.push_back(glm::vec4(light.position, light.radius));
+        this->light_data.push_back(glm::vec4(light.color, static_cast<float>(light.type)));
+        this->light_data.push_back(glm::vec4(light.direction, 0.0f));
+        this->light_count++;
+    }
+
+    // Give each cluster its range of the index list.
+    uint32_t offset = 0;
+    for(uint32_t c = 0; c < CLUSTER_COUNT; c++) {
+        this->cluster_data[c * 2] = offset;
+        offset += this->cluster_data[c * 2 + 1];
+        this->cluster_data[c * 2 + 1] = 0;
+    }
+    this->light_indices.resize(offset);
+
+    // Fill the ranges, counting again.
+    for(size_t i = 0; i < this->light_bounds.size(); i += 6) {
+        const uint32_t *span = &this->light_bounds[i];
+        for(uint32_t y = span[4]; y <= span[5]; y++) {
+            for(uint32_t x = span[2]; x <= span[3]; x++) {
+                uint32_t *cell = &this->cluster_data[(x + y * CLUSTER_X + span[1] * CLUSTER_X * CLUSTER_Y) * 2];
+                this->light_indices[cell[0] + cell[1]++] = span[0];
+            }
+        }
+    }
+}
+
+void LightGrid::CreateBuffers() {
+    if(this->textures[0]) {
+        return;
+    }
+    static const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    glGenBuffers(3, this->buffers);
+    glGenTextures(3, this->textures);
+    for(unsigned int i = 0; i < 3; i++) {
+        GLState::BindBuffer(GL_TEXTURE_BUFFER, this->buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        GLState::BindTexture(GL_TEXTURE_BUFFER, this->textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], this->buffers[i]);
+    }
+    GLState::BindTexture(GL_TEXTURE_BUFFER, 0);
+    GLState::BindBuffer(GL_TEXTURE_BUFFER, 0);
+    CheckGLError();
+}
+
+void LightGrid::Upload() const {
+    if(!this->textures[0]) {
+        return;
+    }
+    // buffer textures must not be empty
+    static const uint32_t empty[4] = { 0, 0, 0, 0 };
+    const void *data[3] = { this->light_data.data(), this->cluster_data.data(), this->light_indices.data() };
+    const size_t sizes[3] = {
+        sizeof(glm::vec4) * this->light_data.size(),
+        sizeof(uint32_t) * this->cluster_data.size(),
+        sizeof(uint32_t) * this->light_indices.size()
+    };
+    for(unsigned int i = 0; i < 3; i++) {
+        GLState::BindBuffer(GL_TEXTURE_BUFFER, this->buffers[i]);
+        if(sizes[i]) {
+            glBufferData(GL_TEXTURE_BUFFER, sizes[i], data[i], GL_STREAM_DRAW);
+        }
+        else {
+            glBufferData(GL_TEXTURE_BUFFER, sizeof(empty), empty, GL_STREAM_DRAW);
+        }
+    }
+    GLState::BindBuffer(GL_TEXTURE_BUFFER, 0);
+    CheckGLError();
+}
+
+void LightGrid::ResolveBindings(Shader &shader) {
+    if(this->bound_link_id == shader.GetLinkID()) {
+        return;
+    }
+    static const char *samplers[3] = { "cluster_lights", "cluster_cells", "cluster_indices" };
+    this->bound_link_id = shader.GetLinkID();
+    for(unsigned int i = 0; i < 3; i++) {
+        this->sampler_locations[i] = shader.Uniform(samplers[i]);
+    }
+    this->dims_location = shader.Uniform("cluster_dims");
+    this->depth_location = shader.Uniform("cluster_depth");
+    this->count_location = shader.Uniform("light_count");
+}
+
+void LightGrid::Bind(GLuint first_unit) const {
+    for(unsigned int i = 0; i < 3; i++) {
+        GLState::ActiveTexture(GL_TEXTURE0 + first_unit + i);
+        GLState::BindTexture(GL_TEXTURE_BUFFER, this->textures[i]);
+        if(this->sampler_locations[i] >= 0) glUniform1i(this->sampler_locations[i], first_unit + i);
+    }
+    if(this->dims_location >= 0) glUniform3ui(this->dims_location, CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+    if(this->depth_location >= 0) glUniform2f(this->depth_location, this->near_plane, this->depth_scale);
+    if(this->count_location >= 0) glUniform1ui(this->count_location, this->light_count);
+    GLState::ActiveTexture(GL_TEXTURE0);
+    CheckGLError();
+}
+
+} // namespace graphics
+} // namespace trillek
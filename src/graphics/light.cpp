@@ -39,9 +39,30 @@ bool LightBase::Initialize(const std::vector<Property> &properties) {
         }
     }
     light_props.push_back(Property("radius", radius));
+    this->radius = radius;
 
     return true;
 }
 
+void LightBase::ResolveBindings(Shader &shader) {
+    const bool wants_texture = this->shadows && !this->shadow_texture;
+    if(this->bound_link_id == shader.GetLinkID() && !wants_texture) {
+        return;
+    }
+    this->bound_link_id = shader.GetLinkID();
+    this->prop_locations.assign(this->light_props.size(), -1);
+    for(size_t i = 0; i < this->light_props.size(); i++) {
+        const Property &prop = this->light_props[i];
+        if(prop.GetName() == "shadow") {
+            if(!this->shadow_texture) {
+                this->shadow_texture = TrillekGame::GetGraphicSystem().Get<Texture>(prop.Get<std::string>());
+            }
+        }
+        else {
+            this->prop_locations[i] = shader.Uniform(prop.GetName());
+        }
+    }
+}
+
 } // namespace graphics
 } // namespace trillek
@@ -1,4 +1,5 @@
 #include "graphics/material.hpp"
+#include "graphics/gl-state.hpp"
 #include "graphics/shader.hpp"
 #include "graphics/texture.hpp"
 
@@ -35,17 +36,17 @@ size_t Material::GetTextureIndex(std::shared_ptr<Texture> t) {
     return AddTexture(t);
 }
 
-void Material::ActivateTexture(const size_t index, const GLuint target) {
+void Material::ActivateTexture(const size_t index, const GLuint target) const {
     if (index < this->textures.size()) {
         GLuint tex_id = this->textures[index].second;
-        glActiveTexture(GL_TEXTURE0 + target);
-        glBindTexture(GL_TEXTURE_2D, tex_id);
+        GLState::ActiveTexture(GL_TEXTURE0 + target);
+        GLState::BindTexture(GL_TEXTURE_2D, tex_id);
     }
 }
 
 void Material::DeactivateTexture(GLuint target) {
-    glActiveTexture(GL_TEXTURE0 + target);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::ActiveTexture(GL_TEXTURE0 + target);
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 } // End of graphics
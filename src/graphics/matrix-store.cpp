@@ -0,0 +1,59 @@
+#include "graphics/matrix-store.hpp"
+
+namespace trillek {
+namespace graphics {
+
+const uint32_t ModelMatrixStore::NO_SLOT;
+
+MatrixSlot ModelMatrixStore::Acquire(const id_t entity_id) {
+    if(entity_id >= this->entity_slots.size()) {
+        this->entity_slots.resize(entity_id + 1, NO_SLOT);
+    }
+    uint32_t index = this->entity_slots[entity_id];
+    if(index == NO_SLOT) {
+        if(this->free_slots.empty()) {
+            index = this->matrices.size();
+            this->matrices.push_back(glm::mat4(1.0f));
+            this->generations.push_back(0);
+        }
+        else {
+            index = this->free_slots.back();
+            this->free_slots.pop_back();
+            this->matrices[index] = glm::mat4(1.0f);
+        }
+        this->entity_slots[entity_id] = index;
+    }
+    MatrixSlot slot;
+    slot.index = index;
+    slot.generation = this->generations[index];
+    return slot;
+}
+
+void ModelMatrixStore::Release(const id_t entity_id) {
+    if(entity_id >= this->entity_slots.size()) {
+        return;
+    }
+    uint32_t index = this->entity_slots[entity_id];
+    if(index == NO_SLOT) {
+        return;
+    }
+    this->generations[index]++;
+    this->free_slots.push_back(index);
+    this->entity_slots[entity_id] = NO_SLOT;
+}
+
+bool ModelMatrixStore::Find(const id_t entity_id, MatrixSlot &slot) const {
+    if(entity_id >= this->entity_slots.size()) {
+        return false;
+    }
+    uint32_t index = this->entity_slots[entity_id];
+    if(index == NO_SLOT) {
+        return false;
+    }
+    slot.index = index;
+    slot.generation = this->generations[index];
+    return true;
+}
+
+} // namespace graphics
+} // namespace trillek
@@ -0,0 +1,372 @@
+#include "graphics/mesh-simplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace trillek {
+namespace graphics {
+
+const unsigned int MeshSimplifier::MAX_LEVELS;
+const unsigned int MeshSimplifier::LEVEL_MIN_TRIANGLES;
+
+// a level is kept when it has at most this part of the indices of the level before
+static const float LEVEL_MIN_SAVING = 0.75f;
+
+namespace {
+
+/**
+ * \brief The weighted sum of the squared distances to a set of planes
+ */
+struct Quadric {
+    double a00, a01, a02, a03, a11, a12, a13, a22, a23, a33;
+    double weight;
+
+    Quadric() : a00(0.0), a01(0.0), a02(0.0), a03(0.0), a11(0.0), a12(0.0), a13(0.0),
+        a22(0.0), a23(0.0), a33(0.0), weight(0.0) { }
+
+    /**
+     * \brief The plane of the points p where dot(normal, p) + distance = 0.
+     */
+    Quadric(const glm::vec3 &normal, float distance, float weight) : weight(weight) {
+        const double x = normal.x, y = normal.y, z = normal.z, d = distance;
+        this->a00 = weight * x * x; this->a01 = weight * x * y; this->a02 = weight * x * z; this->a03 = weight * x * d;
+        this->a11 = weight * y * y; this->a12 = weight * y * z; this->a13 = weight * y * d;
+        this->a22 = weight * z * z; this->a23 = weight * z * d;
+        this->a33 = weight * d * d;
+    }
+
+    Quadric& operator+=(const Quadric &other) {
+        this->a00 += other.a00; this->a01 += other.a01; this->a02 += other.a02; this->a03 += other.a03;
+        this->a11 += other.a11; this->a12 += other.a12; this->a13 += other.a13;
+        this->a22 += other.a22; this->a23 += other.a23;
+        this->a33 += other.a33;
+        this->weight += other.weight;
+        return *this;
+    }
+
+    /**
+     * \brief The mean squared distance of a point to the planes.
+     *
+     * Only orders the collapses, a point close to the planes on average can
+     * still be far from one of them.
+     */
+    double Error(const glm::vec3 &point) const {
+        if(this->weight <= 0.0) {
+            return 0.0;
+        }
+        const double x = point.x, y = point.y, z = point.z;
+        const double error = this->a00 * x * x + 2.0 * (this->a01 * x * y + this->a02 * x * z + this->a03 * x)
+            + this->a11 * y * y + 2.0 * (this->a12 * y * z + this->a13 * y)
+            + this->a22 * z * z + 2.0 * this->a23 * z + this->a33;
+        return std::max(0.0, error / this->weight);
+    }
+};
+
+struct Collapse {
+    double error;
+    uint32_t from; // the vertex moved
+    uint32_t to; // the vertex kept
+
+    bool operator<(const Collapse &other) const { return this->error < other.error; }
+};
+
+/**
+ * \brief Whether moving a vertex onto another turns over one of the triangles around it.
+ *
+ * The triangles with both vertices disappear and are not checked.
+ */
+bool Flips(const std::vector<glm::vec3> &positions, const std::vector<unsigned int> &indices,
+        const uint32_t *triangles, size_t triangle_count, uint32_t from, uint32_t to) {
+    for(size_t i = 0; i < triangle_count; i++) {
+        const unsigned int *corner = &indices[triangles[i] * 3];
+        if(corner[0] == to || corner[1] == to || corner[2] == to) {
+            continue;
+        }
+        glm::vec3 before[3], after[3];
+        for(unsigned int k = 0; k < 3; k++) {
+            before[k] = positions[corner[k]];
+            after[k] = corner[k] == from ? positions[to] : before[k];
+        }
+        const glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+        const glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if(glm::dot(normal_before, normal_after) <= 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * \brief The squared distance of a point to a triangle.
+ */
+float TriangleDistance2(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+    // the closest point is found from the region of the triangle the point projects in
+    const glm::vec3 ab = b - a, ac = c - a, ap = p - a;
+    glm::vec3 closest;
+    const float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    const glm::vec3 bp = p - b;
+    const float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    const glm::vec3 cp = p - c;
+    const float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    const float va = d3 * d6 - d5 * d4, vb = d5 * d2 - d1 * d6, vc = d1 * d4 - d3 * d2;
+    if(d1 <= 0.0f && d2 <= 0.0f) {
+        closest = a;
+    }
+    else if(d3 >= 0.0f && d4 <= d3) {
+        closest = b;
+    }
+    else if(d6 >= 0.0f && d5 <= d6) {
+        closest = c;
+    }
+    else if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+        closest = a + ab * (d1 / (d1 - d3));
+    }
+    else if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+        closest = a + ac * (d2 / (d2 - d6));
+    }
+    else if(va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f) {
+        closest = b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    else {
+        const float scale = 1.0f / (va + vb + vc);
+        closest = a + ab * (vb * scale) + ac * (vc * scale);
+    }
+    const glm::vec3 offset = p - closest;
+    return glm::dot(offset, offset);
+}
+
+} // namespace
+
+float MeshSimplifier::Simplify(const std::vector<glm::vec3> &positions, const unsigned int *indices,
+        size_t index_count, size_t target_count, float max_error, std::vector<unsigned int> &out) {
+    out.assign(indices, indices + index_count - index_count % 3);
+    const size_t vertex_count = positions.size();
+    std::vector<Quadric> quadrics(vertex_count);
+    for(size_t t = 0; t < out.size(); t += 3) {
+        const glm::vec3 &p0 = positions[out[t]];
+        glm::vec3 normal = glm::cross(positions[out[t + 1]] - p0, positions[out[t + 2]] - p0);
+        const float length = glm::length(normal);
+        if(!(length > 0.0f)) {
+            continue;
+        }
+        normal = normal * (1.0f / length);
+        // weighted by the area of the triangle
+        const Quadric plane(normal, -glm::dot(normal, p0), length * 0.5f);
+        for(unsigned int k = 0; k < 3; k++) {
+            quadrics[out[t + k]] += plane;
+        }
+    }
+
+    const double error_limit = static_cast<double>(max_error) * max_error;
+    // the vertex each vertex of the mesh was moved onto
+    std::vector<uint32_t> moved_to(vertex_count, std::numeric_limits<uint32_t>::max());
+    for(unsigned int index : out) {
+        moved_to[index] = index;
+    }
+    std::vector<uint32_t> remap(vertex_count);
+    std::vector<uint8_t> locked(vertex_count);
+    std::vector<uint8_t> touched(vertex_count);
+    std::vector<uint32_t> first_triangle(vertex_count);
+    first_triangle.push_back(0);
+    std::vector<uint32_t> fill(vertex_count);
+    std::vector<uint32_t> triangles;
+    std::vector<std::pair<uint32_t, uint32_t>> edges;
+    std::vector<Collapse> collapses;
+    // each pass collapses the cheapest edges that do not share a triangle
+    while(out.size() > target_count) {
+        // the triangles around each vertex
+        std::fill(first_triangle.begin(), first_triangle.end(), 0);
+        for(unsigned int index : out) {
+            first_triangle[index + 1]++;
+        }
+        for(size_t v = 0; v < vertex_count; v++) {
+            first_triangle[v + 1] += first_triangle[v];
+        }
+        std::copy(first_triangle.begin(), first_triangle.end() - 1, fill.begin());
+        triangles.resize(out.size());
+        for(size_t i = 0; i < out.size(); i++) {
+            triangles[fill[out[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        // each edge once, an edge of a single triangle is open and its vertices stay
+        edges.clear();
+        for(size_t t = 0; t < out.size(); t += 3) {
+            for(unsigned int k = 0; k < 3; k++) {
+                const uint32_t a = out[t + k], b = out[t + (k + 1) % 3];
+                edges.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        std::fill(locked.begin(), locked.end(), 0);
+        size_t unique = 0;
+        for(size_t e = 0; e < edges.size();) {
+            size_t next = e + 1;
+            while(next < edges.size() && edges[next] == edges[e]) {
+                next++;
+            }
+            if(next - e == 1) {
+                locked[edges[e].first] = 1;
+                locked[edges[e].second] = 1;
+            }
+            edges[unique++] = edges[e];
+            e = next;
+        }
+        edges.resize(unique);
+
+        collapses.clear();
+        for(const auto &edge : edges) {
+            Quadric sum = quadrics[edge.first];
+            sum += quadrics[edge.second];
+            Collapse best;
+            best.error = std::numeric_limits<double>::infinity();
+            if(!locked[edge.first]) {
+                best.error = sum.Error(positions[edge.second]);
+                best.from = edge.first;
+                best.to = edge.second;
+            }
+            if(!locked[edge.second]) {
+                const double error = sum.Error(positions[edge.first]);
+                if(error < best.error) {
+                    best.error = error;
+                    best.from = edge.second;
+                    best.to = edge.first;
+                }
+            }
+            if(best.error <= error_limit) {
+                collapses.push_back(best);
+            }
+        }
+        std::sort(collapses.begin(), collapses.end());
+
+        for(size_t v = 0; v < vertex_count; v++) {
+            remap[v] = static_cast<uint32_t>(v);
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+        const size_t excess = (out.size() - target_count) / 3;
+        size_t removed = 0;
+        for(const Collapse &collapse : collapses) {
+            if(removed >= excess) {
+                break;
+            }
+            if(touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            const uint32_t *around = triangles.data() + first_triangle[collapse.from];
+            const size_t around_count = first_triangle[collapse.from + 1] - first_triangle[collapse.from];
+            if(Flips(positions, out, around, around_count, collapse.from, collapse.to)) {
+                continue;
+            }
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            // the triangles around the moved vertex change, their vertices wait for the next pass
+            for(size_t i = 0; i < around_count; i++) {
+                const unsigned int *corner = &out[around[i] * 3];
+                bool collapsed = false;
+                for(unsigned int k = 0; k < 3; k++) {
+                    touched[corner[k]] = 1;
+                    collapsed = collapsed || corner[k] == collapse.to;
+                }
+                if(collapsed) {
+                    removed++;
+                }
+            }
+        }
+        if(!removed) {
+            break;
+        }
+
+        size_t write = 0;
+        for(size_t t = 0; t < out.size(); t += 3) {
+            const unsigned int a = remap[out[t]], b = remap[out[t + 1]], c = remap[out[t + 2]];
+            if(a != b && b != c && a != c) {
+                out[write++] = a;
+                out[write++] = b;
+                out[write++] = c;
+            }
+        }
+        out.resize(write);
+        // a vertex kept in this pass is not moved in it, so once is enough
+        for(uint32_t &to : moved_to) {
+            if(to != std::numeric_limits<uint32_t>::max()) {
+                to = remap[to];
+            }
+        }
+    }
+
+    // The error is the largest distance of a vertex of the mesh to the
+    // triangles left near the vertex it was moved onto. The surface left is
+    // at least that close, so the error bounds the distance of the mesh
+    // vertices to the result, where the quadrics only give a mean.
+    std::fill(first_triangle.begin(), first_triangle.end(), 0);
+    for(unsigned int index : out) {
+        first_triangle[index + 1]++;
+    }
+    for(size_t v = 0; v < vertex_count; v++) {
+        first_triangle[v + 1] += first_triangle[v];
+    }
+    std::copy(first_triangle.begin(), first_triangle.end() - 1, fill.begin());
+    triangles.resize(out.size());
+    for(size_t i = 0; i < out.size(); i++) {
+        triangles[fill[out[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+    float worst = 0.0f;
+    for(size_t v = 0; v < vertex_count; v++) {
+        const uint32_t to = moved_to[v];
+        if(to == v || to == std::numeric_limits<uint32_t>::max()) {
+            continue;
+        }
+        const glm::vec3 offset = positions[v] - positions[to];
+        float nearest = glm::dot(offset, offset);
+        // the triangles around the vertex and around its neighbours, some twice
+        for(uint32_t i = first_triangle[to]; i < first_triangle[to + 1]; i++) {
+            const unsigned int *around = &out[triangles[i] * 3];
+            for(unsigned int k = 0; k < 3; k++) {
+                for(uint32_t j = first_triangle[around[k]]; j < first_triangle[around[k] + 1]; j++) {
+                    const unsigned int *corner = &out[triangles[j] * 3];
+                    nearest = std::min(nearest, TriangleDistance2(positions[v],
+                        positions[corner[0]], positions[corner[1]], positions[corner[2]]));
+                }
+            }
+        }
+        worst = std::max(worst, nearest);
+    }
+    return std::sqrt(worst);
+}
+
+std::vector<MeshLevel> MeshSimplifier::BuildLevels(const std::vector<glm::vec3> &positions,
+        std::vector<unsigned int> &indices, float max_error) {
+    const size_t full_count = indices.size() - indices.size() % 3;
+    std::vector<MeshLevel> levels;
+    MeshLevel full;
+    full.first_index = 0;
+    full.index_count = static_cast<unsigned int>(full_count);
+    full.error = 0.0f;
+    levels.push_back(full);
+    if(full_count / 3 < LEVEL_MIN_TRIANGLES) {
+        return levels;
+    }
+    std::vector<unsigned int> level_indices;
+    for(unsigned int l = 1; l < MAX_LEVELS; l++) {
+        // each level from the full mesh, so its error is measured against it
+        const size_t target = (full_count >> l) / 3 * 3;
+        const float error = Simplify(positions, indices.data(), full_count, target, max_error, level_indices);
+        const MeshLevel &previous = levels.back();
+        if(level_indices.empty() || level_indices.size() > previous.index_count * LEVEL_MIN_SAVING) {
+            break;
+        }
+        MeshLevel level;
+        level.first_index = static_cast<unsigned int>(indices.size());
+        level.index_count = static_cast<unsigned int>(level_indices.size());
+        level.error = std::max(error, previous.error);
+        indices.insert(indices.end(), level_indices.begin(), level_indices.end());
+        levels.push_back(level);
+        if(level_indices.size() / 3 < LEVEL_MIN_TRIANGLES) {
+            break;
+        }
+    }
+    return levels;
+}
+
+} // namespace graphics
+} // namespace trillek
@@ -0,0 +1,1014 @@
+#include "graphics/null-gl.hpp"
+
+#ifdef TRILLEK_HEADLESS_GL
+
+#include "opengl.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trillek {
+namespace graphics {
+
+namespace {
+
+struct NullUniform {
+    std::string name; // arrays are named after their first element
+    GLenum type;
+    GLint size;
+    GLint location;
+};
+
+struct NullShader {
+    GLenum type;
+    std::string source;
+};
+
+struct NullProgram {
+    std::vector<GLuint> shaders;
+    std::vector<NullUniform> uniforms;
+    std::map<std::string, GLint> attributes;
+    std::vector<std::string> blocks;
+    GLint max_name_length;
+};
+
+/**
+ * \brief The state of the null context
+ *
+ * Only the graphics thread calls GL, the lock is for the counters read
+ * from other threads.
+ */
+struct NullContext {
+    std::mutex lock;
+    GLuint next_name;
+    std::map<GLuint, NullShader> shaders;
+    std::map<GLuint, NullProgram> programs;
+    std::map<GLuint, GLsizeiptr> buffer_sizes;
+    std::map<GLuint, std::vector<char>> buffer_storage; // immutable buffers, can be mapped
+    uintptr_t next_sync;
+    GLuint bound_buffers[4]; // array, element array, texture and uniform buffers
+    GLuint program;
+    GLuint draw_framebuffer;
+    GLuint read_framebuffer;
+    GLint viewport[4];
+    std::ostream *trace;
+    NullGL::Counters frame;
+    NullGL::Counters last_frame;
+    NullGL::Counters total;
+    uint64_t frame_count;
+    uint64_t frame_limit;
+    std::chrono::nanoseconds total_time;
+
+    NullContext() : next_name(1), next_sync(1), program(0), draw_framebuffer(0), read_framebuffer(0),
+        trace(nullptr), frame(), last_frame(), total(), frame_count(0), frame_limit(0),
+        total_time(0) {
+        std::memset(this->bound_buffers, 0, sizeof(this->bound_buffers));
+        std::memset(this->viewport, 0, sizeof(this->viewport));
+    }
+};
+
+NullContext& Context() {
+    static NullContext context;
+    return context;
+}
+
+void TraceArgs(std::ostream &) { }
+
+template<class T, class... Args>
+void TraceArgs(std::ostream &out, const T &value, const Args&... rest) {
+    out << ' ' << value;
+    TraceArgs(out, rest...);
+}
+
+/**
+ * \brief Count a call and write it to the trace.
+ */
+template<class... Args>
+void Record(const char *name, const Args&... args) {
+    NullContext &gl = Context();
+    gl.frame.calls++;
+    if(gl.trace) {
+        *gl.trace << name;
+        TraceArgs(*gl.trace, args...);
+        *gl.trace << '\n';
+    }
+}
+
+void GenNames(GLsizei count, GLuint *names) {
+    NullContext &gl = Context();
+    for(GLsizei i = 0; i < count; i++) {
+        names[i] = gl.next_name++;
+    }
+    gl.frame.objects += count;
+}
+
+GLuint* BufferBinding(GLenum target) {
+    NullContext &gl = Context();
+    switch(target) {
+    case GL_ARRAY_BUFFER: return &gl.bound_buffers[0];
+    case GL_ELEMENT_ARRAY_BUFFER: return &gl.bound_buffers[1];
+    case GL_TEXTURE_BUFFER: return &gl.bound_buffers[2];
+    case GL_UNIFORM_BUFFER: return &gl.bound_buffers[3];
+    default: return nullptr;
+    }
+}
+
+GLenum UniformType(const std::string &type) {
+    static const std::map<std::string, GLenum> types = {
+        {"float", GL_FLOAT}, {"vec2", GL_FLOAT_VEC2}, {"vec3", GL_FLOAT_VEC3},
+        {"vec4", GL_FLOAT_VEC4}, {"int", GL_INT}, {"ivec2", GL_INT_VEC2},
+        {"ivec3", GL_INT_VEC3}, {"ivec4", GL_INT_VEC4}, {"uint", GL_UNSIGNED_INT},
+        {"uvec2", GL_UNSIGNED_INT_VEC2}, {"uvec3", GL_UNSIGNED_INT_VEC3},
+        {"uvec4", GL_UNSIGNED_INT_VEC4}, {"bool", GL_BOOL}, {"mat3", GL_FLOAT_MAT3},
+        {"mat4", GL_FLOAT_MAT4}, {"sampler2D", GL_SAMPLER_2D},
+        {"sampler2DMS", GL_SAMPLER_2D_MULTISAMPLE}, {"sampler2DShadow", GL_SAMPLER_2D_SHADOW},
+        {"samplerBuffer", GL_SAMPLER_BUFFER}, {"isamplerBuffer", GL_INT_SAMPLER_BUFFER},
+        {"usamplerBuffer", GL_UNSIGNED_INT_SAMPLER_BUFFER},
+    };
+    auto type_itr = types.find(type);
+    return type_itr == types.end() ? GL_FLOAT : type_itr->second;
+}
+
+/**
+ * \brief Split GLSL source into identifiers, numbers and single symbols.
+ *
+ * Comments and preprocessor lines are skipped, so declarations in disabled
+ * #if sections are kept.
+ */
+std::vector<std::string> Tokenize(const std::string &source) {
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    bool line_start = true;
+    while(i < source.size()) {
+        char c = source[i];
+        if(c == '\n') {
+            line_start = true;
+            i++;
+        }
+        else if(std::isspace(static_cast<unsigned char>(c))) {
+            i++;
+        }
+        else if(line_start && c == '#') {
+            i = source.find('\n', i);
+            if(i == std::string::npos) break;
+        }
+        else if(source.compare(i, 2, "//") == 0) {
+            i = source.find('\n', i);
+            if(i == std::string::npos) break;
+        }
+        else if(source.compare(i, 2, "/*") == 0) {
+            i = source.find("*/", i + 2);
+            if(i == std::string::npos) break;
+            i += 2;
+        }
+        else if(std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            size_t first = i;
+            while(i < source.size() && (std::isalnum(static_cast<unsigned char>(source[i])) || source[i] == '_')) {
+                i++;
+            }
+            tokens.push_back(source.substr(first, i - first));
+            line_start = false;
+        }
+        else {
+            tokens.push_back(std::string(1, c));
+            line_start = false;
+            i++;
+        }
+    }
+    return tokens;
+}
+
+/**
+ * \brief Find the uniforms, blocks and vertex inputs a shader declares.
+ */
+void ParseDeclarations(const NullShader &shader, NullProgram &prog,
+    std::map<std::string, NullUniform> &uniforms, GLint &next_attribute) {
+    std::vector<std::string> tokens = Tokenize(shader.source);
+    bool statement_start = true;
+    for(size_t i = 0; i < tokens.size(); i++) {
+        const std::string &token = tokens[i];
+        if(token == ";" || token == "{" || token == "}") {
+            statement_start = true;
+            continue;
+        }
+        if(!statement_start) {
+            continue;
+        }
+        statement_start = false;
+        size_t t = i;
+        GLint explicit_location = -1;
+        if(tokens[t] == "layout") {
+            for(; t < tokens.size() && tokens[t] != ")"; t++) {
+                if(tokens[t] == "location" && t + 2 < tokens.size()) {
+                    explicit_location = std::atoi(tokens[t + 2].c_str());
+                }
+            }
+            t++;
+        }
+        while(t < tokens.size() && (tokens[t] == "flat" || tokens[t] == "smooth"
+            || tokens[t] == "highp" || tokens[t] == "mediump" || tokens[t] == "lowp")) {
+            t++;
+        }
+        if(t + 2 >= tokens.size()) {
+            break;
+        }
+        const std::string &qualifier = tokens[t];
+        if(qualifier == "uniform" && tokens[t + 2] == "{") {
+            // a block, the members have no location
+            prog.blocks.push_back(tokens[t + 1]);
+            while(t < tokens.size() && tokens[t] != "}") t++;
+            while(t < tokens.size() && tokens[t] != ";") t++;
+            i = t;
+            statement_start = true;
+        }
+        else if(qualifier == "uniform") {
+            GLenum type = UniformType(tokens[t + 1]);
+            for(t += 2; t < tokens.size() && tokens[t] != ";"; t++) {
+                if(tokens[t] == ",") continue;
+                NullUniform uniform{tokens[t], type, 1, -1};
+                if(t + 3 < tokens.size() && tokens[t + 1] == "[") {
+                    // sizes given by a macro are unknown here, assume a large array
+                    uniform.size = std::isdigit(static_cast<unsigned char>(tokens[t + 2][0]))
+                        ? std::max(1, std::atoi(tokens[t + 2].c_str())) : 64;
+                    uniform.name += "[0]";
+                    t += 3;
+                }
+                uniforms.insert(std::make_pair(uniform.name, uniform));
+            }
+            i = t;
+            statement_start = true;
+        }
+        else if(qualifier == "in" && shader.type == GL_VERTEX_SHADER) {
+            GLint slots = tokens[t + 1] == "mat4" ? 4 : tokens[t + 1] == "mat3" ? 3 : 1;
+            const std::string &name = tokens[t + 2];
+            if(prog.attributes.find(name) == prog.attributes.end()) {
+                if(explicit_location >= 0) {
+                    next_attribute = explicit_location;
+                }
+                prog.attributes[name] = next_attribute;
+                next_attribute += slots;
+            }
+        }
+    }
+}
+
+void LinkProgram(NullProgram &prog) {
+    NullContext &gl = Context();
+    std::map<std::string, NullUniform> uniforms;
+    GLint next_attribute = 0;
+    prog.uniforms.clear();
+    prog.attributes.clear();
+    prog.blocks.clear();
+    for(GLuint shader : prog.shaders) {
+        auto shader_itr = gl.shaders.find(shader);
+        if(shader_itr != gl.shaders.end()) {
+            ParseDeclarations(shader_itr->second, prog, uniforms, next_attribute);
+        }
+    }
+    GLint location = 0;
+    prog.max_name_length = 1;
+    for(auto &uniform : uniforms) {
+        uniform.second.location = location;
+        location += uniform.second.size;
+        prog.max_name_length = std::max<GLint>(prog.max_name_length, uniform.second.name.size() + 1);
+        prog.uniforms.push_back(uniform.second);
+    }
+}
+
+const NullProgram* FindProgram(GLuint program) {
+    NullContext &gl = Context();
+    auto prog_itr = gl.programs.find(program);
+    return prog_itr == gl.programs.end() ? nullptr : &prog_itr->second;
+}
+
+} // anonymous namespace
+
+void NullGL::SetTrace(std::ostream *out) {
+    Context().trace = out;
+}
+
+void NullGL::EndFrame(std::chrono::nanoseconds cpu_time) {
+    NullContext &gl = Context();
+    std::lock_guard<std::mutex> locker(gl.lock);
+    gl.last_frame = gl.frame;
+    gl.total.calls += gl.frame.calls;
+    gl.total.draws += gl.frame.draws;
+    gl.total.triangles += gl.frame.triangles;
+    gl.total.upload_bytes += gl.frame.upload_bytes;
+    gl.total.uniforms += gl.frame.uniforms;
+    gl.total.binds += gl.frame.binds;
+    gl.total.objects += gl.frame.objects;
+    gl.total_time += cpu_time;
+    gl.frame = Counters();
+    gl.frame_count++;
+    if(gl.trace) {
+        *gl.trace << "# end of frame " << gl.frame_count << '\n';
+    }
+}
+
+void NullGL::SetFrameLimit(uint64_t frames) {
+    NullContext &gl = Context();
+    std::lock_guard<std::mutex> locker(gl.lock);
+    gl.frame_limit = frames;
+}
+
+bool NullGL::FrameLimitReached() {
+    NullContext &gl = Context();
+    std::lock_guard<std::mutex> locker(gl.lock);
+    return gl.frame_limit && gl.frame_count >= gl.frame_limit;
+}
+
+const NullGL::Counters& NullGL::GetFrameCounters() {
+    return Context().last_frame;
+}
+
+const NullGL::Counters& NullGL::GetTotalCounters() {
+    return Context().total;
+}
+
+uint64_t NullGL::GetFrameCount() {
+    return Context().frame_count;
+}
+
+std::chrono::nanoseconds NullGL::GetTotalTime() {
+    return Context().total_time;
+}
+
+void NullGL::Report(std::ostream &out) {
+    NullContext &gl = Context();
+    std::lock_guard<std::mutex> locker(gl.lock);
+    out << "NullGL frames: " << gl.frame_count << '\n';
+    if(!gl.frame_count) {
+        return;
+    }
+    const double frames = static_cast<double>(gl.frame_count);
+    out << "per frame:"
+        << " cpu " << std::chrono::duration<double, std::micro>(gl.total_time).count() / frames << " us"
+        << ", calls " << gl.total.calls / frames
+        << ", draws " << gl.total.draws / frames
+        << ", triangles " << gl.total.triangles / frames
+        << ", uniforms " << gl.total.uniforms / frames
+        << ", binds " << gl.total.binds / frames
+        << ", uploaded " << gl.total.upload_bytes / frames << " bytes"
+        << ", objects " << gl.total.objects / frames << '\n';
+}
+
+} // namespace graphics
+} // namespace trillek
+
+using trillek::graphics::Context;
+using trillek::graphics::Record;
+using trillek::graphics::NullContext;
+using trillek::graphics::NullProgram;
+
+// GL 1.1, exported by the GL library in normal builds
+
+extern "C" {
+
+void GLAPIENTRY glBindTexture(GLenum target, GLuint texture) {
+    Record("glBindTexture", target, texture);
+    Context().frame.binds++;
+}
+
+void GLAPIENTRY glBlendFunc(GLenum sfactor, GLenum dfactor) {
+    Record("glBlendFunc", sfactor, dfactor);
+}
+
+void GLAPIENTRY glClear(GLbitfield mask) {
+    Record("glClear", mask);
+}
+
+void GLAPIENTRY glClearColor(GLclampf red, GLclampf green, GLclampf blue, GLclampf alpha) {
+    Record("glClearColor", red, green, blue, alpha);
+}
+
+void GLAPIENTRY glClearDepth(GLclampd depth) {
+    Record("glClearDepth", depth);
+}
+
+void GLAPIENTRY glClearStencil(GLint s) {
+    Record("glClearStencil", s);
+}
+
+void GLAPIENTRY glDeleteTextures(GLsizei n, const GLuint *textures) {
+    Record("glDeleteTextures", n);
+}
+
+void GLAPIENTRY glDisable(GLenum cap) {
+    Record("glDisable", cap);
+}
+
+void GLAPIENTRY glDrawBuffer(GLenum mode) {
+    Record("glDrawBuffer", mode);
+}
+
+void GLAPIENTRY glDrawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) {
+    Record("glDrawElements", mode, count, type);
+    NullContext &gl = Context();
+    gl.frame.draws++;
+    if(mode == GL_TRIANGLES) {
+        gl.frame.triangles += count / 3;
+    }
+}
+
+void GLAPIENTRY glEnable(GLenum cap) {
+    Record("glEnable", cap);
+}
+
+void GLAPIENTRY glGenTextures(GLsizei n, GLuint *textures) {
+    Record("glGenTextures", n);
+    trillek::graphics::GenNames(n, textures);
+}
+
+GLenum GLAPIENTRY glGetError(void) {
+    return GL_NO_ERROR;
+}
+
+void GLAPIENTRY glGetIntegerv(GLenum pname, GLint *data) {
+    Record("glGetIntegerv", pname);
+    NullContext &gl = Context();
+    switch(pname) {
+    case GL_MAJOR_VERSION: *data = 3; break;
+    case GL_MINOR_VERSION: *data = 3; break;
+    case GL_VIEWPORT: std::memcpy(data, gl.viewport, sizeof(gl.viewport)); break;
+    case GL_DRAW_FRAMEBUFFER_BINDING: *data = gl.draw_framebuffer; break;
+    case GL_READ_FRAMEBUFFER_BINDING: *data = gl.read_framebuffer; break;
+    case GL_CURRENT_PROGRAM: *data = gl.program; break;
+    case GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT: *data = 256; break;
+    case GL_MAX_TEXTURE_BUFFER_SIZE: *data = 1 << 27; break;
+    default: *data = 0; break;
+    }
+}
+
+const GLubyte* GLAPIENTRY glGetString(GLenum name) {
+    switch(name) {
+    case GL_VENDOR: return reinterpret_cast<const GLubyte*>("Trillek");
+    case GL_RENDERER: return reinterpret_cast<const GLubyte*>("NullGL recorder");
+    case GL_VERSION: return reinterpret_cast<const GLubyte*>("3.3.0 NullGL");
+    case GL_SHADING_LANGUAGE_VERSION: return reinterpret_cast<const GLubyte*>("3.30");
+    default: return reinterpret_cast<const GLubyte*>("");
+    }
+}
+
+void GLAPIENTRY glPolygonMode(GLenum face, GLenum mode) {
+    Record("glPolygonMode", face, mode);
+}
+
+void GLAPIENTRY glReadBuffer(GLenum mode) {
+    Record("glReadBuffer", mode);
+}
+
+void GLAPIENTRY glScissor(GLint x, GLint y, GLsizei width, GLsizei height) {
+    Record("glScissor", x, y, width, height);
+}
+
+void GLAPIENTRY glTexImage2D(GLenum target, GLint level, GLint internalformat, GLsizei width,
+    GLsizei height, GLint border, GLenum format, GLenum type, const void *pixels) {
+    Record("glTexImage2D", target, level, internalformat, width, height);
+    if(pixels) {
+        // the textures the engine loads are 8 bits per channel
+        GLint channels = format == GL_RGBA ? 4 : format == GL_RGB ? 3 : format == GL_RG ? 2 : 1;
+        Context().frame.upload_bytes += uint64_t(width) * height * channels;
+    }
+}
+
+void GLAPIENTRY glTexParameteri(GLenum target, GLenum pname, GLint param) {
+    Record("glTexParameteri", target, pname, param);
+}
+
+void GLAPIENTRY glViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    Record("glViewport", x, y, width, height);
+    GLint *viewport = Context().viewport;
+    viewport[0] = x;
+    viewport[1] = y;
+    viewport[2] = width;
+    viewport[3] = height;
+}
+
+} // extern "C"
+
+// Later versions, loaded through the GLEW function pointers in normal builds
+
+namespace {
+
+void GLAPIENTRY NullActiveTexture(GLenum texture) {
+    Record("glActiveTexture", texture);
+}
+
+void GLAPIENTRY NullAttachShader(GLuint program, GLuint shader) {
+    Record("glAttachShader", program, shader);
+    Context().programs[program].shaders.push_back(shader);
+}
+
+void GLAPIENTRY NullBindBuffer(GLenum target, GLuint buffer) {
+    Record("glBindBuffer", target, buffer);
+    NullContext &gl = Context();
+    gl.frame.binds++;
+    GLuint *binding = trillek::graphics::BufferBinding(target);
+    if(binding) {
+        *binding = buffer;
+    }
+}
+
+void GLAPIENTRY NullBindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    Record("glBindBufferBase", target, index, buffer);
+    Context().frame.binds++;
+    GLuint *binding = trillek::graphics::BufferBinding(target);
+    if(binding) {
+        *binding = buffer;
+    }
+}
+
+void GLAPIENTRY NullBindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    Record("glBindBufferRange", target, index, buffer, offset, size);
+    Context().frame.binds++;
+    GLuint *binding = trillek::graphics::BufferBinding(target);
+    if(binding) {
+        *binding = buffer;
+    }
+}
+
+void GLAPIENTRY NullBindFragDataLocation(GLuint program, GLuint color, const GLchar *name) {
+    Record("glBindFragDataLocation", program, color, name);
+}
+
+void GLAPIENTRY NullBindFramebuffer(GLenum target, GLuint framebuffer) {
+    Record("glBindFramebuffer", target, framebuffer);
+    NullContext &gl = Context();
+    gl.frame.binds++;
+    if(target != GL_READ_FRAMEBUFFER) {
+        gl.draw_framebuffer = framebuffer;
+    }
+    if(target != GL_DRAW_FRAMEBUFFER) {
+        gl.read_framebuffer = framebuffer;
+    }
+}
+
+void GLAPIENTRY NullBindVertexArray(GLuint array) {
+    Record("glBindVertexArray", array);
+    Context().frame.binds++;
+}
+
+void GLAPIENTRY NullBlitFramebuffer(GLint srcX0, GLint srcY0, GLint srcX1, GLint srcY1,
+    GLint dstX0, GLint dstY0, GLint dstX1, GLint dstY1, GLbitfield mask, GLenum filter) {
+    Record("glBlitFramebuffer", srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1, mask);
+}
+
+void GLAPIENTRY NullBufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+    Record("glBufferData", target, size, usage);
+    NullContext &gl = Context();
+    GLuint *binding = trillek::graphics::BufferBinding(target);
+    if(binding && *binding) {
+        gl.buffer_sizes[*binding] = size;
+    }
+    if(data) {
+        gl.frame.upload_bytes += size;
+    }
+}
+
+void GLAPIENTRY NullBufferStorage(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags) {
+    Record("glBufferStorage", target, size, flags);
+    NullContext &gl = Context();
+    GLuint *binding = trillek::graphics::BufferBinding(target);
+    if(binding && *binding) {
+        gl.buffer_sizes[*binding] = size;
+        std::vector<char> &storage = gl.buffer_storage[*binding];
+        storage.assign(static_cast<size_t>(size), 0);
+        if(data) {
+            std::memcpy(storage.data(), data, static_cast<size_t>(size));
+            gl.frame.upload_bytes += size;
+        }
+    }
+}
+
+void GLAPIENTRY NullBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void *data) {
+    Record("glBufferSubData", target, offset, size);
+    Context().frame.upload_bytes += size;
+}
+
+GLenum GLAPIENTRY NullClientWaitSync(GLsync sync, GLbitfield flags, GLuint64 timeout) {
+    Record("glClientWaitSync", sync, flags);
+    return GL_ALREADY_SIGNALED; // nothing is ever pending
+}
+
+GLenum GLAPIENTRY NullCheckFramebufferStatus(GLenum target) {
+    Record("glCheckFramebufferStatus", target);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+void GLAPIENTRY NullCompileShader(GLuint shader) {
+    Record("glCompileShader", shader);
+}
+
+GLuint GLAPIENTRY NullCreateProgram(void) {
+    GLuint program;
+    trillek::graphics::GenNames(1, &program);
+    Record("glCreateProgram", program);
+    Context().programs[program];
+    return program;
+}
+
+GLuint GLAPIENTRY NullCreateShader(GLenum type) {
+    GLuint shader;
+    trillek::graphics::GenNames(1, &shader);
+    Record("glCreateShader", type, shader);
+    Context().shaders[shader].type = type;
+    return shader;
+}
+
+void GLAPIENTRY NullDeleteBuffers(GLsizei n, const GLuint *buffers) {
+    Record("glDeleteBuffers", n);
+    NullContext &gl = Context();
+    for(GLsizei i = 0; i < n; i++) {
+        gl.buffer_sizes.erase(buffers[i]);
+        gl.buffer_storage.erase(buffers[i]);
+    }
+}
+
+void GLAPIENTRY NullDeleteFramebuffers(GLsizei n, const GLuint *framebuffers) {
+    Record("glDeleteFramebuffers", n);
+}
+
+void GLAPIENTRY NullDeleteProgram(GLuint program) {
+    Record("glDeleteProgram", program);
+    Context().programs.erase(program);
+}
+
+void GLAPIENTRY NullDeleteRenderbuffers(GLsizei n, const GLuint *renderbuffers) {
+    Record("glDeleteRenderbuffers", n);
+}
+
+void GLAPIENTRY NullDeleteShader(GLuint shader) {
+    Record("glDeleteShader", shader);
+    // the source is kept for programs linked again with the shader
+}
+
+void GLAPIENTRY NullDeleteSync(GLsync sync) {
+    Record("glDeleteSync", sync);
+}
+
+void GLAPIENTRY NullDeleteVertexArrays(GLsizei n, const GLuint *arrays) {
+    Record("glDeleteVertexArrays", n);
+}
+
+void GLAPIENTRY NullDisableVertexAttribArray(GLuint index) {
+    Record("glDisableVertexAttribArray", index);
+}
+
+void GLAPIENTRY NullDrawBuffers(GLsizei n, const GLenum *bufs) {
+    Record("glDrawBuffers", n);
+}
+
+void GLAPIENTRY NullDrawElementsInstanced(GLenum mode, GLsizei count, GLenum type,
+    const void *indices, GLsizei instancecount) {
+    Record("glDrawElementsInstanced", mode, count, type, instancecount);
+    NullContext &gl = Context();
+    gl.frame.draws++;
+    if(mode == GL_TRIANGLES) {
+        gl.frame.triangles += uint64_t(count / 3) * instancecount;
+    }
+}
+
+void GLAPIENTRY NullEnableVertexAttribArray(GLuint index) {
+    Record("glEnableVertexAttribArray", index);
+}
+
+GLsync GLAPIENTRY NullFenceSync(GLenum condition, GLbitfield flags) {
+    GLsync sync = reinterpret_cast<GLsync>(Context().next_sync++);
+    Record("glFenceSync", sync);
+    return sync;
+}
+
+void GLAPIENTRY NullFramebufferRenderbuffer(GLenum target, GLenum attachment,
+    GLenum renderbuffertarget, GLuint renderbuffer) {
+    Record("glFramebufferRenderbuffer", target, attachment, renderbuffer);
+}
+
+void GLAPIENTRY NullFramebufferTexture2D(GLenum target, GLenum attachment, GLenum textarget,
+    GLuint texture, GLint level) {
+    Record("glFramebufferTexture2D", target, attachment, textarget, texture, level);
+}
+
+void GLAPIENTRY NullGenBuffers(GLsizei n, GLuint *buffers) {
+    Record("glGenBuffers", n);
+    trillek::graphics::GenNames(n, buffers);
+}
+
+void GLAPIENTRY NullGenFramebuffers(GLsizei n, GLuint *framebuffers) {
+    Record("glGenFramebuffers", n);
+    trillek::graphics::GenNames(n, framebuffers);
+}
+
+void GLAPIENTRY NullGenRenderbuffers(GLsizei n, GLuint *renderbuffers) {
+    Record("glGenRenderbuffers", n);
+    trillek::graphics::GenNames(n, renderbuffers);
+}
+
+void GLAPIENTRY NullGenVertexArrays(GLsizei n, GLuint *arrays) {
+    Record("glGenVertexArrays", n);
+    trillek::graphics::GenNames(n, arrays);
+}
+
+void GLAPIENTRY NullGetActiveUniform(GLuint program, GLuint index, GLsizei bufSize,
+    GLsizei *length, GLint *size, GLenum *type, GLchar *name) {
+    Record("glGetActiveUniform", program, index);
+    const NullProgram *prog = trillek::graphics::FindProgram(program);
+    if(!prog || index >= prog->uniforms.size() || bufSize < 1) {
+        return;
+    }
+    const auto &uniform = prog->uniforms[index];
+    GLsizei count = std::min<GLsizei>(bufSize - 1, uniform.name.size());
+    std::memcpy(name, uniform.name.data(), count);
+    name[count] = 0;
+    if(length) *length = count;
+    *size = uniform.size;
+    *type = uniform.type;
+}
+
+GLint GLAPIENTRY NullGetAttribLocation(GLuint program, const GLchar *name) {
+    Record("glGetAttribLocation", program, name);
+    const NullProgram *prog = trillek::graphics::FindProgram(program);
+    if(!prog) {
+        return -1;
+    }
+    auto attrib_itr = prog->attributes.find(name);
+    return attrib_itr == prog->attributes.end() ? -1 : attrib_itr->second;
+}
+
+void GLAPIENTRY NullGetProgramInfoLog(GLuint program, GLsizei bufSize, GLsizei *length, GLchar *infoLog) {
+    if(length) *length = 0;
+    if(bufSize > 0) infoLog[0] = 0;
+}
+
+void GLAPIENTRY NullGetProgramiv(GLuint program, GLenum pname, GLint *params) {
+    Record("glGetProgramiv", program, pname);
+    const NullProgram *prog = trillek::graphics::FindProgram(program);
+    switch(pname) {
+    case GL_LINK_STATUS: *params = prog ? GL_TRUE : GL_FALSE; break;
+    case GL_ACTIVE_UNIFORMS: *params = prog ? prog->uniforms.size() : 0; break;
+    case GL_ACTIVE_UNIFORM_MAX_LENGTH: *params = prog ? prog->max_name_length : 0; break;
+    case GL_ACTIVE_ATTRIBUTES: *params = prog ? prog->attributes.size() : 0; break;
+    case GL_INFO_LOG_LENGTH: *params = 1; break;
+    default: *params = 0; break;
+    }
+}
+
+void GLAPIENTRY NullGetShaderInfoLog(GLuint shader, GLsizei bufSize, GLsizei *length, GLchar *infoLog) {
+    if(length) *length = 0;
+    if(bufSize > 0) infoLog[0] = 0;
+}
+
+void GLAPIENTRY NullGetShaderiv(GLuint shader, GLenum pname, GLint *params) {
+    Record("glGetShaderiv", shader, pname);
+    switch(pname) {
+    case GL_COMPILE_STATUS: *params = GL_TRUE; break;
+    case GL_INFO_LOG_LENGTH: *params = 1; break;
+    case GL_SHADER_TYPE: *params = Context().shaders[shader].type; break;
+    default: *params = 0; break;
+    }
+}
+
+GLuint GLAPIENTRY NullGetUniformBlockIndex(GLuint program, const GLchar *uniformBlockName) {
+    Record("glGetUniformBlockIndex", program, uniformBlockName);
+    const NullProgram *prog = trillek::graphics::FindProgram(program);
+    if(prog) {
+        for(size_t i = 0; i < prog->blocks.size(); i++) {
+            if(prog->blocks[i] == uniformBlockName) {
+                return static_cast<GLuint>(i);
+            }
+        }
+    }
+    return GL_INVALID_INDEX;
+}
+
+GLint GLAPIENTRY NullGetUniformLocation(GLuint program, const GLchar *name) {
+    Record("glGetUniformLocation", program, name);
+    const NullProgram *prog = trillek::graphics::FindProgram(program);
+    if(!prog) {
+        return -1;
+    }
+    // "name", "name[0]" and "name[i]" for arrays
+    std::string base(name);
+    GLint element = 0;
+    size_t bracket = base.find('[');
+    if(bracket != std::string::npos) {
+        element = std::atoi(base.c_str() + bracket + 1);
+        base.erase(bracket);
+    }
+    for(const auto &uniform : prog->uniforms) {
+        if(uniform.name.compare(0, base.size(), base) != 0) {
+            continue;
+        }
+        if(uniform.name.size() == base.size()
+            || (uniform.name.size() == base.size() + 3 && uniform.name[base.size()] == '[')) {
+            return element < uniform.size ? uniform.location + element : -1;
+        }
+    }
+    return -1;
+}
+
+void GLAPIENTRY NullLinkProgram(GLuint program) {
+    Record("glLinkProgram", program);
+    trillek::graphics::LinkProgram(Context().programs[program]);
+}
+
+void* GLAPIENTRY NullMapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) {
+    Record("glMapBufferRange", target, offset, length, access);
+    NullContext &gl = Context();
+    GLuint *binding = trillek::graphics::BufferBinding(target);
+    if(!binding) {
+        return nullptr;
+    }
+    auto storage = gl.buffer_storage.find(*binding);
+    if(storage == gl.buffer_storage.end() || offset + length > static_cast<GLsizeiptr>(storage->second.size())) {
+        return nullptr; // only the buffers made with glBufferStorage are mapped
+    }
+    return storage->second.data() + offset;
+}
+
+void GLAPIENTRY NullShaderSource(GLuint shader, GLsizei count, const GLchar *const *string, const GLint *length) {
+    Record("glShaderSource", shader, count);
+    std::string &source = Context().shaders[shader].source;
+    source.clear();
+    for(GLsizei i = 0; i < count; i++) {
+        if(length && length[i] >= 0) {
+            source.append(string[i], length[i]);
+        }
+        else {
+            source.append(string[i]);
+        }
+    }
+}
+
+void GLAPIENTRY NullTexBuffer(GLenum target, GLenum internalformat, GLuint buffer) {
+    Record("glTexBuffer", target, internalformat, buffer);
+}
+
+void GLAPIENTRY NullTexImage2DMultisample(GLenum target, GLsizei samples, GLenum internalformat,
+    GLsizei width, GLsizei height, GLboolean fixedsamplelocations) {
+    Record("glTexImage2DMultisample", target, samples, internalformat, width, height);
+}
+
+GLboolean GLAPIENTRY NullUnmapBuffer(GLenum target) {
+    Record("glUnmapBuffer", target);
+    return GL_TRUE;
+}
+
+void GLAPIENTRY NullUniform1f(GLint location, GLfloat v0) {
+    Record("glUniform1f", location, v0);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniform1i(GLint location, GLint v0) {
+    Record("glUniform1i", location, v0);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniform1ui(GLint location, GLuint v0) {
+    Record("glUniform1ui", location, v0);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniform2f(GLint location, GLfloat v0, GLfloat v1) {
+    Record("glUniform2f", location, v0, v1);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2) {
+    Record("glUniform3f", location, v0, v1, v2);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniform3fv(GLint location, GLsizei count, const GLfloat *value) {
+    Record("glUniform3fv", location, count);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniform3ui(GLint location, GLuint v0, GLuint v1, GLuint v2) {
+    Record("glUniform3ui", location, v0, v1, v2);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniform4f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+    Record("glUniform4f", location, v0, v1, v2, v3);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUniformBlockBinding(GLuint program, GLuint uniformBlockIndex, GLuint uniformBlockBinding) {
+    Record("glUniformBlockBinding", program, uniformBlockIndex, uniformBlockBinding);
+}
+
+void GLAPIENTRY NullUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value) {
+    Record("glUniformMatrix4fv", location, count);
+    Context().frame.uniforms++;
+}
+
+void GLAPIENTRY NullUseProgram(GLuint program) {
+    Record("glUseProgram", program);
+    NullContext &gl = Context();
+    gl.frame.binds++;
+    gl.program = program;
+}
+
+void GLAPIENTRY NullVertexAttrib4fv(GLuint index, const GLfloat *v) {
+    Record("glVertexAttrib4fv", index);
+}
+
+void GLAPIENTRY NullVertexAttribDivisor(GLuint index, GLuint divisor) {
+    Record("glVertexAttribDivisor", index, divisor);
+}
+
+void GLAPIENTRY NullVertexAttribI1i(GLuint index, GLint x) {
+    Record("glVertexAttribI1i", index, x);
+}
+
+void GLAPIENTRY NullVertexAttribIPointer(GLuint index, GLint size, GLenum type, GLsizei stride, const void *pointer) {
+    Record("glVertexAttribIPointer", index, size, type, stride);
+}
+
+void GLAPIENTRY NullVertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized,
+    GLsizei stride, const void *pointer) {
+    Record("glVertexAttribPointer", index, size, type, stride);
+}
+
+} // anonymous namespace
+
+// The pointer types differ between GLEW releases in the constness of some
+// parameters, so the functions are cast to them.
+#define NULL_GL_ENTRY(type, name) type __glew##name = reinterpret_cast<type>(&Null##name)
+
+NULL_GL_ENTRY(PFNGLACTIVETEXTUREPROC, ActiveTexture);
+NULL_GL_ENTRY(PFNGLATTACHSHADERPROC, AttachShader);
+NULL_GL_ENTRY(PFNGLBINDBUFFERPROC, BindBuffer);
+NULL_GL_ENTRY(PFNGLBINDBUFFERBASEPROC, BindBufferBase);
+NULL_GL_ENTRY(PFNGLBINDBUFFERRANGEPROC, BindBufferRange);
+NULL_GL_ENTRY(PFNGLBINDFRAGDATALOCATIONPROC, BindFragDataLocation);
+NULL_GL_ENTRY(PFNGLBINDFRAMEBUFFERPROC, BindFramebuffer);
+NULL_GL_ENTRY(PFNGLBINDVERTEXARRAYPROC, BindVertexArray);
+NULL_GL_ENTRY(PFNGLBLITFRAMEBUFFERPROC, BlitFramebuffer);
+NULL_GL_ENTRY(PFNGLBUFFERDATAPROC, BufferData);
+NULL_GL_ENTRY(PFNGLBUFFERSTORAGEPROC, BufferStorage);
+NULL_GL_ENTRY(PFNGLBUFFERSUBDATAPROC, BufferSubData);
+NULL_GL_ENTRY(PFNGLCHECKFRAMEBUFFERSTATUSPROC, CheckFramebufferStatus);
+NULL_GL_ENTRY(PFNGLCLIENTWAITSYNCPROC, ClientWaitSync);
+NULL_GL_ENTRY(PFNGLCOMPILESHADERPROC, CompileShader);
+NULL_GL_ENTRY(PFNGLCREATEPROGRAMPROC, CreateProgram);
+NULL_GL_ENTRY(PFNGLCREATESHADERPROC, CreateShader);
+NULL_GL_ENTRY(PFNGLDELETEBUFFERSPROC, DeleteBuffers);
+NULL_GL_ENTRY(PFNGLDELETEFRAMEBUFFERSPROC, DeleteFramebuffers);
+NULL_GL_ENTRY(PFNGLDELETEPROGRAMPROC, DeleteProgram);
+NULL_GL_ENTRY(PFNGLDELETERENDERBUFFERSPROC, DeleteRenderbuffers);
+NULL_GL_ENTRY(PFNGLDELETESHADERPROC, DeleteShader);
+NULL_GL_ENTRY(PFNGLDELETESYNCPROC, DeleteSync);
+NULL_GL_ENTRY(PFNGLDELETEVERTEXARRAYSPROC, DeleteVertexArrays);
+NULL_GL_ENTRY(PFNGLDISABLEVERTEXATTRIBARRAYPROC, DisableVertexAttribArray);
+NULL_GL_ENTRY(PFNGLDRAWBUFFERSPROC, DrawBuffers);
+NULL_GL_ENTRY(PFNGLDRAWELEMENTSINSTANCEDPROC, DrawElementsInstanced);
+NULL_GL_ENTRY(PFNGLENABLEVERTEXATTRIBARRAYPROC, EnableVertexAttribArray);
+NULL_GL_ENTRY(PFNGLFENCESYNCPROC, FenceSync);
+NULL_GL_ENTRY(PFNGLFRAMEBUFFERRENDERBUFFERPROC, FramebufferRenderbuffer);
+NULL_GL_ENTRY(PFNGLFRAMEBUFFERTEXTURE2DPROC, FramebufferTexture2D);
+NULL_GL_ENTRY(PFNGLGENBUFFERSPROC, GenBuffers);
+NULL_GL_ENTRY(PFNGLGENFRAMEBUFFERSPROC, GenFramebuffers);
+NULL_GL_ENTRY(PFNGLGENRENDERBUFFERSPROC, GenRenderbuffers);
+NULL_GL_ENTRY(PFNGLGENVERTEXARRAYSPROC, GenVertexArrays);
+NULL_GL_ENTRY(PFNGLGETACTIVEUNIFORMPROC, GetActiveUniform);
+NULL_GL_ENTRY(PFNGLGETATTRIBLOCATIONPROC, GetAttribLocation);
+NULL_GL_ENTRY(PFNGLGETPROGRAMINFOLOGPROC, GetProgramInfoLog);
+NULL_GL_ENTRY(PFNGLGETPROGRAMIVPROC, GetProgramiv);
+NULL_GL_ENTRY(PFNGLGETSHADERINFOLOGPROC, GetShaderInfoLog);
+NULL_GL_ENTRY(PFNGLGETSHADERIVPROC, GetShaderiv);
+NULL_GL_ENTRY(PFNGLGETUNIFORMBLOCKINDEXPROC, GetUniformBlockIndex);
+NULL_GL_ENTRY(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation);
+NULL_GL_ENTRY(PFNGLLINKPROGRAMPROC, LinkProgram);
+NULL_GL_ENTRY(PFNGLMAPBUFFERRANGEPROC, MapBufferRange);
+NULL_GL_ENTRY(PFNGLSHADERSOURCEPROC, ShaderSource);
+NULL_GL_ENTRY(PFNGLTEXBUFFERPROC, TexBuffer);
+NULL_GL_ENTRY(PFNGLTEXIMAGE2DMULTISAMPLEPROC, TexImage2DMultisample);
+NULL_GL_ENTRY(PFNGLUNIFORM1FPROC, Uniform1f);
+NULL_GL_ENTRY(PFNGLUNIFORM1IPROC, Uniform1i);
+NULL_GL_ENTRY(PFNGLUNIFORM1UIPROC, Uniform1ui);
+NULL_GL_ENTRY(PFNGLUNIFORM2FPROC, Uniform2f);
+NULL_GL_ENTRY(PFNGLUNIFORM3FPROC, Uniform3f);
+NULL_GL_ENTRY(PFNGLUNIFORM3FVPROC, Uniform3fv);
+NULL_GL_ENTRY(PFNGLUNIFORM3UIPROC, Uniform3ui);
+NULL_GL_ENTRY(PFNGLUNIFORM4FPROC, Uniform4f);
+NULL_GL_ENTRY(PFNGLUNIFORMBLOCKBINDINGPROC, UniformBlockBinding);
+NULL_GL_ENTRY(PFNGLUNIFORMMATRIX4FVPROC, UniformMatrix4fv);
+NULL_GL_ENTRY(PFNGLUNMAPBUFFERPROC, UnmapBuffer);
+NULL_GL_ENTRY(PFNGLUSEPROGRAMPROC, UseProgram);
+NULL_GL_ENTRY(PFNGLVERTEXATTRIB4FVPROC, VertexAttrib4fv);
+NULL_GL_ENTRY(PFNGLVERTEXATTRIBDIVISORPROC, VertexAttribDivisor);
+NULL_GL_ENTRY(PFNGLVERTEXATTRIBI1IPROC, VertexAttribI1i);
+NULL_GL_ENTRY(PFNGLVERTEXATTRIBIPOINTERPROC, VertexAttribIPointer);
+NULL_GL_ENTRY(PFNGLVERTEXATTRIBPOINTERPROC, VertexAttribPointer);
+
+// Extensions the recorder implements
+GLboolean __GLEW_ARB_buffer_storage = GL_TRUE;
+
+#endif
@@ -0,0 +1,82 @@
+#include "graphics/pose-cache.hpp"
+#include "graphics/job-fanout.hpp"
+#include <algorithm>
+
+namespace trillek {
+namespace graphics {
+
+const uint32_t PoseCache::STEPS_PER_FRAME;
+const uint32_t PoseCache::NO_POSE;
+
+void PoseCache::Clear() {
+    this->requests.clear();
+    this->request_poses.clear();
+}
+
+uint32_t PoseCache::Request(const AnimationClip &clip, size_t frame, float blend) {
+    PoseKey key;
+    key.clip = &clip;
+    key.clip_id = clip.GetId();
+    key.frame = static_cast<uint32_t>(frame);
+    key.step = static_cast<uint32_t>(std::max(0.0f, blend) * STEPS_PER_FRAME + 0.5f);
+    if(key.step >= STEPS_PER_FRAME) {
+        // rounded up to the next frame
+        key.frame = static_cast<uint32_t>((frame + 1) % std::max<size_t>(1, clip.GetFrameCount()));
+        key.step = 0;
+    }
+    const uint32_t request = static_cast<uint32_t>(this->requests.size());
+    this->requests.push_back(std::make_pair(key, request));
+    return request;
+}
+
+void PoseCache::Evaluate(size_t min_per_job) {
+    std::sort(this->requests.begin(), this->requests.end(),
+        [] (const std::pair<PoseKey, uint32_t> &a, const std::pair<PoseKey, uint32_t> &b) {
+            return a.first < b.first;
+        });
+    this->previous_poses.swap(this->poses);
+    this->previous_matrices.swap(this->matrices);
+    this->poses.clear();
+    this->request_poses.resize(this->requests.size());
+    this->copied_count = 0;
+    size_t matrix_count = 0;
+    size_t previous = 0;
+    for(size_t i = 0; i < this->requests.size(); i++) {
+        const PoseKey &key = this->requests[i].first;
+        if(i == 0 || key != this->requests[i - 1].first) {
+            Pose pose;
+            pose.key = key;
+            pose.first = matrix_count;
+            pose.bone_count = key.clip->GetBoneCount();
+            pose.source = NO_SOURCE;
+            // both lists are in key order
+            while(previous < this->previous_poses.size() && this->previous_poses[previous].key < key) {
+                previous++;
+            }
+            if(previous < this->previous_poses.size() && !(key != this->previous_poses[previous].key)) {
+                pose.source = this->previous_poses[previous].first;
+                this->copied_count++;
+            }
+            this->poses.push_back(pose);
+            matrix_count += pose.bone_count;
+        }
+        this->request_poses[this->requests[i].second] = static_cast<uint32_t>(this->poses.size() - 1);
+    }
+    this->matrices.resize(matrix_count);
+    JobFanout::ForRanges(this->poses.size(), min_per_job, [this] (size_t first, size_t last) {
+        for(size_t p = first; p < last; p++) {
+            const Pose &pose = this->poses[p];
+            glm::mat4 *out = this->matrices.data() + pose.first;
+            if(pose.source != NO_SOURCE) {
+                const glm::mat4 *source = this->previous_matrices.data() + pose.source;
+                std::copy(source, source + pose.bone_count, out);
+                continue;
+            }
+            const float blend = static_cast<float>(pose.key.step) / STEPS_PER_FRAME;
+            pose.key.clip->Sample(pose.key.frame, pose.key.frame + 1, blend, out);
+        }
+    });
+}
+
+} // namespace graphics
+} // namespace trillek
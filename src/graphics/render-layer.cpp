@@ -1,4 +1,5 @@
 #include "graphics/render-layer.hpp"
+#include "graphics/gl-state.hpp"
 #include "graphics/texture.hpp"
 #include "trillek-game.hpp"
 #include "systems/graphics.hpp"
@@ -361,12 +362,12 @@ void RenderAttachment::Generate(int width, int height, int samplecount) {
         }
     }
     GLint tex_target = (multisample_texture ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D);
-    glBindTexture(tex_target, texture->GetID());
+    GLState::BindTexture(tex_target, texture->GetID());
     CheckGLError();
     glTexParameteri(tex_target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(tex_target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     CheckGLError();
-    glBindTexture(tex_target, 0);
+    GLState::BindTexture(tex_target, 0);
 }
 
 void RenderAttachment::Destroy() {
@@ -378,7 +379,7 @@ void RenderAttachment::Destroy() {
 
 void RenderAttachment::BindTexture() {
     if(texture) {
-        glBindTexture((multisample_texture ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D), texture->GetID());
+        GLState::BindTexture((multisample_texture ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D), texture->GetID());
         CheckGLError();
     }
 }
@@ -392,23 +393,23 @@ void RenderAttachment::AttachToFBO() {
     else {
         if(multisample_texture) {
             if(texture) {
-                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture->GetID());
+                GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture->GetID());
                 CheckGLError();
                 glFramebufferTexture2D(GL_FRAMEBUFFER, this->GetAttach(),
                         GL_TEXTURE_2D_MULTISAMPLE, this->texture->GetID(), 0);
                 CheckGLError();
-                glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+                GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
                 CheckGLError();
             }
         }
         else {
             if(texture) {
-                glBindTexture(GL_TEXTURE_2D, texture->GetID());
+                GLState::BindTexture(GL_TEXTURE_2D, texture->GetID());
                 CheckGLError();
                 glFramebufferTexture2D(GL_FRAMEBUFFER, this->GetAttach(),
                         GL_TEXTURE_2D, this->texture->GetID(), 0);
                 CheckGLError();
-                glBindTexture(GL_TEXTURE_2D, 0);
+                GLState::BindTexture(GL_TEXTURE_2D, 0);
                 CheckGLError();
             }
         }
@@ -477,7 +478,7 @@ bool RenderLayer::SystemStart(const std::list<Property> &settings) {
         }
     }
     Generate();
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo_id); CheckGLError();
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, fbo_id); CheckGLError();
     int i = 0;
     drawcount = 0;
     clearbits = 0;
@@ -523,10 +524,10 @@ bool RenderLayer::SystemStart(const std::list<Property> &settings) {
     status = glCheckFramebufferStatus(GL_FRAMEBUFFER); CheckGLError();
     if(status != GL_FRAMEBUFFER_COMPLETE) {
         LOGMSGC(ERROR) << "Framebuffer: " << GetFramebufferStatusMessage(status);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
         return false;
     }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
     return true;
 }
 
@@ -545,17 +546,17 @@ void RenderLayer::Generate() {
 
 void RenderLayer::Destroy() {
     if(fbo_id) {
-        glDeleteFramebuffers(1, &fbo_id);
+        GLState::DeleteFramebuffers(1, &fbo_id);
         fbo_id = 0;
     }
 }
 
 void RenderLayer::BindToWrite() const {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id); CheckGLError();
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id); CheckGLError();
 }
 
 void RenderLayer::BindToRender() const {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id); CheckGLError();
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_id); CheckGLError();
     if(clearany) {
         GLuint attachcount = this->attachments.size();
         unsigned int i, primaryindex = 0;
@@ -580,7 +581,7 @@ void RenderLayer::BindToRender() const {
 }
 
 void RenderLayer::BindToRead() const {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_id); CheckGLError();
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, fbo_id); CheckGLError();
 }
 
 void RenderLayer::BindTextures() const {
@@ -588,21 +589,21 @@ void RenderLayer::BindTextures() const {
     for(unsigned int i = 0; i < attachcount; i++) {
         auto& attitr = this->attachments[i];
         if(attitr) {
-            glActiveTexture(GL_TEXTURE0 + i);
+            GLState::ActiveTexture(GL_TEXTURE0 + i);
             attitr->BindTexture();
         }
     }
 }
 
 void RenderLayer::UnbindFromRead() {
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0); CheckGLError();
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, 0); CheckGLError();
 }
 void RenderLayer::UnbindFromWrite() {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); CheckGLError();
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); CheckGLError();
 }
 void RenderLayer::UnbindFromAll() {
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); CheckGLError();
-    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0); CheckGLError();
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); CheckGLError();
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, 0); CheckGLError();
 }
 
 bool RenderLayer::Parse(const std::string &object_name, const rapidjson::Value& node) {
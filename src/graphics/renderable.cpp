@@ -10,11 +10,75 @@
 #include "graphics/shader.hpp"
 #include "graphics/animation.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
 #include <sstream>
 
 namespace trillek {
 namespace graphics {
 
+// the largest error of a simplified level, as a part of the bounding radius
+static const float MESH_LEVEL_MAX_ERROR = 0.1f;
+
+typedef std::weak_ptr<resource::MeshGroup> mesh_group_ref;
+
+// the level chains in use, by the control block of their mesh group
+static std::mutex level_chain_mutex;
+static std::map<mesh_group_ref, std::weak_ptr<const MeshLevelChain>, std::owner_less<mesh_group_ref>> level_chains;
+
+/**
+ * \brief Get the indices and levels of a mesh group, simplifying it the first time.
+ *
+ * \param const std::shared_ptr<resource::MeshGroup>& mesh_group the mesh group
+ * \param float radius the bounding radius of the mesh group
+ * \return std::shared_ptr<const MeshLevelChain> the chain, shared while in use
+ */
+static std::shared_ptr<const MeshLevelChain> GetLevelChain(const std::shared_ptr<resource::MeshGroup> &mesh_group,
+        float radius) {
+    std::lock_guard<std::mutex> lock(level_chain_mutex);
+    auto found = level_chains.find(mesh_group);
+    if (found != level_chains.end()) {
+        std::shared_ptr<const MeshLevelChain> chain = found->second.lock();
+        if (chain) {
+            return chain;
+        }
+    }
+    // forget the chains nobody draws anymore before adding one
+    for (auto itr = level_chains.begin(); itr != level_chains.end();) {
+        if (itr->second.expired()) {
+            itr = level_chains.erase(itr);
+        }
+        else {
+            ++itr;
+        }
+    }
+    auto chain = std::make_shared<MeshLevelChain>();
+    chain->indices = mesh_group->indicies;
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh_group->verts.size());
+    for (const auto& vert : mesh_group->verts) {
+        positions.push_back(vert.position);
+    }
+    const bool valid = std::all_of(chain->indices.begin(), chain->indices.end(),
+        [&positions] (unsigned int index) { return index < positions.size(); });
+    if (valid && std::isfinite(radius)) {
+        chain->levels = MeshSimplifier::BuildLevels(positions, chain->indices, radius * MESH_LEVEL_MAX_ERROR);
+    }
+    else {
+        // only the full mesh
+        MeshLevel full;
+        full.first_index = 0;
+        full.index_count = static_cast<unsigned int>(chain->indices.size());
+        full.error = 0.0f;
+        chain->levels.push_back(full);
+    }
+    level_chains[mesh_group] = chain;
+    return chain;
+}
+
 Renderable::Renderable() { }
 Renderable::~Renderable() { }
 
@@ -40,7 +104,7 @@ void Renderable::UpdateBufferGroups() {
         }
 
         std::weak_ptr<resource::MeshGroup> mesh_group = this->mesh->GetMeshGroup(i);
-        glBindVertexArray(buffer_group->vao); // Bind the VAO
+        GLState::BindVertexArray(buffer_group->vao); // Bind the VAO
         CheckGLError();
 
         auto temp_meshgroup = mesh_group.lock();
@@ -76,10 +140,28 @@ void Renderable::UpdateBufferGroups() {
             }
         }
 
+        buffer_group->bounds_min = glm::vec3(0.0f);
+        buffer_group->bounds_max = glm::vec3(0.0f);
+        buffer_group->bounding_sphere = glm::vec4(0.0f, 0.0f, 0.0f, std::numeric_limits<float>::infinity());
         if (temp_meshgroup) {
             if (temp_meshgroup->verts.size() > 0) {
+                // Box around the vertices, and the sphere centered on the box enclosing them.
+                glm::vec3 bounds_min = temp_meshgroup->verts[0].position;
+                glm::vec3 bounds_max = bounds_min;
+                for (const auto& vert : temp_meshgroup->verts) {
+                    bounds_min = glm::min(bounds_min, vert.position);
+                    bounds_max = glm::max(bounds_max, vert.position);
+                }
+                glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+                float radius = 0.0f;
+                for (const auto& vert : temp_meshgroup->verts) {
+                    radius = std::max(radius, glm::distance(center, vert.position));
+                }
+                buffer_group->bounds_min = bounds_min;
+                buffer_group->bounds_max = bounds_max;
+                buffer_group->bounding_sphere = glm::vec4(center, radius);
 
-                glBindBuffer(GL_ARRAY_BUFFER, buffer_group->vbo); // Bind the vertex buffer.
+                GLState::BindBuffer(GL_ARRAY_BUFFER, buffer_group->vbo); // Bind the vertex buffer.
                 CheckGLError();
                 glBufferData(GL_ARRAY_BUFFER, sizeof(resource::VertexData) * temp_meshgroup->verts.size(),
                     &temp_meshgroup->verts[0], GL_STATIC_DRAW); // Stores the verts in the vertex buffer.
@@ -124,14 +206,17 @@ void Renderable::UpdateBufferGroups() {
             }
 
             if (temp_meshgroup->indicies.size() > 0) {
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_group->ibo); // Bind the element buffer.
-                glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)* temp_meshgroup->indicies.size(),
-                    &temp_meshgroup->indicies[0], GL_STATIC_DRAW); // Store the faces in the element buffer.
-                buffer_group->ibo_count = temp_meshgroup->indicies.size();
+                // The full mesh and its simplified levels, one after the other.
+                buffer_group->level_chain = GetLevelChain(temp_meshgroup, buffer_group->bounding_sphere.w);
+                const std::vector<unsigned int>& indices = buffer_group->level_chain->indices;
+                GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer_group->ibo); // Bind the element buffer.
+                glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int)* indices.size(),
+                    &indices[0], GL_STATIC_DRAW); // Store the faces in the element buffer.
+                buffer_group->ibo_count = buffer_group->level_chain->levels[0].index_count;
             }
         }
 
-        glBindVertexArray(0); CheckGLError(); // Reset the buffer binding because we are good programmers.
+        GLState::BindVertexArray(0); CheckGLError(); // Reset the buffer binding because we are good programmers.
 
     }
 }
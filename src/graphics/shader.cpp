@@ -1,5 +1,9 @@
 #include "graphics/shader.hpp"
+#include "graphics/gl-state.hpp"
+#include "graphics/frame-data.hpp"
+#include "graphics/bone-palette.hpp"
 #include "resources/text-file.hpp"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include "logging.hpp"
@@ -9,6 +13,7 @@ namespace graphics {
 
 Shader::Shader() {
     program = 0;
+    link_id = 0;
 }
 
 Shader::~Shader() {
@@ -17,6 +22,7 @@ Shader::~Shader() {
 
 std::once_flag Shader::types_once;
 std::map<std::string, ShaderType> Shader::shaderclass;
+std::atomic<uint32_t> Shader::next_link_id(1);
 
 void Shader::InitializeTypes() {
     std::call_once(Shader::types_once,
@@ -40,6 +46,10 @@ void Shader::DeleteProgram() {
     }
     shaders.clear();
     program = 0;
+    link_id = 0;
+    uniform_table.clear();
+    uniforms_list.clear();
+    attributes_list.clear();
 }
 
 bool Shader::SystemStart(const std::list<Property> &) {
@@ -109,22 +119,64 @@ bool Shader::LinkProgram() {
         glDeleteShader(shaderid_itr);
     }
     shaders.clear();
+    this->attributes_list.clear();
+    if(linkok) {
+        GLuint block_index = glGetUniformBlockIndex(program, FRAME_DATA_BLOCK);
+        if(block_index != GL_INVALID_INDEX) {
+            glUniformBlockBinding(program, block_index, FRAME_DATA_BINDING);
+            CheckGLError();
+        }
+        ReflectUniforms();
+        this->link_id = next_link_id++;
+    }
+    else {
+        this->uniform_table.clear();
+        this->uniforms_list.clear();
+        this->link_id = 0;
+    }
     return linkok;
 }
 
+void Shader::ReflectUniforms() {
+    this->uniform_table.clear();
+    this->uniforms_list.clear();
+    GLint count = 0;
+    GLint max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::vector<GLchar> name_buffer(std::max(max_length, 1));
+    for(GLint i = 0; i < count; i++) {
+        UniformInfo info;
+        GLsizei length = 0;
+        glGetActiveUniform(program, i, static_cast<GLsizei>(name_buffer.size()), &length, &info.size, &info.type, name_buffer.data());
+        info.name.assign(name_buffer.data(), length);
+        info.location = glGetUniformLocation(program, info.name.c_str());
+        if(info.location < 0) {
+            continue; // members of uniform blocks have no location
+        }
+        this->uniforms_list[info.name] = info.location;
+        // arrays are listed as their first element, also look them up by name
+        if(info.name.size() > 3 && info.name.compare(info.name.size() - 3, 3, "[0]") == 0) {
+            this->uniforms_list[info.name.substr(0, info.name.size() - 3)] = info.location;
+        }
+        this->uniform_table.push_back(std::move(info));
+    }
+    CheckGLError();
+}
+
 void Shader::Use() {
-    glUseProgram(program);
+    GLState::UseProgram(program);
 }
 
 void Shader::UnUse() {
-    glUseProgram(0);
+    GLState::UseProgram(0);
 }
 
 GLint Shader::Attribute(const std::string & attribute) {
     auto attrib = attributes_list.find(attribute);
     if(attrib == attributes_list.end()) {
         GLint attrib_id = glGetAttribLocation(program, attribute.c_str());
-        if(attrib_id) {
+        if(this->link_id) {
             attributes_list[attribute] = attrib_id;
         }
         return attrib_id;
@@ -135,38 +187,21 @@ GLint Shader::Attribute(const std::string & attribute) {
 GLint Shader::Uniform(const std::string & uniform) {
     auto uniform_itr = uniforms_list.find(uniform);
     if(uniform_itr == uniforms_list.end()) {
-        GLint uniform_id = glGetUniformLocation(program, uniform.c_str());
-        if(uniform_id) {
-            uniforms_list[uniform] = uniform_id;
+        if(this->link_id) {
+            return -1; // every active uniform was reflected at link
         }
-        return uniform_id;
+        return glGetUniformLocation(program, uniform.c_str());
     }
     return uniform_itr->second;
 }
 
 //An indexer that returns the location of the attribute
 GLint Shader::operator [](const std::string & attribute) {
-    auto attrib = attributes_list.find(attribute);
-    if(attrib == attributes_list.end()) {
-        GLint attrib_id = glGetAttribLocation(program, attribute.c_str());
-        if(attrib_id) {
-            attributes_list[attribute] = attrib_id;
-        }
-        return attrib_id;
-    }
-    return attrib->second;
+    return Attribute(attribute);
 }
 
 GLint Shader::operator()(const std::string &uniform) {
-    auto uniform_itr = uniforms_list.find(uniform);
-    if(uniform_itr == uniforms_list.end()) {
-        GLint uniform_id = glGetUniformLocation(program, uniform.c_str());
-        if(uniform_id) {
-            uniforms_list[uniform] = uniform_id;
-        }
-        return uniform_id;
-    }
-    return uniform_itr->second;
+    return Uniform(uniform);
 }
 GLuint Shader::GetProgram() {
     return program;
@@ -202,6 +237,14 @@ bool Shader::Parse(const std::string &shader_name, const rapidjson::Value& node)
         LOGMSGC(WARNING) << "Invalid shader entry";
         return false;
     }
+    // shaders opt into the shared per frame data, declared before their own source
+    if(node.HasMember("frame-data") && node["frame-data"].IsBool() && node["frame-data"].GetBool()) {
+        globdefines = FRAME_DATA_SOURCE;
+    }
+    // and into the bone palettes of the animated meshes
+    if(node.HasMember("bone-palettes") && node["bone-palettes"].IsBool() && node["bone-palettes"].GetBool()) {
+        globdefines += BONE_PALETTE_SOURCE;
+    }
     for(auto shade_param_itr = node.MemberBegin();
             shade_param_itr != node.MemberEnd(); shade_param_itr++) {
         std::string param_name(shade_param_itr->name.GetString(), shade_param_itr->name.GetStringLength());
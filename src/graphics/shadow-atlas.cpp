@@ -0,0 +1,91 @@
+#include "graphics/shadow-atlas.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace trillek {
+namespace graphics {
+
+const uint32_t ShadowAtlas::MAX_LEVEL;
+
+// Keep the even bits of a Z order index.
+static uint32_t CompactBits(uint32_t value) {
+    value &= 0x55555555;
+    value = (value | (value >> 1)) & 0x33333333;
+    value = (value | (value >> 2)) & 0x0f0f0f0f;
+    value = (value | (value >> 4)) & 0x00ff00ff;
+    value = (value | (value >> 8)) & 0x0000ffff;
+    return value;
+}
+
+void ShadowAtlas::Allocate(const std::vector<float> &importance, std::vector<glm::vec4> &tiles) {
+    const size_t count = importance.size();
+    tiles.assign(count, glm::vec4(0.0f));
+    if(count == 0) {
+        return;
+    }
+
+    // most important first
+    std::vector<uint32_t> order(count);
+    for(uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&importance] (uint32_t a, uint32_t b) {
+        return importance[a] > importance[b];
+    });
+
+    // Requested levels, never larger than the tile of a more important light.
+    std::vector<uint32_t> levels(count);
+    for(size_t i = 0; i < count; i++) {
+        float value = importance[order[i]];
+        uint32_t level = MAX_LEVEL;
+        if(value > 0.0f) {
+            level = static_cast<uint32_t>(std::max(0.0f, std::floor(-std::log2(std::min(value, 1.0f)))));
+            level = std::min(level, MAX_LEVEL);
+        }
+        levels[i] = i > 0 ? std::max(level, levels[i - 1]) : level;
+    }
+
+    // Area in tiles of the smallest level.
+    const uint64_t capacity = 1ull << (2 * MAX_LEVEL);
+    auto area = [] (uint32_t level) { return 1ull << (2 * (MAX_LEVEL - level)); };
+    for(;;) {
+        uint64_t total = 0;
+        for(uint32_t level : levels) {
+            total += area(level);
+        }
+        if(total <= capacity || levels[0] == MAX_LEVEL) {
+            break;
+        }
+        // shrink the largest tiles
+        const uint32_t largest = levels[0];
+        for(size_t i = 0; i < count && levels[i] == largest; i++) {
+            levels[i]++;
+        }
+    }
+
+    // Hand out the tiles in Z order, sorted by size they stay aligned.
+    uint64_t position = 0;
+    const float cell = 1.0f / (1u << MAX_LEVEL);
+    for(size_t i = 0; i < count; i++) {
+        if(position + area(levels[i]) > capacity) {
+            break;
+        }
+        float x = CompactBits(static_cast<uint32_t>(position)) * cell;
+        float y = CompactBits(static_cast<uint32_t>(position >> 1)) * cell;
+        tiles[order[i]] = glm::vec4(x, y, 1.0f / (1u << levels[i]), 0.0f);
+        position += area(levels[i]);
+    }
+}
+
+glm::mat4 ShadowAtlas::GetTileMatrix(const glm::vec4 &tile) {
+    // clip x in [-w, w] maps to [(2 * x - 1) * w, (2 * (x + side) - 1) * w]
+    glm::mat4 matrix(1.0f);
+    matrix[0][0] = tile.z;
+    matrix[1][1] = tile.z;
+    matrix[3][0] = 2.0f * tile.x + tile.z - 1.0f;
+    matrix[3][1] = 2.0f * tile.y + tile.z - 1.0f;
+    return matrix;
+}
+
+} // namespace graphics
+} // namespace trillek
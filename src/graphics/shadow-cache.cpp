@@ -0,0 +1,55 @@
+#include "graphics/shadow-cache.hpp"
+#include "graphics/gl-state.hpp"
+#include "logging.hpp"
+
+namespace trillek {
+namespace graphics {
+
+ShadowCache::ShadowCache() : fbo_id(0), width(0), height(0), generation(0), complete(false) { }
+
+ShadowCache::~ShadowCache() {
+    if(this->fbo_id) {
+        GLState::DeleteFramebuffers(1, &this->fbo_id);
+    }
+}
+
+bool ShadowCache::Resize(GLsizei width, GLsizei height) {
+    if(this->fbo_id && width == this->width && height == this->height) {
+        return this->complete;
+    }
+    if(!this->fbo_id) {
+        glGenFramebuffers(1, &this->fbo_id); CheckGLError();
+    }
+    this->width = width;
+    this->height = height;
+    this->generation++;
+    // same format as the depth attachments of the render layers, so it can be blitted
+    this->depth.GenerateDepth(width, height, false);
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, this->fbo_id);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depth.GetID(), 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    CheckGLError();
+    GLuint status = glCheckFramebufferStatus(GL_FRAMEBUFFER); CheckGLError();
+    GLState::BindFramebuffer(GL_FRAMEBUFFER, 0);
+    this->complete = status == GL_FRAMEBUFFER_COMPLETE;
+    if(!this->complete) {
+        LOGMSGC(ERROR) << "Shadow cache framebuffer is not complete: " << status;
+    }
+    return this->complete;
+}
+
+void ShadowCache::BindToRender() const {
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, this->fbo_id); CheckGLError();
+}
+
+void ShadowCache::CopyTo(GLuint draw_fbo, const GLint *rect) const {
+    GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, this->fbo_id);
+    GLState::BindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_fbo);
+    glBlitFramebuffer(rect[0], rect[1], rect[0] + rect[2], rect[1] + rect[3],
+        rect[0], rect[1], rect[0] + rect[2], rect[1] + rect[3], GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    CheckGLError();
+}
+
+} // namespace graphics
+} // namespace trillek
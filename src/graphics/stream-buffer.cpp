@@ -0,0 +1,158 @@
+#include "graphics/stream-buffer.hpp"
+#include "graphics/gl-state.hpp"
+#include <algorithm>
+
+namespace trillek {
+namespace graphics {
+
+// regions start on this boundary, enough for uniform buffer offsets
+static const size_t REGION_ALIGNMENT = 256;
+
+// how long a wait on a fence lasts before the commands are flushed again
+static const GLuint64 FENCE_WAIT_NS = 1000000;
+
+static bool HasBufferStorage() {
+#ifndef __APPLE__
+    return GLEW_ARB_buffer_storage != 0;
+#else
+    return false;
+#endif
+}
+
+StreamBuffer::StreamBuffer() : target(GL_ARRAY_BUFFER), buffer(0), frame_size(0), frame(0),
+    mapped(nullptr), used(0), stalls(0) {
+    std::fill(this->fences, this->fences + FRAMES, nullptr);
+}
+
+StreamBuffer::~StreamBuffer() {
+    Destroy();
+}
+
+void StreamBuffer::Destroy() {
+    for(auto &fence : this->fences) {
+        if(fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if(this->mapped) {
+        GLState::BindBuffer(this->target, this->buffer);
+        glUnmapBuffer(this->target);
+        GLState::BindBuffer(this->target, 0);
+        this->mapped = nullptr;
+    }
+    if(this->buffer) {
+        GLState::DeleteBuffers(1, &this->buffer);
+        this->buffer = 0;
+    }
+    this->staging.clear();
+}
+
+bool StreamBuffer::Create(GLenum target, size_t frame_size) {
+    Destroy();
+    this->target = target;
+    this->frame_size = (std::max<size_t>(frame_size, 1) + REGION_ALIGNMENT - 1) & ~(REGION_ALIGNMENT - 1);
+    this->frame = 0;
+    this->used = 0;
+    glGenBuffers(1, &this->buffer);
+    GLState::BindBuffer(target, this->buffer);
+    if(HasBufferStorage()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr total = static_cast<GLsizeiptr>(this->frame_size * FRAMES);
+        glBufferStorage(target, total, nullptr, flags);
+        this->mapped = static_cast<char*>(glMapBufferRange(target, 0, total, flags));
+        if(!this->mapped) {
+            // immutable storage can't be respecified, start again with a plain buffer
+            GLState::BindBuffer(target, 0);
+            GLState::DeleteBuffers(1, &this->buffer);
+            glGenBuffers(1, &this->buffer);
+            GLState::BindBuffer(target, this->buffer);
+        }
+    }
+    if(!this->mapped) {
+        glBufferData(target, static_cast<GLsizeiptr>(this->frame_size), nullptr, GL_STREAM_DRAW);
+        this->staging.resize(this->frame_size);
+    }
+    GLState::BindBuffer(target, 0);
+    return this->mapped != nullptr;
+}
+
+void StreamBuffer::Reserve(size_t size) {
+    if(size <= this->frame_size) {
+        return;
+    }
+    // the regions may still be read, wait for all of them before the storage goes
+    for(auto &fence : this->fences) {
+        if(fence) {
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        }
+    }
+    Create(this->target, std::max(size, this->frame_size * 2));
+}
+
+void StreamBuffer::BeginFrame() {
+    this->frame = (this->frame + 1) % FRAMES;
+    this->used.store(0, std::memory_order_relaxed);
+    GLsync &fence = this->fences[this->frame];
+    if(!fence) {
+        return;
+    }
+    GLenum result = glClientWaitSync(fence, 0, 0);
+    if(result == GL_TIMEOUT_EXPIRED) {
+        this->stalls++;
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+        } while(result == GL_TIMEOUT_EXPIRED);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+StreamBuffer::Range StreamBuffer::Allocate(size_t size, size_t alignment) {
+    Range range;
+    size_t first = this->used.load(std::memory_order_relaxed);
+    size_t start;
+    do {
+        start = (first + alignment - 1) & ~(alignment - 1);
+        if(start + size > this->frame_size) {
+            return range;
+        }
+    } while(!this->used.compare_exchange_weak(first, start + size, std::memory_order_relaxed));
+    if(this->mapped) {
+        const size_t base = this->frame * this->frame_size;
+        range.data = this->mapped + base + start;
+        range.offset = static_cast<GLintptr>(base + start);
+    }
+    else {
+        range.data = this->staging.data() + start;
+        range.offset = static_cast<GLintptr>(start);
+    }
+    range.size = static_cast<GLsizeiptr>(size);
+    return range;
+}
+
+void StreamBuffer::Commit() const {
+    const size_t size = this->used.load(std::memory_order_acquire);
+    if(this->mapped || !size) {
+        return; // coherent mapping, the writes are seen by the next commands
+    }
+    GLState::BindBuffer(this->target, this->buffer);
+    // orphan the storage the previous frames may still read from
+    glBufferData(this->target, static_cast<GLsizeiptr>(this->frame_size), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(this->target, 0, static_cast<GLsizeiptr>(size), this->staging.data());
+    GLState::BindBuffer(this->target, 0);
+}
+
+void StreamBuffer::EndFrame() {
+    if(!this->mapped) {
+        return;
+    }
+    GLsync &fence = this->fences[this->frame];
+    if(fence) {
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+} // namespace graphics
+} // namespace trillek
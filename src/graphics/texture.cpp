@@ -1,4 +1,5 @@
 #include "graphics/texture.hpp"
+#include "graphics/gl-state.hpp"
 #include "resources/pixel-buffer.hpp"
 #include <memory>
 
@@ -45,7 +46,7 @@ Texture& Texture::operator=(Texture && other) {
 
 void Texture::Destroy() {
     if(texture_id) {
-        glDeleteTextures(1, &texture_id);
+        GLState::DeleteTextures(1, &texture_id);
     }
 }
 
@@ -87,14 +88,14 @@ void Texture::Load(const resource::PixelBuffer & image) {
             }
         }
     }
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D, texture_id);
     CheckGLError();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magfilter);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     CheckGLError();
     glTexImage2D(GL_TEXTURE_2D, 0, gformat, image.Width(), image.Height(), 0, gformat, GL_UNSIGNED_BYTE, pixdata);
     CheckGLError();
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
 }
 void Texture::Load(const uint8_t * image, GLuint width, GLuint height) {
     CheckGLError();
@@ -119,7 +120,7 @@ void Texture::Load(const uint8_t * image, GLuint width, GLuint height) {
     default:
         return;
     }
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D, texture_id);
     CheckGLError();
     glTexImage2D(GL_TEXTURE_2D, 0, gformat, width, height, 0, gformat, GL_UNSIGNED_BYTE, image);
 }
@@ -128,7 +129,7 @@ void Texture::Generate(GLuint width, GLuint height, bool usealpha) {
     if(!texture_id) {
         glGenTextures(1, &texture_id);
     }
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D, texture_id);
     CheckGLError();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -141,7 +142,7 @@ void Texture::Generate(GLuint width, GLuint height, bool usealpha) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
         CheckGLError();
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::GenerateStencil(GLuint width, GLuint height) {
@@ -149,7 +150,7 @@ void Texture::GenerateStencil(GLuint width, GLuint height) {
     if(!texture_id) {
         glGenTextures(1, &texture_id);
     }
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D, texture_id);
     CheckGLError();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -158,7 +159,7 @@ void Texture::GenerateStencil(GLuint width, GLuint height) {
     glTexImage2D(GL_TEXTURE_2D, 0, GL_STENCIL_INDEX, width, height, 0, GL_STENCIL_INDEX, GL_UNSIGNED_BYTE, nullptr);
     CheckGLError();
 
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::GenerateDepth(GLuint width, GLuint height, bool stencil) {
@@ -166,7 +167,7 @@ void Texture::GenerateDepth(GLuint width, GLuint height, bool stencil) {
     if(!texture_id) {
         glGenTextures(1, &texture_id);
     }
-    glBindTexture(GL_TEXTURE_2D, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D, texture_id);
     CheckGLError();
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
@@ -184,38 +185,38 @@ void Texture::GenerateDepth(GLuint width, GLuint height, bool stencil) {
         glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_BYTE, nullptr);
         CheckGLError();
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState::BindTexture(GL_TEXTURE_2D, 0);
 }
 
 void Texture::GenerateMultisample(GLuint width, GLuint height, GLuint samples) {
     if(!texture_id) {
         glGenTextures(1, &texture_id);
     }
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture_id);
     CheckGLError();
     glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_RGBA, width, height, GL_FALSE);
     CheckGLError();
 
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
 }
 
 void Texture::GenerateMultisampleStencil(GLuint width, GLuint height, GLuint samples) {
     if(!texture_id) {
         glGenTextures(1, &texture_id);
     }
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture_id);
     CheckGLError();
     glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_STENCIL_INDEX, width, height, GL_FALSE);
     CheckGLError();
 
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
 }
 
 void Texture::GenerateMultisampleDepth(GLuint width, GLuint height, GLuint samples, bool stencil) {
     if(!texture_id) {
         glGenTextures(1, &texture_id);
     }
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture_id);
+    GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture_id);
     CheckGLError();
     if(stencil) {
         glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_DEPTH_STENCIL, width, height, GL_FALSE);
@@ -225,7 +226,7 @@ void Texture::GenerateMultisampleDepth(GLuint width, GLuint height, GLuint sampl
         glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, samples, GL_DEPTH_COMPONENT, width, height, GL_FALSE);
         CheckGLError();
     }
-    glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
+    GLState::BindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);
 }
 
 } // graphics
@@ -0,0 +1,124 @@
+#include "graphics/transform-batch.hpp"
+#include "graphics/job-fanout.hpp"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TRILLEK_TRANSFORM_SSE
+#endif
+
+namespace trillek {
+namespace graphics {
+
+void TransformBatch::Add(const glm::vec3 &translation, const glm::quat &orientation,
+        const glm::vec3 &scale, uint32_t target) {
+    this->tx.push_back(translation.x);
+    this->ty.push_back(translation.y);
+    this->tz.push_back(translation.z);
+    this->qx.push_back(orientation.x);
+    this->qy.push_back(orientation.y);
+    this->qz.push_back(orientation.z);
+    this->qw.push_back(orientation.w);
+    this->sx.push_back(scale.x);
+    this->sy.push_back(scale.y);
+    this->sz.push_back(scale.z);
+    this->targets.push_back(target);
+}
+
+void TransformBatch::Clear() {
+    this->tx.clear(); this->ty.clear(); this->tz.clear();
+    this->qx.clear(); this->qy.clear(); this->qz.clear(); this->qw.clear();
+    this->sx.clear(); this->sy.clear(); this->sz.clear();
+    this->targets.clear();
+}
+
+void TransformBatch::Reserve(size_t count) {
+    this->tx.reserve(count); this->ty.reserve(count); this->tz.reserve(count);
+    this->qx.reserve(count); this->qy.reserve(count); this->qz.reserve(count); this->qw.reserve(count);
+    this->sx.reserve(count); this->sy.reserve(count); this->sz.reserve(count);
+    this->targets.reserve(count);
+}
+
+void TransformBatch::ComposeScalar(glm::mat4 *out, size_t i) const {
+    // same terms as glm::mat4_cast
+    const float x = this->qx[i], y = this->qy[i], z = this->qz[i], w = this->qw[i];
+    const float xx = x * x, yy = y * y, zz = z * z;
+    const float xy = x * y, xz = x * z, yz = y * z;
+    const float wx = w * x, wy = w * y, wz = w * z;
+    const float s0 = this->sx[i], s1 = this->sy[i], s2 = this->sz[i];
+    glm::mat4 &m = out[this->targets[i]];
+    m[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * s0, 2.0f * (xy + wz) * s0, 2.0f * (xz - wy) * s0, 0.0f);
+    m[1] = glm::vec4(2.0f * (xy - wz) * s1, (1.0f - 2.0f * (xx + zz)) * s1, 2.0f * (yz + wx) * s1, 0.0f);
+    m[2] = glm::vec4(2.0f * (xz + wy) * s2, 2.0f * (yz - wx) * s2, (1.0f - 2.0f * (xx + yy)) * s2, 0.0f);
+    m[3] = glm::vec4(this->tx[i], this->ty[i], this->tz[i], 1.0f);
+}
+
+void TransformBatch::Compose(glm::mat4 *out, size_t first, size_t count) const {
+    const size_t end = std::min(first + count, this->Size());
+    size_t i = first;
+#ifdef TRILLEK_TRANSFORM_SSE
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    for(; i + 4 <= end; i += 4) {
+        // each register holds one term of 4 transforms
+        const __m128 x = _mm_loadu_ps(&this->qx[i]);
+        const __m128 y = _mm_loadu_ps(&this->qy[i]);
+        const __m128 z = _mm_loadu_ps(&this->qz[i]);
+        const __m128 w = _mm_loadu_ps(&this->qw[i]);
+        const __m128 x2 = _mm_add_ps(x, x);
+        const __m128 y2 = _mm_add_ps(y, y);
+        const __m128 z2 = _mm_add_ps(z, z);
+        const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+        const __m128 s0 = _mm_loadu_ps(&this->sx[i]);
+        const __m128 s1 = _mm_loadu_ps(&this->sy[i]);
+        const __m128 s2 = _mm_loadu_ps(&this->sz[i]);
+
+        __m128 rows[4][4];
+        rows[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), s0);
+        rows[0][1] = _mm_mul_ps(_mm_add_ps(xy, wz), s0);
+        rows[0][2] = _mm_mul_ps(_mm_sub_ps(xz, wy), s0);
+        rows[0][3] = zero;
+        rows[1][0] = _mm_mul_ps(_mm_sub_ps(xy, wz), s1);
+        rows[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), s1);
+        rows[1][2] = _mm_mul_ps(_mm_add_ps(yz, wx), s1);
+        rows[1][3] = zero;
+        rows[2][0] = _mm_mul_ps(_mm_add_ps(xz, wy), s2);
+        rows[2][1] = _mm_mul_ps(_mm_sub_ps(yz, wx), s2);
+        rows[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), s2);
+        rows[2][3] = zero;
+        rows[3][0] = _mm_loadu_ps(&this->tx[i]);
+        rows[3][1] = _mm_loadu_ps(&this->ty[i]);
+        rows[3][2] = _mm_loadu_ps(&this->tz[i]);
+        rows[3][3] = one;
+
+        glm::mat4 *m0 = &out[this->targets[i]];
+        glm::mat4 *m1 = &out[this->targets[i + 1]];
+        glm::mat4 *m2 = &out[this->targets[i + 2]];
+        glm::mat4 *m3 = &out[this->targets[i + 3]];
+        for(unsigned int c = 0; c < 4; c++) {
+            // turn the 4 terms of a column into the column of each matrix
+            _MM_TRANSPOSE4_PS(rows[c][0], rows[c][1], rows[c][2], rows[c][3]);
+            _mm_storeu_ps(&(*m0)[c][0], rows[c][0]);
+            _mm_storeu_ps(&(*m1)[c][0], rows[c][1]);
+            _mm_storeu_ps(&(*m2)[c][0], rows[c][2]);
+            _mm_storeu_ps(&(*m3)[c][0], rows[c][3]);
+        }
+    }
+#endif
+    for(; i < end; i++) {
+        ComposeScalar(out, i);
+    }
+}
+
+void TransformBatch::ComposeAll(glm::mat4 *out, size_t min_per_job) const {
+    // split on groups of 4 so only the last part has a scalar tail
+    const size_t group_count = (this->Size() + 3) / 4;
+    JobFanout::ForRanges(group_count, (min_per_job + 3) / 4, [this, out] (size_t first, size_t last) {
+        Compose(out, first * 4, (last - first) * 4);
+    });
+}
+
+} // namespace graphics
+} // namespace trillek
@@ -15,8 +15,19 @@ extern "C" id objc_msgSend(id self, SEL op, ...);
 extern "C" SEL sel_getUid(const char *str);
 #endif
 
+#ifdef TRILLEK_HEADLESS_GL
+#include <atomic>
+#include <thread>
+#endif
+
 namespace trillek {
 
+#ifdef TRILLEK_HEADLESS_GL
+// Without a window, the close request and the clock are kept here.
+static std::atomic<bool> headless_closing(false);
+static const std::chrono::steady_clock::time_point headless_epoch = std::chrono::steady_clock::now();
+#endif
+
 // Error helper function used by GLFW for error messaging.
 // Currently outputs to std::cout.
 static void ErrorCallback(int error, const char* description) {
@@ -25,6 +36,15 @@ static void ErrorCallback(int error, const char* description) {
 
 bool OS::InitializeWindow(const int width, const int height, const std::string title,
     const unsigned int glMajor /*= 3*/, const unsigned int glMinor /*= 2*/) {
+#ifdef TRILLEK_HEADLESS_GL
+    // the null GL backend needs no window nor context
+    this->window = nullptr;
+    this->client_width = width;
+    this->client_height = height;
+    this->old_mouse_x = 0;
+    this->old_mouse_y = 0;
+    return true;
+#endif
     glfwSetErrorCallback(ErrorCallback);
 
     // Initialize the library.
@@ -131,31 +151,52 @@ bool OS::InitializeWindow(const int width, const int height, const std::string t
 }
 
 void OS::MakeCurrent() {
+#ifndef TRILLEK_HEADLESS_GL
     glfwMakeContextCurrent(this->window);
+#endif
 }
 
 void OS::DetachContext() {
+#ifndef TRILLEK_HEADLESS_GL
     glfwMakeContextCurrent(NULL);
+#endif
 }
 
 void OS::Terminate() {
+#ifndef TRILLEK_HEADLESS_GL
     glfwTerminate();
+#endif
 }
 
 void OS::SetWindowShouldClose() {
+#ifdef TRILLEK_HEADLESS_GL
+    headless_closing = true;
+#else
     glfwSetWindowShouldClose(this->window, GL_TRUE);
+#endif
 }
 
 bool OS::Closing() {
+#ifdef TRILLEK_HEADLESS_GL
+    return headless_closing;
+#else
     return glfwWindowShouldClose(this->window) > 0;
+#endif
 }
 
 void OS::SwapBuffers() {
+#ifndef TRILLEK_HEADLESS_GL
     glfwSwapBuffers(this->window);
+#endif
 }
 
 void OS::OSMessageLoop() {
+#ifdef TRILLEK_HEADLESS_GL
+    // no events to wait for
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+#else
     glfwWaitEvents();
+#endif
 }
 
 int OS::GetWindowWidth() {
@@ -167,7 +208,11 @@ int OS::GetWindowHeight() {
 }
 
 std::chrono::nanoseconds OS::GetTime() {
+#ifdef TRILLEK_HEADLESS_GL
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - headless_epoch);
+#else
     return std::chrono::nanoseconds(static_cast<int64_t>(glfwGetTime() * 1.0E9));
+#endif
 }
 
 void OS::windowResized(GLFWwindow* window, int width, int height) {
@@ -267,7 +312,9 @@ void OS::DispatchMouseMoveEvent(const double x, const double y) {
     if (this->mouse_lock) {
         this->old_mouse_x = this->client_width / 2;
         this->old_mouse_y = this->client_height / 2;
+#ifndef TRILLEK_HEADLESS_GL
         glfwSetCursorPos(this->window, this->old_mouse_x, this->old_mouse_y);
+#endif
     }
     else {
         this->old_mouse_x = x;
@@ -298,16 +345,20 @@ void OS::DispatchMouseButtonEvent(const int button, const int action, const int
 
 void OS::ToggleMouseLock() {
     this->mouse_lock = !this->mouse_lock;
+#ifndef TRILLEK_HEADLESS_GL
     if (this->mouse_lock) {
         glfwSetInputMode(this->window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     }
     else {
         glfwSetInputMode(this->window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
+#endif
 }
 
 void OS::SetMousePosition(double x, double y) {
+#ifndef TRILLEK_HEADLESS_GL
     glfwSetCursorPos(this->window, x, y);
+#endif
 }
 
 } // End of trillek
@@ -14,14 +14,39 @@
 #include "graphics/animation.hpp"
 #include "graphics/light.hpp"
 #include "graphics/render-list.hpp"
+#include "graphics/job-fanout.hpp"
 #include "logging.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 namespace trillek {
 namespace graphics {
 
-RenderSystem::RenderSystem() : Parser("graphics") {
+static const float VIEW_NEAR_PLANE = 0.1f;
+// far plane of the view projection, also the range of the draw packet depths
+static const float VIEW_FAR_PLANE = 10000.0f;
+// bytes per frame the instance stream starts with, it grows when a frame needs more
+static const size_t INSTANCE_STREAM_SIZE = 4096 * sizeof(glm::mat4);
+
+// bone matrices per frame the palette buffer starts with
+static const size_t BONE_PALETTE_MATRICES = 4096;
+
+/**
+ * \brief The box of a light in the light index, around the sphere it reaches.
+ */
+static AABB GetLightBounds(float radius) {
+    const glm::vec3 extent(std::max(radius, 0.0f));
+    return AABB(-extent, extent);
+}
+
+RenderSystem::RenderSystem() : Parser("graphics"), draw_frame(this->model_matrices) {
     multisample = false;
     this->frame_drop = false;
+    this->instancing = false;
+    this->clustered_lighting = false;
+    this->start_time = 0;
+    this->pipelined_frames = false;
     Shader::InitializeTypes();
 }
 
@@ -34,6 +59,7 @@ const int* RenderSystem::Start(const unsigned int width, const unsigned int heig
     std::string glver_string((char*)glGetString(GL_VERSION));
     //glGetIntegerv(GL_SHADING_LANGUAGE_VERSION, &this->gl_version[3]);
     CheckGLError();
+    GLState::Invalidate();
     int opengl_version = gl_version[0] * 100 + gl_version[1] * 10;
     debugmode = 0;
 
@@ -53,6 +79,35 @@ const int* RenderSystem::Start(const unsigned int width, const unsigned int heig
     else {
         LOGMSGC(INFO) << "OpenGL context (" << opengl_version << ')';
     }
+    // instanced arrays are core in 3.3
+    this->instancing = opengl_version >= 330;
+    if(this->instancing) {
+        bool persistent = this->draw_frame.GetInstanceStream().Create(GL_ARRAY_BUFFER, INSTANCE_STREAM_SIZE);
+        LOGMSGC(INFO) << "Instance stream " << (persistent ? "persistently mapped" : "uploaded by orphaning");
+    }
+    this->shadow_cache.reset(new ShadowCache());
+    // uniform buffers are core in 3.1
+    if(opengl_version >= 310) {
+        this->frame_buffer.Create();
+    }
+    this->start_time = TrillekGame::GetOS().GetTime().count();
+    // buffer textures are core in 3.1
+    if(opengl_version >= 310) {
+        bool persistent = this->draw_frame.GetBonePalettes().Create(BONE_PALETTE_MATRICES);
+        LOGMSGC(INFO) << "Bone palettes " << (persistent ? "persistently mapped" : "uploaded by orphaning");
+    }
+    else {
+        LOGMSGC(WARNING) << "Bone palettes need OpenGL 3.1, animated meshes keep their bind pose";
+    }
+    if(this->clustered_lighting) {
+        if(opengl_version >= 310) {
+            this->light_grid.CreateBuffers();
+        }
+        else {
+            LOGMSGC(WARNING) << "Clustered lighting needs OpenGL 3.1, using per-light lighting";
+            this->clustered_lighting = false;
+        }
+    }
 
     SetViewportSize(width, height);
 
@@ -104,9 +159,9 @@ const int* RenderSystem::Start(const unsigned int width, const unsigned int heig
     glGenBuffers(1, &screenquad.vbo); // Generate the vertex buffer.
     glGenBuffers(1, &screenquad.ibo); // Generate the element buffer.
 
-    glBindVertexArray(screenquad.vao); CheckGLError(); // Bind the VAO
+    GLState::BindVertexArray(screenquad.vao); CheckGLError(); // Bind the VAO
 
-    glBindBuffer(GL_ARRAY_BUFFER, screenquad.vbo); CheckGLError(); // Bind the vertex buffer.
+    GLState::BindBuffer(GL_ARRAY_BUFFER, screenquad.vbo); CheckGLError(); // Bind the vertex buffer.
 
     // Store the verts in the buffer.
     glBufferData(GL_ARRAY_BUFFER, sizeof(quaddata), quaddata, GL_STATIC_DRAW); CheckGLError();
@@ -115,11 +170,11 @@ const int* RenderSystem::Start(const unsigned int width, const unsigned int heig
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, QUADVERTSIZE, (GLvoid*)0);
     glEnableVertexAttribArray(0); CheckGLError();
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, screenquad.ibo); // Bind the element buffer.
+    GLState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, screenquad.ibo); // Bind the element buffer.
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(quadindicies), quadindicies, GL_STATIC_DRAW);
     CheckGLError();
 
-    glBindVertexArray(0); CheckGLError(); // unbind VAO when done
+    GLState::BindVertexArray(0); CheckGLError(); // unbind VAO when done
 
     std::list<Property> settings;
     settings.push_back(Property("version", opengl_version));
@@ -137,6 +192,8 @@ const int* RenderSystem::Start(const unsigned int width, const unsigned int heig
             }
         }
     }
+    // the layers know their size once started
+    CompileRenderList();
     return this->gl_version;
 }
 
@@ -179,37 +236,62 @@ void RenderSystem::RegisterListResolvers() {
     fbo_copytype_map["depth-stencil"] = GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT;
 
     const RenderSystem& rensys = *this;
-    list_resolvers[RenderCmd::CLEAR_SCREEN] = [&rensys] (RenderCommandItem &rlist) -> bool {
+    auto noop = [] (const RenderCommandItem &rlist, RenderProgram &program) -> bool {
         return true;
     };
-    list_resolvers[RenderCmd::MODULE_CMD] = [&rensys] (RenderCommandItem &rlist) -> bool {
-        return true;
+    // a blank op, without layers or rects
+    auto makeop = [] (RenderOpCode code) -> RenderOp {
+        RenderOp op;
+        op.code = code;
+        op.copy_bits = 0;
+        op.layer = nullptr;
+        op.target = nullptr;
+        op.shader = nullptr;
+        for(GLint &loc : op.layer_locations) {
+            loc = -1;
+        }
+        op.has_rect = false;
+        op.has_target_rect = false;
+        return op;
     };
-    list_resolvers[RenderCmd::SCRIPT] = [&rensys] (RenderCommandItem &rlist) -> bool {
+    list_resolvers[RenderCmd::CLEAR_SCREEN] = [makeop] (const RenderCommandItem &rlist, RenderProgram &program) -> bool {
+        program.Add(makeop(RenderOpCode::CLEAR_SCREEN));
         return true;
     };
-    list_resolvers[RenderCmd::RENDER] = [&rensys] (RenderCommandItem &rlist) -> bool {
+    list_resolvers[RenderCmd::MODULE_CMD] = noop;
+    list_resolvers[RenderCmd::SCRIPT] = noop;
+    list_resolvers[RenderCmd::RENDER] = [&rensys, makeop] (const RenderCommandItem &rlist, RenderProgram &program) -> bool {
         if(rlist.cmdvalue.Is<std::string>()) {
             const std::string &rentype = rlist.cmdvalue.Get<std::string>();
             if(rentype == "all-geometry") {
-                rlist.run_values.push_back(Container((long)0));
+                program.Add(makeop(RenderOpCode::DRAW_GEOMETRY));
             }
             else if(rentype == "depth-geometry") {
-                rlist.run_values.push_back(Container((long)1));
+                program.Add(makeop(RenderOpCode::DRAW_DEPTH));
             }
             else if(rentype == "lighting") {
-                rlist.run_values.push_back(Container((long)2));
+                program.Add(makeop(RenderOpCode::DRAW_LIGHTING));
             }
             else if(rentype == "post") {
-                rlist.run_values.push_back(Container((long)3));
+                RenderOp op = makeop(RenderOpCode::DRAW_POST);
                 for(auto pitr = rlist.load_properties.begin(); pitr != rlist.load_properties.end(); pitr++) {
                     if(pitr->GetName() == "shader" && pitr->Is<std::string>()) {
                         auto shader_ptr = rensys.Get<Shader>(pitr->Get<std::string>());
                         if(shader_ptr) {
-                            rlist.run_values.push_back(Container(shader_ptr));
+                            op.shader = shader_ptr.get();
+                            program.Hold(shader_ptr);
                         }
                     }
                 }
+                if(!op.shader) {
+                    LOGMSGON(ERROR, rensys) << "Post render without a shader";
+                    return false;
+                }
+                static const char *layer_names[4] = { "layer0", "layer1", "layer2", "layer3" };
+                for(unsigned int i = 0; i < 4; i++) {
+                    op.layer_locations[i] = op.shader->Uniform(layer_names[i]);
+                }
+                program.Add(op);
             }
             else {
                 LOGMSGON(ERROR, rensys) << "Invalid render method";
@@ -221,50 +303,57 @@ void RenderSystem::RegisterListResolvers() {
         }
         return true;
     };
-    list_resolvers[RenderCmd::SET_PARAM] = [&rensys] (RenderCommandItem &rlist) -> bool {
-        return true;
-    };
-    auto layerresolver = [&rensys] (RenderCommandItem &rlist) -> bool {
-        if(rlist.cmdvalue.IsEmpty()) {
-            rlist.run_values.push_back(Container(false));
-        }
-        else if(rlist.cmdvalue.Is<std::string>()) {
-            rlist.run_values.push_back(Container(true));
+    list_resolvers[RenderCmd::SET_PARAM] = noop;
+    // binds the layer named by the command, or nothing when the value is empty
+    auto resolvelayer = [&rensys] (const RenderCommandItem &rlist, RenderProgram &program, RenderLayer *&layer) -> bool {
+        layer = nullptr;
+        if(rlist.cmdvalue.Is<std::string>()) {
             auto layerptr = rensys.Get<RenderLayer>(rlist.cmdvalue.Get<std::string>());
             if(!layerptr) {
                 LOGMSGON(ERROR, rensys) << "Layer not found: " << rlist.cmdvalue.Get<std::string>();
                 return false;
             }
-            rlist.run_values.push_back(Container(layerptr));
+            layer = layerptr.get();
+            program.Hold(layerptr);
         }
         return true;
     };
-    list_resolvers[RenderCmd::READ_LAYER] = layerresolver;
-    list_resolvers[RenderCmd::WRITE_LAYER] = layerresolver;
-    list_resolvers[RenderCmd::SET_RENDER_LAYER] = layerresolver;
-    list_resolvers[RenderCmd::BIND_LAYER_TEXTURES] = layerresolver;
-    list_resolvers[RenderCmd::COPY_LAYER] = [fbo_copytype_map, &rensys] (RenderCommandItem &rlist) -> bool {
-        if(rlist.cmdvalue.IsEmpty()) {
-            rlist.run_values.push_back(Container(false));
-        }
-        else if(rlist.cmdvalue.Is<std::string>()) {
-            rlist.run_values.push_back(Container(true));
-            auto layerptr = rensys.Get<RenderLayer>(rlist.cmdvalue.Get<std::string>());
-            if(!layerptr) {
-                LOGMSGON(ERROR, rensys) << "Layer not found: " << rlist.cmdvalue.Get<std::string>();
+    auto layerresolver = [resolvelayer, makeop] (RenderOpCode code) {
+        return [resolvelayer, makeop, code] (const RenderCommandItem &rlist, RenderProgram &program) -> bool {
+            RenderOp op = makeop(code);
+            if(!resolvelayer(rlist, program, op.layer)) {
                 return false;
             }
-            rlist.run_values.push_back(Container(layerptr));
+            // custom size layers keep their own viewport
+            if(op.layer && op.layer->IsCustomSize()) {
+                op.layer->GetRect(op.rect);
+                op.has_rect = true;
+            }
+            program.Add(op);
+            return true;
+        };
+    };
+    list_resolvers[RenderCmd::READ_LAYER] = layerresolver(RenderOpCode::READ_LAYER);
+    list_resolvers[RenderCmd::WRITE_LAYER] = layerresolver(RenderOpCode::WRITE_LAYER);
+    list_resolvers[RenderCmd::SET_RENDER_LAYER] = layerresolver(RenderOpCode::RENDER_LAYER);
+    list_resolvers[RenderCmd::BIND_LAYER_TEXTURES] = layerresolver(RenderOpCode::BIND_LAYER_TEXTURES);
+    list_resolvers[RenderCmd::COPY_LAYER] = [fbo_copytype_map, &rensys, resolvelayer, makeop]
+            (const RenderCommandItem &rlist, RenderProgram &program) -> bool {
+        RenderOp op = makeop(RenderOpCode::COPY_LAYER);
+        if(!resolvelayer(rlist, program, op.layer)) {
+            return false;
+        }
+        if(op.layer) {
+            op.layer->GetRect(op.rect);
+            op.has_rect = true;
         }
-        std::shared_ptr<RenderLayer> target;
-        GLuint copytypebits = 0;
         for(auto& prop : rlist.load_properties) {
             if(prop.GetName() == "type") {
                 if(prop.Is<std::string>()) {
                     const std::string& typestring = prop.Get<std::string>();
                     auto fboct = fbo_copytype_map.find(typestring);
                     if(fboct != fbo_copytype_map.end()) {
-                        copytypebits |= fboct->second;
+                        op.copy_bits |= fboct->second;
                     }
                     else {
                         return false;
@@ -276,42 +365,70 @@ void RenderSystem::RegisterListResolvers() {
             }
             else if(prop.GetName() == "to") {
                 if(prop.Is<std::string>()) {
-                    target = rensys.Get<RenderLayer>(prop.Get<std::string>());
+                    auto target = rensys.Get<RenderLayer>(prop.Get<std::string>());
                     if(!target) {
                         LOGMSGON(ERROR, rensys) << "Layer not found: " << prop.Get<std::string>();
                         return false;
                     }
+                    op.target = target.get();
+                    op.target->GetRect(op.target_rect);
+                    op.has_target_rect = true;
+                    program.Hold(target);
                 }
             }
         }
-        if(!target) {
-            rlist.run_values.push_back(Container(false));
-        }
-        else {
-            rlist.run_values.push_back(Container(true));
-            rlist.run_values.push_back(Container(target));
-        }
-        rlist.run_values.push_back(Container(copytypebits));
-        return true;
-    };
-    list_resolvers[RenderCmd::BIND_TEXTURE] = [&rensys] (RenderCommandItem &rlist) -> bool {
-        return true;
-    };
-    list_resolvers[RenderCmd::BIND_SHADER] = [&rensys] (RenderCommandItem &rlist) -> bool {
+        program.Add(op);
         return true;
     };
+    list_resolvers[RenderCmd::BIND_TEXTURE] = noop;
+    list_resolvers[RenderCmd::BIND_SHADER] = noop;
+}
+
+void RenderSystem::CompileRenderList() {
+    this->render_program.Reset(this->activerender.get());
+    if(!this->activerender) {
+        return;
+    }
+    for(const auto& cmditem : this->activerender->render_commands) {
+        auto resolve = list_resolvers.find(cmditem.cmd);
+        if(resolve == list_resolvers.end()) {
+            LOGMSGC(ERROR) << "No resolver for render command " << static_cast<unsigned int>(cmditem.cmd);
+            return;
+        }
+        if(!resolve->second(cmditem, this->render_program)) {
+            // the commands before the failed one still run
+            LOGMSGC(ERROR) << "Parsing render command failed";
+            return;
+        }
+    }
 }
 
 void RenderSystem::ThreadInit() {
     TrillekGame::GetOS().MakeCurrent();
+    GLState::Invalidate();
 }
 
 void RenderSystem::RunBatch() const {
 
     if(!this->frame_drop) {
+#ifdef TRILLEK_HEADLESS_GL
+        auto render_start = TrillekGame::GetOS().GetTime();
+#endif
         RenderScene();
+        // fence the streams after the draws reading them
+        this->draw_frame.EndFrame();
+        if(this->frame_buffer.IsCreated()) {
+            this->frame_buffer.EndFrame();
+        }
 
         TrillekGame::GetOS().SwapBuffers();
+        GLState::EndFrame();
+#ifdef TRILLEK_HEADLESS_GL
+        NullGL::EndFrame(TrillekGame::GetOS().GetTime() - render_start);
+        if(NullGL::FrameLimitReached()) {
+            TrillekGame::GetOS().SetWindowShouldClose();
+        }
+#endif
     }
     // If the user closes the window, we notify all the systems
     if (TrillekGame::GetOS().Closing()) {
@@ -321,10 +438,17 @@ void RenderSystem::RunBatch() const {
 
 void RenderSystem::RenderScene() const {
 
-    const ViewMatrixSet *c_view;
-    c_view = &vp_center;
-    glm::mat4x4 inv_proj = glm::inverse(c_view->projection_matrix);
-    glViewport(c_view->viewport.x, c_view->viewport.y, c_view->viewport.z, c_view->viewport.w);
+    const RenderSnapshot &frame = this->snapshot;
+    const ViewRect &viewport = frame.viewport;
+    glViewport(viewport.x, viewport.y, viewport.z, viewport.w);
+
+    this->draw_frame.Commit();
+    if(this->clustered_lighting) {
+        this->light_grid.Upload();
+    }
+    if(this->frame_buffer.IsCreated()) {
+        this->frame_buffer.Upload(frame.frame);
+    }
 
     if(activerender) {
         for(auto texitem = dyn_textures.begin(); texitem != dyn_textures.end(); texitem++) {
@@ -336,234 +460,136 @@ void RenderSystem::RenderScene() const {
                 texptr->Update();
             }
         }
-        for(auto& cmditem : activerender->render_commands) {
-            if(!cmditem.resolved && !cmditem.resolve_error) {
-                auto resolve = list_resolvers.find(cmditem.cmd);
-                if(resolve != list_resolvers.end()) {
-                    cmditem.run_values.clear();
-                    if(!resolve->second(cmditem)) {
-                        cmditem.resolve_error = true;
-                        LOGMSGC(ERROR) << "Parsing render command failed";
-                        break;
-                    }
-                    cmditem.resolved = true;
-                }
-                else {
-                    break;
-                }
-            }
-            switch(cmditem.cmd) {
-            case RenderCmd::CLEAR_SCREEN:
+        // the rect of the layer rendered to, the depth pass splits it into tiles
+        ViewRect target = viewport;
+        for(const auto& op : this->render_program.GetOps()) {
+            switch(op.code) {
+            case RenderOpCode::CLEAR_SCREEN:
                 glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
                 // Clear required buffers
                 glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
                 break;
-            case RenderCmd::MODULE_CMD:
+            case RenderOpCode::DRAW_GEOMETRY:
+                GLState::PolygonMode(GL_FILL);
+                GLState::Enable(GL_DEPTH_TEST);
+                RenderColorPass(&frame.frame.view[0][0], &frame.frame.projection[0][0]);
                 break;
-            case RenderCmd::SCRIPT:
+            case RenderOpCode::DRAW_DEPTH:
+                GLState::PolygonMode(GL_FILL);
+                GLState::Enable(GL_DEPTH_TEST);
+                RenderDepthOnlyPass(&frame.frame.view[0][0], &frame.frame.projection[0][0], target);
                 break;
-            case RenderCmd::RENDER:
-            {
-                auto val_itr = cmditem.run_values.begin();
-                switch(val_itr->Get<long>()) {
-                case 0:
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                    glEnable(GL_DEPTH_TEST);
-                    RenderColorPass(&c_view->view_matrix[0][0], &c_view->projection_matrix[0][0]);
-                    break;
-                case 1:
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                    glEnable(GL_DEPTH_TEST);
-                    RenderDepthOnlyPass(&c_view->view_matrix[0][0], &c_view->projection_matrix[0][0]);
-                    break;
-                case 2:
-                    glDisable(GL_MULTISAMPLE);
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                    glDisable(GL_DEPTH_TEST);
-                    RenderLightingPass(c_view->view_matrix, &inv_proj[0][0]);
-                    break;
-                case 3:
-                {
-                    std::shared_ptr<Shader> postshader;
-                    glDisable(GL_MULTISAMPLE);
-                    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-                    glDisable(GL_DEPTH_TEST);
-
-                    for(val_itr++; val_itr != cmditem.run_values.end(); val_itr++) {
-                        if(val_itr->Is<std::shared_ptr<Shader>>()) {
-                            postshader = val_itr->Get<std::shared_ptr<Shader>>();
-                        }
-                    }
-                    RenderPostPass(postshader);
-                }
-                    break;
-                default:
-                    break;
-                }
-            }
+            case RenderOpCode::DRAW_LIGHTING:
+                GLState::Disable(GL_MULTISAMPLE);
+                GLState::PolygonMode(GL_FILL);
+                GLState::Disable(GL_DEPTH_TEST);
+                RenderLightingPass(frame.frame.view, &frame.frame.inv_projection[0][0]);
                 break;
-            case RenderCmd::SET_PARAM:
+            case RenderOpCode::DRAW_POST:
+                GLState::Disable(GL_MULTISAMPLE);
+                GLState::PolygonMode(GL_FILL);
+                GLState::Disable(GL_DEPTH_TEST);
+                RenderPostPass(*op.shader, op.layer_locations);
                 break;
-            case RenderCmd::READ_LAYER:
-            {
-                auto run_op = cmditem.run_values.begin();
-                if(run_op->Get<bool>()) {
-                    run_op++;
-                    auto layer = run_op->Get<std::shared_ptr<RenderLayer>>();
-                    if(layer) {
-                        layer->BindToRead();
-                    }
+            case RenderOpCode::READ_LAYER:
+                if(op.layer) {
+                    op.layer->BindToRead();
                 }
                 else {
                     RenderLayer::UnbindFromAll();
                 }
-            }
                 break;
-            case RenderCmd::WRITE_LAYER:
-            {
-                auto run_op = cmditem.run_values.begin();
-                if(run_op->Get<bool>()) {
-                    run_op++;
-                    auto layer = run_op->Get<std::shared_ptr<RenderLayer>>();
-                    if(layer) {
-                        layer->BindToWrite();
-                    }
+            case RenderOpCode::WRITE_LAYER:
+                if(op.layer) {
+                    op.layer->BindToWrite();
                 }
                 else {
                     RenderLayer::UnbindFromAll();
                 }
-            }
                 break;
-            case RenderCmd::SET_RENDER_LAYER:
+            case RenderOpCode::RENDER_LAYER:
             {
-                auto run_op = cmditem.run_values.begin();
-                if(run_op->Get<bool>()) {
-                    run_op++;
-                    auto layer = run_op->Get<std::shared_ptr<RenderLayer>>();
-                    if(layer) {
-                        layer->BindToRender();
-                        if(layer->IsCustomSize()) {
-                            ViewRect sizeview;
-                            layer->GetRect(sizeview);
-                            glViewport(sizeview.x, sizeview.y,
-                                sizeview.z, sizeview.w);
-                        }
-                        else {
-                            glViewport(c_view->viewport.x, c_view->viewport.y,
-                                c_view->viewport.z, c_view->viewport.w);
-                        }
-                    }
+                if(op.layer) {
+                    op.layer->BindToRender();
                 }
                 else {
                     RenderLayer::UnbindFromAll();
-                    glViewport(c_view->viewport.x, c_view->viewport.y, c_view->viewport.z, c_view->viewport.w);
                 }
+                target = op.has_rect ? op.rect : viewport;
+                glViewport(target.x, target.y, target.z, target.w);
             }
                 break;
-            case RenderCmd::BIND_LAYER_TEXTURES:
-            {
-                auto run_op = cmditem.run_values.begin();
-                if(run_op->Get<bool>()) {
-                    run_op++;
-                    auto layer = run_op->Get<std::shared_ptr<RenderLayer>>();
-                    if(layer) {
-                        layer->BindTextures();
-                    }
-                }
-                else {
+            case RenderOpCode::BIND_LAYER_TEXTURES:
+                if(op.layer) {
+                    op.layer->BindTextures();
                 }
-            }
                 break;
-            case RenderCmd::COPY_LAYER:
+            case RenderOpCode::COPY_LAYER:
             {
-                ViewRect src, dest;
-                auto run_op = cmditem.run_values.begin();
-                if(run_op->Get<bool>()) {
-                    run_op++;
-                    auto layer = run_op->Get<std::shared_ptr<RenderLayer>>();
-                    if(layer) {
-                        layer->BindToRead();
-                        layer->GetRect(src);
-                    }
+                if(op.layer) {
+                    op.layer->BindToRead();
                 }
                 else {
                     RenderLayer::UnbindFromRead();
-                    src = c_view->viewport;
                 }
-                run_op++;
-                if(run_op->Get<bool>()) {
-                    run_op++;
-                    auto layer = run_op->Get<std::shared_ptr<RenderLayer>>();
-                    if(layer) {
-                        layer->BindToWrite();
-                        layer->GetRect(dest);
-                    }
+                if(op.target) {
+                    op.target->BindToWrite();
                 }
                 else {
                     RenderLayer::UnbindFromWrite();
-                    dest = c_view->viewport;
                 }
-                run_op++;
-                GLuint typebits = run_op->Get<GLuint>();
-                glBlitFramebuffer(src.x, src.y, src.z, src.w, dest.x, dest.y, dest.z, dest.w, typebits, GL_NEAREST);
+                const ViewRect &src = op.has_rect ? op.rect : viewport;
+                const ViewRect &dest = op.has_target_rect ? op.target_rect : viewport;
+                glBlitFramebuffer(src.x, src.y, src.z, src.w, dest.x, dest.y, dest.z, dest.w, op.copy_bits, GL_NEAREST);
             }
                 break;
-            case RenderCmd::BIND_TEXTURE:
-                break;
-            case RenderCmd::BIND_SHADER:
-                break;
             }
         }
     }
 }
 
 void RenderSystem::RenderColorPass(const float *view_matrix, const float *proj_matrix) const {
-    for (auto matgrp : this->material_groups) {
-        const auto& shader = matgrp.material.GetShader();
-        shader->Use();
-
-        glUniformMatrix4fv((*shader)("view"), 1, GL_FALSE, view_matrix);
-        glUniformMatrix4fv((*shader)("projection"), 1, GL_FALSE, proj_matrix);
-        GLint u_model_loc = shader->Uniform("model");
-        GLint u_animatrix_loc = shader->Uniform("animation_matrix");
-        GLint u_animate_loc = shader->Uniform("animated");
-
-        for (const auto& texgrp : matgrp.texture_groups) {
-            // Activate all textures for this texture group.
-            for (size_t tex_index = 0; tex_index < texgrp.texture_indicies.size(); ++tex_index) {
-                matgrp.material.ActivateTexture(texgrp.texture_indicies[tex_index], tex_index);
-            }
-
-            // Loop through each renderable group.
-            for (const auto& rengrp : texgrp.renderable_groups) {
-                const auto& bufgrp = rengrp.renderable->GetBufferGroup(rengrp.buffer_group_index);
-                glBindVertexArray(bufgrp->vao);
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufgrp->ibo);
-
-                for (id_t entity_id : rengrp.instances) {
-                    glUniformMatrix4fv(u_model_loc, 1, GL_FALSE, &this->model_matrices.at(entity_id)[0][0]);
-                    auto renanim = rengrp.animations.find(entity_id);
-                    if (renanim != rengrp.animations.end()) {
-                        glUniform1i(u_animate_loc, 1);
-                        auto &animmatricies = renanim->second->animation_matricies;
-                        glUniformMatrix4fv(u_animatrix_loc, animmatricies.size(), GL_FALSE, &animmatricies[0][0][0]);
-                    }
-                    else {
-                        glUniform1i(u_animate_loc, 0);
-                    }
-                    glDrawElements(GL_TRIANGLES, bufgrp->ibo_count, GL_UNSIGNED_INT, 0);
-                }
+    const MaterialGroup *matgrp = nullptr;
+    const std::vector<size_t> *texset = nullptr;
+    std::shared_ptr<Shader> shader;
+    uint32_t material_index = ~0u;
+    uint32_t texture_set = ~0u;
+    const DrawBindings *bindings = nullptr;
+    this->draw_frame.BindBonePalettes();
+
+    // The packets are ordered by shader, textures then mesh,
+    // so state only changes when that part of the sort key changes.
+    this->draw_frame.SubmitPass(this->draw_frame.GetColorPass(), [&] (const DrawPacket& packet) -> const DrawBindings& {
+        if (packet.material_index != material_index || packet.texture_set != texture_set) {
+            if (packet.material_index != material_index) {
+                material_index = packet.material_index;
+                matgrp = &this->material_groups[material_index];
+                shader = matgrp->material.GetShader();
+                shader->Use();
+
+                bindings = &matgrp->bindings;
+                // shaders reading the frame data do not have their own copies
+                if(bindings->view >= 0) glUniformMatrix4fv(bindings->view, 1, GL_FALSE, view_matrix);
+                if(bindings->projection >= 0) glUniformMatrix4fv(bindings->projection, 1, GL_FALSE, proj_matrix);
+                if(bindings->bone_palettes >= 0) glUniform1i(bindings->bone_palettes, BONE_PALETTE_UNIT);
             }
-            for (size_t tex_index = 0; tex_index < texgrp.texture_indicies.size(); ++tex_index) {
-                Material::DeactivateTexture(tex_index);
+            // Activate all textures for this texture set, the units already
+            // holding the same texture are skipped by the state cache.
+            texture_set = packet.texture_set;
+            texset = &matgrp->texture_sets[texture_set];
+            for (size_t tex_index = 0; tex_index < texset->size(); ++tex_index) {
+                matgrp->material.ActivateTexture((*texset)[tex_index], tex_index);
             }
         }
-
+        return *bindings;
+    });
+    if (shader) {
         shader->UnUse();
     }
 }
 
-void RenderSystem::RenderDepthOnlyPass(const float *view_matrix, const float *proj_matrix) const {
+void RenderSystem::RenderDepthOnlyPass(const float *view_matrix, const float *proj_matrix,
+        const ViewRect &atlas_rect) const {
     // Similar to color pass but without textures and everything uses a depth shader
     // This is intended for shadow map passes or the like
     if(!depthpassshader) {
@@ -572,141 +598,209 @@ void RenderSystem::RenderDepthOnlyPass(const float *view_matrix, const float *pr
     CheckGLError();
     depthpassshader->Use();
     CheckGLError();
-    if(this->alllights.begin() == this->alllights.end()) {
-        return;
-    }
-    auto lightitr = this->alllights.begin();
-    LightBase *light = lightitr->second.get();
-    if(light == nullptr) return;
-    const glm::mat4x4& lightmat = this->model_matrices.at(lightitr->first);
-    glm::vec3 lightpos = glm::vec3(lightmat[3][0], lightmat[3][1], lightmat[3][2]);
-    glm::vec4 lightdir = glm::mat3x4(lightmat) * glm::vec3(0.f, 0.f, -1.f);
-    glm::mat4x4 light_matrix =
-        glm::perspective(3.1415f*0.5f, 1.f, 0.5f, 10000.f)
-        * glm::lookAt(lightpos, lightpos-UP_VECTOR, FORWARD_VECTOR);
-    glm::mat4x4 invlight_matrix = glm::inverse(light_matrix);
-    CheckGLError();
-    glUniform3f(depthpassshader->Uniform("light_pos"), lightpos.x, lightpos.y, lightpos.z);
-    glUniformMatrix4fv(depthpassshader->Uniform("light_vp"), 1, GL_FALSE, (float*)&light_matrix);
-    CheckGLError();
-    if(light->shadows) {
-        light->depthmatrix = light_matrix;
-    }
+    // the bound layer is the atlas, each shadow view renders into its tile
+    const GLint atlas[4] = {
+        static_cast<GLint>(atlas_rect.x), static_cast<GLint>(atlas_rect.y),
+        static_cast<GLint>(atlas_rect.z), static_cast<GLint>(atlas_rect.w)
+    };
+    GLuint atlas_fbo = GLState::GetDrawFramebuffer();
     glDrawBuffer(GL_NONE);
-    GLint u_model_loc = depthpassshader->Uniform("model");
-    GLint u_animatrix_loc = depthpassshader->Uniform("animation_matrix");
-    GLint u_animate_loc = depthpassshader->Uniform("animated");
-    for (auto matgrp : this->material_groups) {
-        for (const auto& texgrp : matgrp.texture_groups) {
-            // Loop through each renderable group.
-            for (const auto& rengrp : texgrp.renderable_groups) {
-                const auto& bufgrp = rengrp.renderable->GetBufferGroup(rengrp.buffer_group_index);
-                glBindVertexArray(bufgrp->vao);
-                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufgrp->ibo);
-
-                for (id_t entity_id : rengrp.instances) {
-                    glUniformMatrix4fv(u_model_loc, 1, GL_FALSE, &this->model_matrices.at(entity_id)[0][0]);
-                    auto renanim = rengrp.animations.find(entity_id);
-                    if (renanim != rengrp.animations.end()) {
-                        glUniform1i(u_animate_loc, 1);
-                        auto &animmatricies = renanim->second->animation_matricies;
-                        glUniformMatrix4fv(u_animatrix_loc, animmatricies.size(), GL_FALSE, &animmatricies[0][0][0]);
-                    }
-                    else {
-                        glUniform1i(u_animate_loc, 0);
-                    }
-                    glDrawElements(GL_TRIANGLES, bufgrp->ibo_count, GL_UNSIGNED_INT, 0);
-                }
+    const DrawBindings &bindings = this->depth_bindings;
+    this->draw_frame.BindBonePalettes();
+    if (bindings.bone_palettes >= 0) glUniform1i(bindings.bone_palettes, BONE_PALETTE_UNIT);
+    auto set_view = [&] (const ShadowView& view) {
+        GLint tile[4] = {
+            atlas[0] + static_cast<GLint>(view.tile.x * atlas[2]),
+            atlas[1] + static_cast<GLint>(view.tile.y * atlas[3]),
+            static_cast<GLint>(view.tile.z * atlas[2]),
+            static_cast<GLint>(view.tile.z * atlas[3])
+        };
+        glViewport(tile[0], tile[1], tile[2], tile[3]);
+        glScissor(tile[0], tile[1], tile[2], tile[3]);
+        glUniform3f(bindings.light_pos, view.light_pos.x, view.light_pos.y, view.light_pos.z);
+        glUniformMatrix4fv(bindings.light_vp, 1, GL_FALSE, &view.light_matrix[0][0]);
+        CheckGLError();
+    };
+    auto draw_pass = [&] (const DrawPass& pass) {
+        this->draw_frame.SubmitPass(pass, [&bindings] (const DrawPacket&) -> const DrawBindings& {
+            return bindings;
+        });
+    };
+
+    // The stale tiles of the cache get the static casters, then the cache
+    // replaces the depth of the atlas. Without a cache they go straight to the atlas.
+    ShadowCache *cache = this->shadow_cache.get();
+    if (cache && !cache->Resize(atlas[0] + atlas[2], atlas[1] + atlas[3])) {
+        cache = nullptr;
+    }
+    if (cache) {
+        cache->BindToRender();
+        GLState::Enable(GL_SCISSOR_TEST);
+        for (const auto& view : this->draw_frame.GetShadowViews()) {
+            if (view.refresh_static) {
+                set_view(view);
+                glClear(GL_DEPTH_BUFFER_BIT);
+                draw_pass(view.static_pass);
             }
         }
+        GLState::Disable(GL_SCISSOR_TEST);
+        GLuint read_fbo = GLState::GetReadFramebuffer();
+        cache->CopyTo(atlas_fbo, atlas);
+        GLState::BindFramebuffer(GL_READ_FRAMEBUFFER, read_fbo);
+    }
+    for (const auto& view : this->draw_frame.GetShadowViews()) {
+        set_view(view);
+        if (!cache) {
+            draw_pass(view.static_pass);
+        }
+        draw_pass(view.pass);
     }
+    glViewport(atlas[0], atlas[1], atlas[2], atlas[3]);
     CheckGLError();
     Shader::UnUse();
     CheckGLError();
 }
 
+void RenderSystem::ResolveDrawBindings(Shader &shader, DrawBindings &bindings) const {
+    if(bindings.link_id == shader.GetLinkID()) {
+        return;
+    }
+    bindings.link_id = shader.GetLinkID();
+    bindings.view = shader.Uniform("view");
+    bindings.projection = shader.Uniform("projection");
+    bindings.model = shader.Uniform("model");
+    bindings.palette = shader.Uniform("palette");
+    bindings.bone_palettes = shader.Uniform("bone_palettes");
+    bindings.animated = shader.Uniform("animated");
+    bindings.light_pos = shader.Uniform("light_pos");
+    bindings.light_vp = shader.Uniform("light_vp");
+    // shaders opt into instancing by reading the model matrix from this attribute
+    bindings.instance_model = this->instancing ? shader.Attribute("instance_model") : -1;
+    bindings.instance_palette = this->instancing ? shader.Attribute("instance_palette") : -1;
+}
+
+void RenderSystem::ResolveLightingBindings(Shader &shader, LightingBindings &bindings) {
+    if(bindings.link_id == shader.GetLinkID()) {
+        return;
+    }
+    static const char *layer_names[4] = { "layer0", "layer1", "layer2", "layer3" };
+    bindings.link_id = shader.GetLinkID();
+    for(unsigned int i = 0; i < 4; i++) {
+        bindings.layers[i] = shader.Uniform(layer_names[i]);
+    }
+    bindings.inv_proj = shader.Uniform("inv_proj");
+    bindings.light_pos = shader.Uniform("light_pos");
+    bindings.light_color = shader.Uniform("light_color");
+    bindings.light_dir = shader.Uniform("light_dir");
+    bindings.light_type = shader.Uniform("light_type");
+    bindings.shadow_enabled = shader.Uniform("shadow_enabled");
+    bindings.shadow_matrix = shader.Uniform("shadow_matrix");
+    bindings.shadow_depth = shader.Uniform("shadow_depth");
+}
+
+void RenderSystem::UpdateShaderBindings() {
+    for (auto& matgrp : this->material_groups) {
+        auto shader = matgrp.material.GetShader();
+        if (shader) {
+            ResolveDrawBindings(*shader, matgrp.bindings);
+        }
+    }
+    if (this->depthpassshader) {
+        ResolveDrawBindings(*this->depthpassshader, this->depth_bindings);
+    }
+    if (this->clusteredshader) {
+        ResolveLightingBindings(*this->clusteredshader, this->clustered_bindings);
+        this->light_grid.ResolveBindings(*this->clusteredshader);
+    }
+    if (this->lightingshader) {
+        ResolveLightingBindings(*this->lightingshader, this->lighting_bindings);
+        for (auto& clight : this->alllights) {
+            if (clight.light) {
+                clight.light->ResolveBindings(*this->lightingshader);
+            }
+        }
+    }
+}
+
 void RenderSystem::RenderLightingPass(const glm::mat4x4 &view_matrix, const float *inv_proj_matrix) const {
-    glBindVertexArray(screenquad.vao); CheckGLError();
-    GLint l_pos_loc = 0;
-    GLint l_dir_loc = 0;
-    GLint l_col_loc = 0;
-    GLint l_type_loc = 0;
-    GLint l_ushadow_loc = 0;
-    GLint l_tshadow_loc = 0;
-    GLint l_sshadow_loc = 0;
+    GLState::BindVertexArray(screenquad.vao); CheckGLError();
+    GLState::Enable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    const bool clustered = this->clustered_lighting && this->clusteredshader;
+    if(clustered) {
+        // shade all the lights of the cluster grid in one pass
+        const LightingBindings &cbind = this->clustered_bindings;
+        clusteredshader->Use();
+        for(GLint unit = 0; unit < 4; unit++) {
+            if(cbind.layers[unit] >= 0) glUniform1i(cbind.layers[unit], unit);
+        }
+        if(cbind.inv_proj >= 0) glUniformMatrix4fv(cbind.inv_proj, 1, GL_FALSE, inv_proj_matrix);
+        this->light_grid.Bind(5);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+        CheckGLError();
+    }
+    const LightingBindings &lbind = this->lighting_bindings;
     if(lightingshader) {
         lightingshader->Use();
-        l_pos_loc = lightingshader->Uniform("light_pos");
-        l_col_loc = lightingshader->Uniform("light_color");
-        l_dir_loc = lightingshader->Uniform("light_dir");
-        l_type_loc = lightingshader->Uniform("light_type");
-        l_ushadow_loc = lightingshader->Uniform("shadow_enabled");
-        l_tshadow_loc = lightingshader->Uniform("shadow_matrix");
-        l_sshadow_loc = lightingshader->Uniform("shadow_depth");
-        glUniform1i(lightingshader->Uniform("layer0"), 0);
-        glUniform1i(lightingshader->Uniform("layer1"), 1);
-        glUniform1i(lightingshader->Uniform("layer2"), 2);
-        glUniform1i(lightingshader->Uniform("layer3"), 3);
-        if(l_sshadow_loc > 0) glUniform1i(l_sshadow_loc, 4);
-        glUniformMatrix4fv(lightingshader->Uniform("inv_proj"), 1, GL_FALSE, inv_proj_matrix);
+        for(GLint unit = 0; unit < 4; unit++) {
+            if(lbind.layers[unit] >= 0) glUniform1i(lbind.layers[unit], unit);
+        }
+        if(lbind.shadow_depth >= 0) glUniform1i(lbind.shadow_depth, 4);
+        if(lbind.inv_proj >= 0) glUniformMatrix4fv(lbind.inv_proj, 1, GL_FALSE, inv_proj_matrix);
     }
     else {
+        GLState::Disable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ZERO);
+        GLState::UseProgram(0);
+        GLState::BindVertexArray(0); CheckGLError();
         return;
     }
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_ONE, GL_ONE);
-    for (auto& clight : this->alllights) {
-        if(clight.second && clight.second->enabled) {
-            LightBase *activelight = clight.second.get();
-            std::shared_ptr<Texture> shadowbuf;
-            GLint useshadow = 0;
-            const glm::mat4& lightmat = this->model_matrices.at(clight.first);
-            glm::vec4 lightpos = view_matrix * glm::vec4(lightmat[3][0], lightmat[3][1], lightmat[3][2], 1);
-            glm::vec4 lightdir = glm::mat3x4(lightmat) * glm::vec3(0.f, 0.f, -1.f);
-            if(l_pos_loc > 0) glUniform3f(l_pos_loc, lightpos.x, lightpos.y, lightpos.z);
-            if(l_dir_loc > 0) glUniform3f(l_dir_loc, lightdir.x, lightdir.y, lightdir.z);
-            if(l_col_loc > 0) glUniform3fv(l_col_loc, 1, (float*)&activelight->color);
-            if(l_type_loc > 0) glUniform1ui(l_type_loc, activelight->lighttype);
-            auto lp_itr = activelight->light_props.begin();
-            for(;lp_itr != activelight->light_props.end(); lp_itr++) {
-                GLint uniformloc = lightingshader->Uniform(lp_itr->GetName().c_str());
-                if(uniformloc > 0) {
-                    if(lp_itr->Is<float>()) {
-                        glUniform1f(uniformloc, lp_itr->Get<float>());
-                    }
-                    else if(lp_itr->Is<glm::vec3>()) {
-                        glm::vec3 val = lp_itr->Get<glm::vec3>();
-                        glUniform3f(uniformloc, val.x, val.y, val.z);
-                    }
-                    else if(lp_itr->Is<glm::vec4>()) {
-                        glm::vec4 val = lp_itr->Get<glm::vec4>();
-                        glUniform4f(uniformloc, val.x, val.y, val.z, val.w);
-                    }
-                    else if(lp_itr->Is<glm::vec2>()) {
-                        glm::vec2 val = lp_itr->Get<glm::vec2>();
-                        glUniform2f(uniformloc, val.x, val.y);
-                    }
-                }
-                else if(activelight->shadows && lp_itr->GetName() == "shadow") {
-                    shadowbuf = TrillekGame::GetGraphicSystem().Get<Texture>(lp_itr->Get<std::string>());
-                    if(shadowbuf) {
-                        useshadow = 1 + debugmode;
-                        glActiveTexture(GL_TEXTURE4);
-                        glBindTexture(GL_TEXTURE_2D, shadowbuf->GetID());
-                        glm::mat4x4 invviewshadow = activelight->depthmatrix * glm::inverse(view_matrix);
-                        if(l_tshadow_loc > 0) glUniformMatrix4fv(l_tshadow_loc, 1, GL_FALSE, &invviewshadow[0][0]);
-                    }
-                }
+    const RenderSnapshot &frame = this->snapshot;
+    const glm::mat4x4 &inv_view = frame.frame.inv_view;
+    for (const auto& clight : frame.lights) {
+        // in clustered mode only the shadow casting lights get their own quad
+        if (clustered && !clight.shadows) {
+            continue;
+        }
+        GLint useshadow = 0;
+        glm::vec4 lightpos = view_matrix * glm::vec4(clight.position, 1.0f);
+        if(lbind.light_pos >= 0) glUniform3f(lbind.light_pos, lightpos.x, lightpos.y, lightpos.z);
+        if(lbind.light_dir >= 0) glUniform3f(lbind.light_dir, clight.direction.x, clight.direction.y, clight.direction.z);
+        if(lbind.light_color >= 0) glUniform3fv(lbind.light_color, 1, &clight.color[0]);
+        if(lbind.light_type >= 0) glUniform1ui(lbind.light_type, clight.type);
+        // the property locations were resolved against the lighting shader
+        for(uint32_t u = clight.first_uniform; u < clight.first_uniform + clight.uniform_count; u++) {
+            const LightUniform &prop = frame.light_uniforms[u];
+            switch(prop.components) {
+            case 1:
+                glUniform1f(prop.location, prop.value.x);
+                break;
+            case 2:
+                glUniform2f(prop.location, prop.value.x, prop.value.y);
+                break;
+            case 3:
+                glUniform3f(prop.location, prop.value.x, prop.value.y, prop.value.z);
+                break;
+            default:
+                glUniform4f(prop.location, prop.value.x, prop.value.y, prop.value.z, prop.value.w);
+                break;
             }
-            if(l_ushadow_loc > 0) glUniform1i(l_ushadow_loc, useshadow);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0); // render quad for each light
         }
+        if(clight.shadow_view >= 0 && clight.shadow_texture) {
+            useshadow = 1 + debugmode;
+            GLState::ActiveTexture(GL_TEXTURE4);
+            GLState::BindTexture(GL_TEXTURE_2D, clight.shadow_texture);
+            glm::mat4x4 invviewshadow = clight.depth_matrix * inv_view;
+            if(lbind.shadow_matrix >= 0) glUniformMatrix4fv(lbind.shadow_matrix, 1, GL_FALSE, &invviewshadow[0][0]);
+        }
+        if(lbind.shadow_enabled >= 0) glUniform1i(lbind.shadow_enabled, useshadow);
+        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0); // render quad for each light
     }
-    glDisable(GL_BLEND);
+    GLState::Disable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ZERO);
     // unbind when done
-    glUseProgram(0);
-    glBindVertexArray(0); CheckGLError();
+    GLState::UseProgram(0);
+    GLState::BindVertexArray(0); CheckGLError();
 }
 
 inline void RenderSystem::UpdateModelMatrices(const frame_tp& timepoint) {
@@ -716,19 +810,50 @@ inline void RenderSystem::UpdateModelMatrices(const frame_tp& timepoint) {
     // first remove the transforms
     auto& transform_map_neg = transform_container.GetLastNegativeCommit();
     for (const auto& transform : transform_map_neg) {
-        this->model_matrices.erase(transform.first);
+        AddShadowChange(transform.first);
+        this->model_matrices.Release(transform.first);
     }
     // second add the new ones
     auto& transform_map_pos = transform_container.GetLastPositiveCommit();
-    // for each frame
+    // gather the modified transforms, slots are allocated before composing
+    // since the matrix array may grow
+    this->transform_batch.Clear();
+    this->transform_batch.Reserve(transform_map_pos.size());
     for (const auto& transform_el : transform_map_pos) {
-        // for each modified transform in the frame
         const auto id = transform_el.first;
         const auto& transform = *component::Get<Component::GraphicTransform>(transform_el.second);
-        glm::mat4 model_matrix = glm::translate(transform.GetTranslation()) *
-            glm::mat4_cast(transform.GetOrientation()) *
-            glm::scale(transform.GetScale());
-        this->model_matrices[id] = std::move(model_matrix);
+        this->transform_batch.Add(transform.GetTranslation(), transform.GetOrientation(),
+            transform.GetScale(), this->model_matrices.Acquire(id).index);
+    }
+    this->transform_batch.ComposeAll(this->model_matrices.Data());
+    // refit the spatial index entries of the moved entities
+    if (!this->renderable_proxies.empty() || !this->light_proxies.empty()) {
+        for (const auto& transform_el : transform_map_pos) {
+            const auto id = transform_el.first;
+            auto proxy_itr = this->renderable_proxies.find(id);
+            if (proxy_itr != this->renderable_proxies.end()) {
+                // the cached shadows see the caster leave its old bounds and enter the new ones
+                AddShadowChange(id);
+                MoveSpatialProxy(this->renderable_index, id, proxy_itr->second);
+                AddShadowChange(id);
+            }
+            proxy_itr = this->light_proxies.find(id);
+            if (proxy_itr != this->light_proxies.end()) {
+                MoveSpatialProxy(this->light_index, id, proxy_itr->second);
+            }
+        }
+    }
+    // Lights whose transform was removed and added back get their new slot,
+    // and the lights whose radius changed get a new box
+    for (auto& clight : this->alllights) {
+        if (!this->model_matrices.IsValid(clight.matrix)) {
+            clight.matrix = this->model_matrices.Acquire(clight.entity_id);
+        }
+        if (clight.light && clight.light->radius != clight.indexed_radius) {
+            clight.indexed_radius = clight.light->radius;
+            SetSpatialProxy(this->light_index, this->light_proxies, clight.entity_id,
+                GetLightBounds(clight.indexed_radius));
+        }
     }
     // Update the view matrix if necessary
     if (transform_map_pos.count(this->GetActiveCameraID())) {
@@ -738,15 +863,221 @@ inline void RenderSystem::UpdateModelMatrices(const frame_tp& timepoint) {
     }
 }
 
-void RenderSystem::RenderPostPass(std::shared_ptr<Shader> postshader) const {
-    postshader->Use();
-    glBindVertexArray(screenquad.vao); CheckGLError();
-    glUniform1i(postshader->Uniform("layer0"), 0);CheckGLError();
-    glUniform1i(postshader->Uniform("layer1"), 1);CheckGLError();
-    glUniform1i(postshader->Uniform("layer2"), 2);CheckGLError();
-    glUniform1i(postshader->Uniform("layer3"), 3);CheckGLError();
+void RenderSystem::UpdateFrameData(frame_tp now, frame_tp delta) {
+    const ViewMatrixSet &c_view = this->vp_center;
+    this->frame_data.view = c_view.view_matrix;
+    this->frame_data.projection = c_view.projection_matrix;
+    this->frame_data.inv_view = glm::inverse(c_view.view_matrix);
+    this->frame_data.inv_projection = glm::inverse(c_view.projection_matrix);
+    this->frame_data.viewport = glm::vec4(c_view.viewport.x, c_view.viewport.y,
+        c_view.viewport.z, c_view.viewport.w);
+    this->frame_data.time = glm::vec4((now - this->start_time) * 1E-9, delta * 1E-9, 0.0f, 0.0f);
+}
+
+void RenderSystem::TakeSnapshot() {
+    RenderSnapshot &back = this->snapshot;
+    back.viewport = this->vp_center.viewport;
+    back.frame = this->frame_data;
+
+    // The enabled lights, with the values of their properties.
+    back.lights.clear();
+    back.light_uniforms.clear();
+    for (const auto& clight : this->alllights) {
+        if (!clight.light || !clight.light->enabled) {
+            continue;
+        }
+        const LightBase& light = *clight.light;
+        const glm::mat4& lightmat = this->model_matrices[clight.matrix];
+        LightSnapshot item;
+        item.position = glm::vec3(lightmat[3]);
+        item.direction = glm::vec3(lightmat * glm::vec4(0.f, 0.f, -1.f, 0.f));
+        item.color = light.color;
+        item.type = light.lighttype;
+        item.shadows = light.shadows;
+        item.shadow_view = clight.shadow_view;
+        item.shadow_texture = light.shadow_texture ? light.shadow_texture->GetID() : 0;
+        item.depth_matrix = light.depthmatrix;
+        item.first_uniform = static_cast<uint32_t>(back.light_uniforms.size());
+        const size_t prop_count = std::min(light.prop_locations.size(), light.light_props.size());
+        for (size_t i = 0; i < prop_count; ++i) {
+            const Property& prop = light.light_props[i];
+            LightUniform uniform;
+            uniform.location = light.prop_locations[i];
+            if (uniform.location < 0) {
+                continue;
+            }
+            if (prop.Is<float>()) {
+                uniform.components = 1;
+                uniform.value = glm::vec4(prop.Get<float>(), 0.f, 0.f, 0.f);
+            }
+            else if (prop.Is<glm::vec2>()) {
+                uniform.components = 2;
+                uniform.value = glm::vec4(prop.Get<glm::vec2>(), 0.f, 0.f);
+            }
+            else if (prop.Is<glm::vec3>()) {
+                uniform.components = 3;
+                uniform.value = glm::vec4(prop.Get<glm::vec3>(), 0.f);
+            }
+            else if (prop.Is<glm::vec4>()) {
+                uniform.components = 4;
+                uniform.value = prop.Get<glm::vec4>();
+            }
+            else {
+                continue;
+            }
+            back.light_uniforms.push_back(uniform);
+        }
+        item.uniform_count = static_cast<uint32_t>(back.light_uniforms.size()) - item.first_uniform;
+        back.lights.push_back(item);
+    }
+}
+
+void RenderSystem::UpdateDrawList() {
+    UpdateShadowViews();
+    DrawCamera view_camera;
+    view_camera.view = this->vp_center.view_matrix;
+    view_camera.projection = this->vp_center.projection_matrix;
+    view_camera.position = glm::vec3(this->frame_data.inv_view[3]);
+    view_camera.viewport_height = static_cast<float>(this->window_height);
+    view_camera.near_plane = VIEW_NEAR_PLANE;
+    view_camera.far_plane = VIEW_FAR_PLANE;
+    this->draw_frame.Build(view_camera);
+    if (this->draw_frame.GetPaletteOverflow()) {
+        LOGMSGC(WARNING) << "Bone palettes of " << this->draw_frame.GetPaletteOverflow()
+            << " matrices do not fit the buffer texture";
+    }
+}
+
+void RenderSystem::UpdateShadowViews() {
+    const glm::mat4 &inv_view = this->frame_data.inv_view;
+    const glm::vec3 camera_pos(inv_view[3][0], inv_view[3][1], inv_view[3][2]);
+
+    // The importance of a light is the size of its sphere as seen from the camera.
+    this->shadow_importance.clear();
+    for (auto& clight : this->alllights) {
+        clight.shadow_view = -1;
+        if (!clight.light || !clight.light->enabled || !clight.light->shadows) {
+            continue;
+        }
+        const glm::mat4& lightmat = this->model_matrices[clight.matrix];
+        glm::vec3 lightpos(lightmat[3][0], lightmat[3][1], lightmat[3][2]);
+        float radius = clight.light->radius;
+        this->shadow_importance.push_back(radius / std::max(glm::distance(camera_pos, lightpos), radius));
+    }
+    ShadowAtlas::Allocate(this->shadow_importance, this->shadow_tiles);
+
+    std::vector<ShadowView> &shadow_views = this->draw_frame.GetShadowViews();
+    const bool use_cache = this->shadow_cache && this->shadow_cache->IsComplete();
+    size_t shadow_index = 0;
+    size_t view_count = 0;
+    for (auto& clight : this->alllights) {
+        if (!clight.light || !clight.light->enabled || !clight.light->shadows) {
+            clight.shadow_cached = false;
+            continue;
+        }
+        const glm::vec4 &tile = this->shadow_tiles[shadow_index++];
+        if (tile.z <= 0.0f) {
+            clight.shadow_cached = false;
+            continue; // no room left in the atlas
+        }
+        if (view_count == shadow_views.size()) {
+            shadow_views.push_back(ShadowView());
+        }
+        ShadowView &view = shadow_views[view_count];
+        clight.shadow_view = static_cast<int32_t>(view_count++);
+
+        // look down the -Z axis of the light transform
+        const glm::mat4& lightmat = this->model_matrices[clight.matrix];
+        view.light_pos = glm::vec3(lightmat[3][0], lightmat[3][1], lightmat[3][2]);
+        glm::vec4 lightdir = lightmat * glm::vec4(0.f, 0.f, -1.f, 0.f);
+        glm::vec4 lightup = lightmat * glm::vec4(0.f, 1.f, 0.f, 0.f);
+        view.light_matrix =
+            glm::perspective(3.1415f*0.5f, 1.f, 0.5f, std::max(clight.light->radius, 1.0f))
+            * glm::lookAt(view.light_pos, view.light_pos + glm::vec3(lightdir.x, lightdir.y, lightdir.z),
+                glm::vec3(lightup.x, lightup.y, lightup.z));
+        view.tile = tile;
+        clight.light->depthmatrix = ShadowAtlas::GetTileMatrix(tile) * view.light_matrix;
+
+        // The cached static depth is stale when the light or its tile
+        // changed, or when a static caster changed in its frustum.
+        bool cached = use_cache && clight.shadow_cached
+            && clight.cache_generation == this->shadow_cache->GetGeneration()
+            && clight.cached_tile == tile && clight.cached_matrix == view.light_matrix;
+        if (cached && !this->shadow_changes.empty()) {
+            Frustum light_frustum(view.light_matrix);
+            for (const auto& box : this->shadow_changes) {
+                if (light_frustum.TestBox(box.min, box.max)) {
+                    cached = false;
+                    break;
+                }
+            }
+        }
+        view.refresh_static = !cached;
+        // a dropped frame is not rendered, the refresh waits for the next one
+        clight.shadow_cached = cached || !this->frame_drop;
+        if (use_cache) {
+            clight.cache_generation = this->shadow_cache->GetGeneration();
+        }
+        clight.cached_tile = tile;
+        clight.cached_matrix = view.light_matrix;
+    }
+    shadow_views.resize(view_count);
+    this->shadow_changes.clear();
+}
+
+void RenderSystem::AddShadowChange(const id_t entity_id) {
+    if (this->animated_entities.count(entity_id)) {
+        return;
+    }
+    auto proxy_itr = this->renderable_proxies.find(entity_id);
+    if (proxy_itr != this->renderable_proxies.end()) {
+        this->shadow_changes.push_back(this->renderable_index.GetFatBox(proxy_itr->second.proxy));
+    }
+}
+
+void RenderSystem::UpdateLightGrid() {
+    const glm::mat4 &view_matrix = this->vp_center.view_matrix;
+    this->grid_lights.clear();
+    for (const auto& clight : this->alllights) {
+        // shadow casting lights keep their own pass
+        if (!clight.light || !clight.light->enabled || clight.light->shadows) {
+            continue;
+        }
+        const glm::mat4& lightmat = this->model_matrices[clight.matrix];
+        GridLight light;
+        glm::vec4 position = view_matrix * lightmat[3];
+        glm::vec4 direction = view_matrix * (lightmat * glm::vec4(0.f, 0.f, -1.f, 0.f));
+        light.position = glm::vec3(position.x, position.y, position.z);
+        light.direction = glm::vec3(direction.x, direction.y, direction.z);
+        light.radius = clight.light->radius;
+        light.color = clight.light->color;
+        light.type = clight.light->lighttype;
+        this->grid_lights.push_back(light);
+    }
+    this->light_grid.Build(this->grid_lights, this->vp_center.projection_matrix,
+        VIEW_NEAR_PLANE, VIEW_FAR_PLANE);
+}
+
+uint32_t RenderSystem::GetMeshKeyID(const resource::Mesh *mesh, size_t buffer_group_index) {
+    auto mesh_key = std::make_pair(mesh, buffer_group_index);
+    auto mesh_itr = this->mesh_key_ids.find(mesh_key);
+    if (mesh_itr != this->mesh_key_ids.end()) {
+        return mesh_itr->second;
+    }
+    uint32_t mesh_id = this->mesh_key_ids.size();
+    this->mesh_key_ids[mesh_key] = mesh_id;
+    return mesh_id;
+}
+
+void RenderSystem::RenderPostPass(Shader &postshader, const GLint *layer_locations) const {
+    postshader.Use();
+    GLState::BindVertexArray(screenquad.vao); CheckGLError();
+    for(GLint unit = 0; unit < 4; unit++) {
+        if(layer_locations[unit] >= 0) glUniform1i(layer_locations[unit], unit);
+    }
+    CheckGLError();
     glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);CheckGLError();
-    glBindVertexArray(0); CheckGLError();
+    GLState::BindVertexArray(0); CheckGLError();
     Shader::UnUse();
 }
 
@@ -766,6 +1097,71 @@ void RenderSystem::RegisterStaticParsers() {
                 else if(settingname == "depth-shader") {
                     rensys.depthpassshader = rensys.Get<Shader>(settingval);
                 }
+                else if(settingname == "clustered-lighting-shader") {
+                    rensys.clusteredshader = rensys.Get<Shader>(settingval);
+                }
+                else if(settingname == "frame-mode") {
+                    if(settingval == "pipelined") {
+                        rensys.pipelined_frames = true;
+                    }
+                    else if(settingval == "sequential") {
+                        rensys.pipelined_frames = false;
+                    }
+                    else {
+                        LOGMSGON(ERROR, rensys) << "Invalid frame mode: " << settingval;
+                        return false;
+                    }
+                }
+                else if(settingname == "lighting-mode") {
+                    if(settingval == "clustered") {
+                        rensys.clustered_lighting = true;
+                    }
+                    else if(settingval == "per-light") {
+                        rensys.clustered_lighting = false;
+                    }
+                    else {
+                        LOGMSGON(ERROR, rensys) << "Invalid lighting mode: " << settingval;
+                        return false;
+                    }
+                }
+            }
+            else if(settingitr->value.IsNumber()) {
+                if(settingname == "mesh-lod-pixels") {
+                    // the simplification error a mesh level may show, 0 always draws the full meshes
+                    const double pixels = settingitr->value.GetDouble();
+                    if(pixels < 0.0) {
+                        LOGMSGON(ERROR, rensys) << "Invalid mesh LOD pixels: " << pixels;
+                        return false;
+                    }
+                    rensys.draw_frame.SetMeshLODPixels(static_cast<float>(pixels));
+                }
+                else if(settingname == "job-threads") {
+                    // the threads of the graphics jobs, besides the scheduler thread running the frame
+                    const double threads = settingitr->value.GetDouble();
+                    if(threads < 0.0 || threads != std::floor(threads)) {
+                        LOGMSGON(ERROR, rensys) << "Invalid job thread count: " << threads;
+                        return false;
+                    }
+                    if(!JobPool::SetThreadCount(static_cast<size_t>(threads))) {
+                        LOGMSGON(ERROR, rensys) << "The job threads are already started";
+                        return false;
+                    }
+                }
+            }
+            else if(settingitr->value.IsArray()) {
+                if(settingname == "animation-lod") {
+                    // the distances where the animations drop to the next tier, in increasing order
+                    std::vector<float> distances;
+                    for(auto distitr = settingitr->value.Begin(); distitr != settingitr->value.End(); distitr++) {
+                        if(!distitr->IsNumber() || distances.size() >= DrawFrame::ANIMATION_LOD_COUNT - 1
+                                || (!distances.empty() && distitr->GetDouble() < distances.back())) {
+                            LOGMSGON(ERROR, rensys) << "Invalid animation LOD distances";
+                            return false;
+                        }
+                        distances.push_back(static_cast<float>(distitr->GetDouble()));
+                    }
+                    rensys.draw_frame.SetAnimationLODDistances(distances);
+                }
             }
         }
         return true;
@@ -789,8 +1185,8 @@ void RenderSystem::SetViewportSize(const unsigned int width, const unsigned int
     this->vp_center.projection_matrix = glm::perspective(
         glm::radians(45.0f),
         aspect_ratio,
-        0.1f,
-        10000.0f
+        VIEW_NEAR_PLANE,
+        VIEW_FAR_PLANE
         );
 }
 
@@ -808,14 +1204,26 @@ bool RenderSystem::AddEntityComponent(const id_t entity_id, std::shared_ptr<Ligh
 
     // Loop through all the lights and see if one exists for the given entity.
     for (auto& r : this->alllights) {
-        if (r.first == entity_id) {
-            r.second = light;
+        if (r.entity_id == entity_id) {
+            r.light = light;
+            r.indexed_radius = light->radius;
+            SetSpatialProxy(this->light_index, this->light_proxies, entity_id, GetLightBounds(r.indexed_radius));
             return false;
         }
     }
 
     // No entry exists for the given entity, so add it.
-    this->alllights.push_back(std::make_pair(entity_id, light));
+    LightEntry entry;
+    entry.entity_id = entity_id;
+    entry.light = light;
+    entry.matrix = this->model_matrices.Acquire(entity_id);
+    entry.indexed_radius = light->radius;
+    entry.shadow_view = -1;
+    entry.shadow_cached = false;
+    entry.cache_generation = 0;
+    this->alllights.push_back(std::move(entry));
+    // lights are indexed by the box around the sphere they reach
+    SetSpatialProxy(this->light_index, this->light_proxies, entity_id, GetLightBounds(light->radius));
 
     return true;
 }
@@ -837,96 +1245,133 @@ bool RenderSystem::AddEntityComponent(const id_t entity_id, std::shared_ptr<Rend
     // Loop through all the renderables and see if one exists for the given entity_id.
     for (auto& r : this->renderables) {
         if (r.first == entity_id) {
+            // Replace the renderable along with its draw packets.
             r.second = ren;
+            this->draw_frame.GetDrawList().Remove(entity_id);
+            AddDrawPackets(entity_id, ren);
             return false;
         }
     }
 
     // No entry exists for the given entity ID, so add it.
     this->renderables.push_back(std::make_pair(entity_id, ren));
+    AddDrawPackets(entity_id, ren);
+    return true;
+}
 
-    MaterialGroup* matgrp = nullptr;
+void RenderSystem::AddDrawPackets(const id_t entity_id, const std::shared_ptr<Renderable> &ren) {
     // Check if the material for exists based on shader.
-    for (auto& mg : this->material_groups) {
-        if (mg.material.GetShader() == ren->GetShader()) {
-            matgrp = &mg;
-        }
+    uint32_t material_index = 0;
+    while (material_index < this->material_groups.size() &&
+        this->material_groups[material_index].material.GetShader() != ren->GetShader()) {
+        ++material_index;
     }
 
     // There wasn't an existing material group so add one.
-    if (matgrp == nullptr) {
-        MaterialGroup mg;
-        this->material_groups.push_back(mg);
-        matgrp = &this->material_groups.back();
-
-        matgrp->material.SetShader(ren->GetShader());
-
-        //const auto& shader = matgrp->material.GetShader();
-        //shader->Use();
-        //shader->UnUse();
+    if (material_index == this->material_groups.size()) {
+        this->material_groups.push_back(MaterialGroup());
+        this->material_groups.back().material.SetShader(ren->GetShader());
     }
+    MaterialGroup& matgrp = this->material_groups[material_index];
 
-    // Map the renderable into the render graph material groups.
+    // Add a draw packet for each buffer group of the renderable.
+    AABB bounds;
     for (size_t i = 0; i < ren->GetBufferGroupCount(); ++i) {
-        MaterialGroup::TextureGroup* texgrp = nullptr;
-
         auto buffer_group = ren->GetBufferGroup(i);
+        AABB group_bounds(buffer_group->bounds_min, buffer_group->bounds_max);
+        bounds = i == 0 ? group_bounds : bounds.Union(group_bounds);
 
-        for (MaterialGroup::TextureGroup& tex_grp_itr : matgrp->texture_groups) {
-            if (texgrp != nullptr) {
-                break;
-            }
-            // Loop through and see if all the texture indicies line up.
-            for (size_t i = 0; (i < tex_grp_itr.texture_indicies.size()) &&
-                (i < buffer_group->textures.size()); ++i) {
-                if (tex_grp_itr.texture_indicies[i] != matgrp->material.GetTextureIndex(buffer_group->textures[i])) {
-                    break;
-                }
-                texgrp = &tex_grp_itr;
-            }
+        // Find a texture set with the same texture indicies, or add it.
+        std::vector<size_t> texture_indicies;
+        for (auto& texture : buffer_group->textures) {
+            texture_indicies.push_back(matgrp.material.GetTextureIndex(texture));
         }
-
-        if (texgrp == nullptr) {
-            MaterialGroup::TextureGroup temp;
-            matgrp->texture_groups.push_back(std::move(temp));
-            texgrp = &matgrp->texture_groups.back();
-
-            // Loop through and add all the texture indicies.
-            for (size_t i = 0; i < buffer_group->textures.size(); ++i) {
-                texgrp->texture_indicies.push_back(matgrp->material.AddTexture(buffer_group->textures[i]));
-            }
-            //texgrp->texture_indicies.push_back(0);
+        auto texset_itr = std::find(matgrp.texture_sets.begin(), matgrp.texture_sets.end(), texture_indicies);
+        uint32_t texture_set = texset_itr - matgrp.texture_sets.begin();
+        if (texset_itr == matgrp.texture_sets.end()) {
+            matgrp.texture_sets.push_back(std::move(texture_indicies));
         }
 
-        MaterialGroup::TextureGroup::RenderableGroup* rengrp = nullptr;
-        // If we made it then add entity instances based on the meshes being the same.
-        for (MaterialGroup::TextureGroup::RenderableGroup& ren_grp_itr : texgrp->renderable_groups) {
-            if ((ren_grp_itr.renderable->GetMesh() == ren->GetMesh()) && (ren_grp_itr.buffer_group_index == i)) {
-                rengrp = &ren_grp_itr;
-                rengrp->instances.push_back(entity_id);
-                if (ren->GetAnimation()) {
-                    rengrp->animations[entity_id] = ren->GetAnimation();
-                }
-                break;
-            }
+        DrawPacket packet;
+        packet.sort_key = DrawList::MakeKey(0, material_index, texture_set,
+            GetMeshKeyID(ren->GetMesh().get(), i), 0);
+        packet.entity_id = entity_id;
+        packet.matrix = this->model_matrices.Acquire(entity_id);
+        packet.material_index = material_index;
+        packet.texture_set = texture_set;
+        packet.vao = buffer_group->vao;
+        packet.ibo = buffer_group->ibo;
+        packet.ibo_first = 0;
+        packet.ibo_count = buffer_group->ibo_count;
+        packet.animation = ren->GetAnimation().get();
+        packet.bounds = buffer_group->bounding_sphere;
+        packet.levels = nullptr;
+        packet.level_count = 1;
+        packet.level = 0;
+        if (buffer_group->level_chain && buffer_group->level_chain->levels.size() > 1) {
+            packet.levels = buffer_group->level_chain->levels.data();
+            packet.level_count = static_cast<uint32_t>(buffer_group->level_chain->levels.size());
         }
-        if (rengrp == nullptr) {
-            MaterialGroup::TextureGroup::RenderableGroup temp;
-            temp.renderable = ren;
-            if (ren->GetAnimation()) {
-                temp.animations[entity_id] = ren->GetAnimation();
-            }
+        this->draw_frame.GetDrawList().Add(packet);
+    }
+    AddShadowChange(entity_id);
+    if (ren->GetAnimation()) {
+        this->animated_entities.insert(entity_id);
+    }
+    else {
+        this->animated_entities.erase(entity_id);
+    }
+    SetSpatialProxy(this->renderable_index, this->renderable_proxies, entity_id, bounds);
+    AddShadowChange(entity_id);
+}
 
-            temp.buffer_group_index = i;
-            temp.instances.push_back(entity_id);
+void RenderSystem::SetSpatialProxy(AABBTree &index, std::map<id_t, SpatialProxy> &proxies,
+        const id_t entity_id, const AABB &local_bounds) {
+    auto proxy_itr = proxies.find(entity_id);
+    if (proxy_itr != proxies.end()) {
+        proxy_itr->second.local_bounds = local_bounds;
+        MoveSpatialProxy(index, entity_id, proxy_itr->second);
+        return;
+    }
+    SpatialProxy proxy;
+    proxy.local_bounds = local_bounds;
+    MatrixSlot slot;
+    if (this->model_matrices.Find(entity_id, slot)) {
+        proxy.proxy = index.CreateProxy(local_bounds.Transform(this->model_matrices[slot]), entity_id);
+    }
+    else {
+        proxy.proxy = index.CreateProxy(local_bounds, entity_id);
+    }
+    proxies[entity_id] = proxy;
+}
 
-            texgrp->renderable_groups.push_back(std::move(temp));
-        }
+void RenderSystem::MoveSpatialProxy(AABBTree &index, const id_t entity_id, const SpatialProxy &proxy) {
+    MatrixSlot slot;
+    if (this->model_matrices.Find(entity_id, slot)) {
+        index.MoveProxy(proxy.proxy, proxy.local_bounds.Transform(this->model_matrices[slot]));
+    }
+}
+
+void RenderSystem::RemoveSpatialProxy(AABBTree &index, std::map<id_t, SpatialProxy> &proxies,
+        const id_t entity_id) {
+    auto proxy_itr = proxies.find(entity_id);
+    if (proxy_itr != proxies.end()) {
+        index.DestroyProxy(proxy_itr->second.proxy);
+        proxies.erase(proxy_itr);
     }
-    return true;
 }
 
 void RenderSystem::AddDynamicComponent(const id_t entity_id, std::shared_ptr<Container> component) {
+    if(this->pipelined_frames) {
+        // the frame being rendered may be reading the lists, add it with the next frame
+        std::lock_guard<std::mutex> lock(this->pending_mutex);
+        this->pending_components.push_back(std::make_pair(entity_id, std::move(component)));
+        return;
+    }
+    AddComponentNow(entity_id, component);
+}
+
+void RenderSystem::AddComponentNow(const id_t entity_id, const std::shared_ptr<Container> &component) {
     int r;
     if(0 != (r = TryAddComponent<Renderable>(entity_id, component))) {
         if(r < 0) {
@@ -948,44 +1393,26 @@ void RenderSystem::AddDynamicComponent(const id_t entity_id, std::shared_ptr<Con
     }
 }
 
+void RenderSystem::AddPendingComponents() {
+    std::vector<std::pair<id_t, std::shared_ptr<Container>>> pending;
+    {
+        std::lock_guard<std::mutex> lock(this->pending_mutex);
+        pending.swap(this->pending_components);
+    }
+    for (const auto& item : pending) {
+        AddComponentNow(item.first, item.second);
+    }
+}
+
 void RenderSystem::RemoveRenderable(const id_t entity_id) {
     // Loop through all the renderables and see if one exists for the given entityID.
-    for (auto& r : this->renderables) {
-        if (r.first == entity_id) {
-            auto matgrp_itr = this->material_groups.begin();
-            while (matgrp_itr != this->material_groups.end()) {
-                auto texgrp_itr = matgrp_itr->texture_groups.begin();
-                while (texgrp_itr != matgrp_itr->texture_groups.end()) {
-
-                    auto rengrp_itr = texgrp_itr->renderable_groups.begin();
-                    while (rengrp_itr != texgrp_itr->renderable_groups.end()) {
-                        // Check if the renderblae is the one we are looking for an remove it.
-                        if (rengrp_itr->renderable == r.second) {
-                            rengrp_itr = texgrp_itr->renderable_groups.erase(rengrp_itr);
-                        }
-                        else {
-                            ++rengrp_itr;
-                        }
-                    }
-
-                    // Check if the texture group is empty and remove it from the list.
-                    if (texgrp_itr->renderable_groups.size() == 0) {
-                        texgrp_itr = matgrp_itr->texture_groups.erase(texgrp_itr);
-                    }
-                    else {
-                        ++texgrp_itr;
-                    }
-                }
-
-                // Check if the material group is empty and remove it from the list.
-                if (matgrp_itr->texture_groups.size() == 0) {
-                    matgrp_itr = this->material_groups.erase(matgrp_itr);
-                }
-                else {
-                    ++matgrp_itr;
-                }
-            }
-            this->renderables.remove(r);
+    for (auto r = this->renderables.begin(); r != this->renderables.end(); ++r) {
+        if (r->first == entity_id) {
+            this->draw_frame.GetDrawList().Remove(entity_id);
+            AddShadowChange(entity_id);
+            this->animated_entities.erase(entity_id);
+            RemoveSpatialProxy(this->renderable_index, this->renderable_proxies, entity_id);
+            this->renderables.erase(r);
             return;
         }
     }
@@ -1011,12 +1438,30 @@ void RenderSystem::HandleEvents(frame_tp timepoint) {
         this->frame_drop = false;
     }
     last_tp = now;
-    for (auto ren : this->renderables) {
-        if (ren.second->GetAnimation()) {
-            ren.second->GetAnimation()->UpdateAnimation(delta * 1E-9);
+    AddPendingComponents();
+    // The animations move their time and ask for their pose, then each
+    // distinct pose is evaluated once, split between threads. The entity
+    // ids stagger the updates of the animations at a reduced rate.
+    this->draw_frame.BeginAnimations();
+    const float animation_delta = static_cast<float>(delta * 1E-9);
+    for (const auto& ren : this->renderables) {
+        Animation *animation = ren.second->GetAnimation().get();
+        if (animation) {
+            this->draw_frame.UpdateAnimation(*animation, animation_delta, static_cast<uint32_t>(ren.first));
         }
     }
+    this->draw_frame.EvaluatePoses();
+    if (this->activerender.get() != this->render_program.GetSource()) {
+        CompileRenderList();
+    }
     UpdateModelMatrices(timepoint);
+    UpdateFrameData(now, delta);
+    UpdateDrawList();
+    if (this->clustered_lighting) {
+        UpdateLightGrid();
+    }
+    UpdateShaderBindings();
+    TakeSnapshot();
 };
 
 void RenderSystem::Terminate() {
@@ -5,6 +5,12 @@
 #include "systems/lua-system.hpp"
 
 namespace trillek {
+MetaEngineSystem::MetaEngineSystem() : simulation_timepoint(0), simulation_pending(false), simulation_stop(false) { }
+
+MetaEngineSystem::~MetaEngineSystem() {
+    StopSimulation();
+}
+
 void MetaEngineSystem::ThreadInit() {
     TrillekGame::GetLuaSystem().ThreadInit();
     TrillekGame::GetPhysicsSystem().ThreadInit();
@@ -12,18 +18,70 @@ void MetaEngineSystem::ThreadInit() {
 }
 
 void MetaEngineSystem::RunBatch() const {
+    if(TrillekGame::GetGraphicSystem().IsPipelined() && this->simulation_thread.joinable()) {
+        TrillekGame::GetGraphicSystem().RunBatch();
+        std::unique_lock<std::mutex> lock(this->simulation_mutex);
+        this->simulation_cv.wait(lock, [this] () { return !this->simulation_pending; });
+        return;
+    }
     TrillekGame::GetLuaSystem().RunBatch();
     TrillekGame::GetPhysicsSystem().RunBatch();
     TrillekGame::GetGraphicSystem().RunBatch();
 };
 
 void MetaEngineSystem::HandleEvents(frame_tp timepoint) {
+    if(TrillekGame::GetGraphicSystem().IsPipelined()) {
+        // snapshot the state simulated last frame, then simulate the next one while it renders
+        TrillekGame::GetGraphicSystem().HandleEvents(timepoint);
+        if(!this->simulation_thread.joinable()) {
+            this->simulation_thread = std::thread(&MetaEngineSystem::SimulationLoop, this);
+        }
+        {
+            std::lock_guard<std::mutex> lock(this->simulation_mutex);
+            this->simulation_timepoint = timepoint;
+            this->simulation_pending = true;
+        }
+        this->simulation_cv.notify_all();
+        return;
+    }
     TrillekGame::GetLuaSystem().HandleEvents(timepoint);
     TrillekGame::GetPhysicsSystem().HandleEvents(timepoint);
     TrillekGame::GetGraphicSystem().HandleEvents(timepoint);
 };
 
+void MetaEngineSystem::SimulationLoop() {
+    std::unique_lock<std::mutex> lock(this->simulation_mutex);
+    while(true) {
+        this->simulation_cv.wait(lock, [this] () { return this->simulation_pending || this->simulation_stop; });
+        if(!this->simulation_pending) {
+            return;
+        }
+        const frame_tp timepoint = this->simulation_timepoint;
+        lock.unlock();
+        TrillekGame::GetLuaSystem().HandleEvents(timepoint);
+        TrillekGame::GetPhysicsSystem().HandleEvents(timepoint);
+        TrillekGame::GetLuaSystem().RunBatch();
+        TrillekGame::GetPhysicsSystem().RunBatch();
+        lock.lock();
+        this->simulation_pending = false;
+        this->simulation_cv.notify_all();
+    }
+}
+
+void MetaEngineSystem::StopSimulation() {
+    if(!this->simulation_thread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(this->simulation_mutex);
+        this->simulation_stop = true;
+    }
+    this->simulation_cv.notify_all();
+    this->simulation_thread.join();
+}
+
 void MetaEngineSystem::Terminate() {
+    StopSimulation();
     TrillekGame::GetLuaSystem().Terminate();
     TrillekGame::GetPhysicsSystem().Terminate();
     TrillekGame::GetGraphicSystem().Terminate();
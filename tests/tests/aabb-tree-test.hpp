@@ -0,0 +1,161 @@
+#ifndef AABB_TREE_TEST_HPP_INCLUDED
+#define AABB_TREE_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+#include "graphics/aabb-tree.hpp"
+
+namespace trillek {
+namespace graphics {
+
+struct TreeTestEntry {
+    int32_t proxy;
+    AABB box;
+};
+
+static AABB TreeTestBox(std::mt19937 &rng, float extent) {
+    std::uniform_real_distribution<float> position(-extent, extent);
+    std::uniform_real_distribution<float> size(0.1f, 3.0f);
+    const glm::vec3 min(position(rng), position(rng), position(rng));
+    return AABB(min, min + glm::vec3(size(rng), size(rng), size(rng)));
+}
+
+// the tree must give exactly the entries whose enlarged box passes the test,
+// and those always include the entries whose own box passes it
+template<class T, class Q>
+static void CheckTreeQuery(const AABBTree &tree, const std::map<id_t, TreeTestEntry> &entries, T test, Q query) {
+    std::vector<id_t> found;
+    query([&found] (id_t entity_id) { found.push_back(entity_id); });
+    std::sort(found.begin(), found.end());
+    std::vector<id_t> expected;
+    for(const auto &entry : entries) {
+        if(test(tree.GetFatBox(entry.second.proxy))) {
+            expected.push_back(entry.first);
+        }
+        if(test(entry.second.box)) {
+            EXPECT_TRUE(std::binary_search(found.begin(), found.end(), entry.first)) << "missed " << entry.first;
+        }
+    }
+    EXPECT_EQ(expected, found);
+}
+
+static void CheckTreeRay(const AABBTree &tree, const std::map<id_t, TreeTestEntry> &entries,
+        const glm::vec3 &origin, const glm::vec3 &direction, float max_distance) {
+    const glm::vec3 inv_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    std::vector<std::pair<id_t, float>> expected;
+    float closest = max_distance;
+    for(const auto &entry : entries) {
+        float distance;
+        if(tree.GetFatBox(entry.second.proxy).IntersectRay(origin, inv_direction, max_distance, distance)) {
+            expected.push_back(std::make_pair(entry.first, distance));
+            closest = std::min(closest, distance);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // keep going to get every hit
+    std::vector<std::pair<id_t, float>> found;
+    tree.RayCast(origin, direction, max_distance, [&found, max_distance] (id_t entity_id, float distance) {
+        found.push_back(std::make_pair(entity_id, distance));
+        return max_distance;
+    });
+    std::sort(found.begin(), found.end());
+    EXPECT_EQ(expected, found);
+
+    // only look for closer hits, the last one is the closest
+    float nearest = max_distance;
+    bool hit = false;
+    tree.RayCast(origin, direction, max_distance, [&nearest, &hit] (id_t, float distance) {
+        hit = true;
+        nearest = std::min(nearest, distance);
+        return nearest;
+    });
+    EXPECT_EQ(!expected.empty(), hit);
+    if(hit) {
+        EXPECT_EQ(closest, nearest);
+    }
+}
+
+TEST(AABBTreeTest, RandomChangesMatchBruteForce) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> operation(0, 9);
+    AABBTree tree(0.25f);
+    std::map<id_t, TreeTestEntry> entries;
+    id_t next_entity = 1;
+
+    for(size_t step = 0; step < 3000; step++) {
+        const int op = entries.size() < 8 ? 0 : operation(rng);
+        if(op < 4) {
+            TreeTestEntry entry;
+            entry.box = TreeTestBox(rng, 50.0f);
+            entry.proxy = tree.CreateProxy(entry.box, next_entity);
+            entries[next_entity++] = entry;
+        }
+        else {
+            auto it = entries.begin();
+            std::advance(it, std::uniform_int_distribution<size_t>(0, entries.size() - 1)(rng));
+            if(op < 8) {
+                // small moves stay in the enlarged box, the others do not
+                const float reach = op < 6 ? 0.1f : 10.0f;
+                const glm::vec3 offset(reach * unit(rng), reach * unit(rng), reach * unit(rng));
+                const AABB moved(it->second.box.min + offset, it->second.box.max + offset);
+                const bool inside = tree.GetFatBox(it->second.proxy).Contains(moved);
+                EXPECT_EQ(!inside, tree.MoveProxy(it->second.proxy, moved));
+                EXPECT_TRUE(tree.GetFatBox(it->second.proxy).Contains(moved));
+                it->second.box = moved;
+            }
+            else {
+                tree.DestroyProxy(it->second.proxy);
+                entries.erase(it);
+            }
+        }
+        ASSERT_EQ(entries.size(), tree.Size());
+
+        if(step % 50 != 49) {
+            continue;
+        }
+        for(const auto &entry : entries) {
+            ASSERT_EQ(entry.first, tree.GetEntity(entry.second.proxy));
+        }
+        // a balanced tree of 2n - 1 nodes stays within the AVL bound of 1.44 log2
+        EXPECT_GE(1.44f * std::log2(2.0f * entries.size() + 1.0f), tree.GetHeight());
+
+        const AABB box = TreeTestBox(rng, 50.0f);
+        const AABB large(box.min, box.max + glm::vec3(15.0f));
+        for(const AABB &query : {box, large}) {
+            CheckTreeQuery(tree, entries, [&query] (const AABB &b) { return b.Overlaps(query); },
+                [&tree, &query] (std::function<void(id_t)> func) { tree.QueryBox(query, func); });
+        }
+        const glm::vec3 center(50.0f * unit(rng), 50.0f * unit(rng), 50.0f * unit(rng));
+        for(float radius : {0.5f, 12.0f}) {
+            CheckTreeQuery(tree, entries, [&center, radius] (const AABB &b) { return b.OverlapsSphere(center, radius); },
+                [&tree, &center, radius] (std::function<void(id_t)> func) { tree.QuerySphere(center, radius, func); });
+        }
+        const glm::vec3 origin(60.0f * unit(rng), 60.0f * unit(rng), 60.0f * unit(rng));
+        const glm::vec3 target(20.0f * unit(rng), 20.0f * unit(rng), 20.0f * unit(rng));
+        CheckTreeRay(tree, entries, origin, glm::normalize(target - origin), 200.0f);
+        // along an axis, with the other components of the inverse direction infinite
+        CheckTreeRay(tree, entries, glm::vec3(origin.x, origin.y, -60.0f), glm::vec3(0.0f, 0.0f, 1.0f), 200.0f);
+    }
+
+    while(!entries.empty()) {
+        tree.DestroyProxy(entries.begin()->second.proxy);
+        entries.erase(entries.begin());
+    }
+    EXPECT_EQ(0u, tree.Size());
+    EXPECT_EQ(0, tree.GetHeight());
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef ANIMATION_CLIP_TEST_HPP_INCLUDED
+#define ANIMATION_CLIP_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "graphics/animation-clip.hpp"
+
+namespace trillek {
+namespace graphics {
+
+// the largest difference between two sets of matrices, in their first columns
+static float ClipMatrixError(const glm::mat4 *a, const glm::mat4 *b, size_t count, unsigned int columns = 4) {
+    float error = 0.0f;
+    for(size_t i = 0; i < count; i++) {
+        for(unsigned int c = 0; c < columns; c++) {
+            for(unsigned int r = 0; r < 4; r++) {
+                error = std::max(error, std::abs(a[i][c][r] - b[i][c][r]));
+            }
+        }
+    }
+    return error;
+}
+
+// Rotations that are hard to pack: the largest component negative, in each
+// place, and components close to or on the 1/sqrt(2) boundary of the others.
+static std::vector<glm::quat> ClipTestRotations() {
+    const float half = 0.70710678f;
+    std::vector<glm::quat> rotations;
+    rotations.push_back(glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+    rotations.push_back(glm::quat(-1.0f, 0.0f, 0.0f, 0.0f));
+    rotations.push_back(glm::quat(0.0f, -1.0f, 0.0f, 0.0f));
+    rotations.push_back(glm::quat(0.0f, 0.0f, -1.0f, 0.0f));
+    rotations.push_back(glm::quat(0.0f, 0.0f, 0.0f, -1.0f));
+    rotations.push_back(glm::quat(half, half, 0.0f, 0.0f));
+    rotations.push_back(glm::quat(-half, half, 0.0f, 0.0f));
+    rotations.push_back(glm::quat(0.0f, -half, 0.0f, -half));
+    rotations.push_back(glm::normalize(glm::quat(0.0f, half, -0.7071f, 0.0f)));
+    rotations.push_back(glm::normalize(glm::quat(0.0f, 0.0f, -0.70712f, 0.70710f)));
+    rotations.push_back(glm::quat(0.5f, 0.5f, 0.5f, 0.5f));
+    rotations.push_back(glm::quat(-0.5f, -0.5f, 0.5f, -0.5f));
+    rotations.push_back(glm::normalize(glm::quat(0.2f, 0.1f, -0.9f, 0.3f)));
+    rotations.push_back(glm::normalize(glm::quat(-0.3f, 0.6f, -0.6f, 0.4f)));
+    return rotations;
+}
+
+TEST(AnimationClipTest, RotationRoundTrip) {
+    // one bone per rotation, moving to the next rotation on the second frame,
+    // enough bones to go through the groups of 4 and the tracks left after
+    const std::vector<glm::quat> rotations = ClipTestRotations();
+    const size_t bone_count = rotations.size();
+    std::vector<glm::mat4> matrices;
+    for(size_t frame = 0; frame < 2; frame++) {
+        for(size_t bone = 0; bone < bone_count; bone++) {
+            const glm::quat &rotation = rotations[(bone + frame) % bone_count];
+            matrices.push_back(glm::translate(glm::vec3(0.5f * bone, -1.0f * frame, 2.0f)) *
+                glm::mat4_cast(rotation));
+        }
+    }
+    const AnimationClip clip(bone_count, 24.0f, matrices);
+    ASSERT_EQ(2u, clip.GetFrameCount());
+    ASSERT_EQ(bone_count, clip.GetTrackCount());
+
+    std::vector<glm::mat4> sampled(bone_count);
+    for(size_t frame = 0; frame < 2; frame++) {
+        clip.Sample(frame, frame, 0.0f, sampled.data());
+        EXPECT_GT(1e-4f, ClipMatrixError(&matrices[frame * bone_count], sampled.data(), bone_count, 3));
+    }
+}
+
+TEST(AnimationClipTest, BlendTakesTheShortestPath) {
+    // q and -q are the same rotation, the blend must not go through the identity
+    const glm::quat rotation = glm::angleAxis(0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+    std::vector<glm::mat4> matrices;
+    matrices.push_back(glm::mat4_cast(rotation));
+    matrices.push_back(glm::mat4_cast(-glm::angleAxis(0.6f, glm::vec3(0.0f, 1.0f, 0.0f))));
+    const AnimationClip clip(1, 24.0f, matrices);
+    glm::mat4 sampled;
+    clip.Sample(0, 1, 0.5f, &sampled);
+    const glm::mat4 expected = glm::mat4_cast(glm::angleAxis(0.55f, glm::vec3(0.0f, 1.0f, 0.0f)));
+    EXPECT_GT(1e-3f, ClipMatrixError(&expected, &sampled, 1));
+}
+
+TEST(AnimationClipTest, ChainRoundTrip) {
+    // A chain hanging from a walking root, with the inverse bind pose baked
+    // in. The bones after the root only keep their rotation.
+    const size_t bone_count = 6;
+    const size_t frame_count = 30;
+    std::vector<glm::mat4> matrices;
+    for(size_t frame = 0; frame < frame_count; frame++) {
+        glm::mat4 joint = glm::translate(glm::vec3(0.05f * frame, 1.0f, 0.0f));
+        for(size_t bone = 0; bone < bone_count; bone++) {
+            if(bone) {
+                joint = joint * glm::translate(glm::vec3(0.0f, 0.5f, 0.1f * bone));
+            }
+            joint = joint * glm::mat4_cast(glm::angleAxis(0.03f * frame * (bone + 1), glm::vec3(1.0f, 0.0f, 0.0f)));
+            const glm::mat4 inverse_bind = glm::translate(glm::vec3(0.0f, -0.5f * bone - 1.0f, -0.2f));
+            matrices.push_back(joint * inverse_bind);
+        }
+    }
+    const AnimationClip clip(bone_count, 24.0f, matrices);
+    EXPECT_EQ(bone_count - 1, clip.GetPinnedCount());
+
+    std::vector<glm::mat4> sampled(bone_count);
+    for(size_t frame = 0; frame < frame_count; frame++) {
+        clip.Sample(frame, frame, 0.0f, sampled.data());
+        EXPECT_GT(1e-3f, ClipMatrixError(&matrices[frame * bone_count], sampled.data(), bone_count));
+    }
+}
+
+TEST(AnimationClipTest, StillBonesAreKept) {
+    const glm::mat4 still = glm::translate(glm::vec3(1.0f, 2.0f, 3.0f)) *
+        glm::mat4_cast(glm::normalize(glm::quat(-0.7f, 0.1f, 0.7f, 0.0f)));
+    std::vector<glm::mat4> matrices;
+    for(size_t frame = 0; frame < 4; frame++) {
+        matrices.push_back(still);
+        matrices.push_back(glm::mat4_cast(glm::angleAxis(0.1f * frame, glm::vec3(0.0f, 0.0f, 1.0f))));
+    }
+    const AnimationClip clip(2, 24.0f, matrices);
+    EXPECT_EQ(1u, clip.GetTrackCount());
+    glm::mat4 sampled[2];
+    clip.Sample(3, 0, 0.25f, sampled);
+    EXPECT_EQ(0.0f, ClipMatrixError(&still, &sampled[0], 1));
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef DRAW_LIST_TEST_HPP_INCLUDED
+#define DRAW_LIST_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "graphics/draw-list.hpp"
+
+namespace trillek {
+namespace graphics {
+
+static DrawPacket DrawListTestPacket(id_t entity_id, uint64_t sort_key) {
+    DrawPacket packet = DrawPacket();
+    packet.entity_id = entity_id;
+    packet.sort_key = sort_key;
+    packet.vao = 1;
+    packet.ibo = 1;
+    packet.ibo_count = 36;
+    return packet;
+}
+
+// sort the keys with the draw list and with std::stable_sort, the entity ids tell the packets apart
+static void CheckDrawListSort(const std::vector<uint64_t> &keys) {
+    DrawList list;
+    std::vector<DrawPacket> expected;
+    for(size_t i = 0; i < keys.size(); i++) {
+        list.Add(DrawListTestPacket(static_cast<id_t>(i + 1), keys[i]));
+        expected.push_back(DrawListTestPacket(static_cast<id_t>(i + 1), keys[i]));
+    }
+    list.Sort();
+    std::stable_sort(expected.begin(), expected.end(), [] (const DrawPacket &a, const DrawPacket &b) {
+        return a.sort_key < b.sort_key;
+    });
+    ASSERT_EQ(expected.size(), list.Size());
+    for(size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(expected[i].sort_key, list[i].sort_key) << "at " << i;
+        ASSERT_EQ(expected[i].entity_id, list[i].entity_id) << "at " << i;
+    }
+}
+
+TEST(DrawListTest, SortMatchesStableSort) {
+    std::mt19937_64 rng(1234);
+    std::vector<uint64_t> keys;
+    for(size_t i = 0; i < 1000; i++) {
+        keys.push_back(rng());
+    }
+    CheckDrawListSort(keys);
+}
+
+TEST(DrawListTest, SortSkipsUniformBytes) {
+    // only the depth changes, then only the mesh, then a single high byte,
+    // with few values so that equal keys keep their order
+    std::mt19937_64 rng(99);
+    const uint64_t base = DrawList::MakeKey(3, 17, 5, 200, 0);
+    std::vector<uint64_t> depths, meshes, high;
+    for(size_t i = 0; i < 500; i++) {
+        depths.push_back(base | (rng() % 64) << DrawList::DEPTH_SHIFT);
+        meshes.push_back(DrawList::MakeKey(3, 17, 5, static_cast<uint32_t>(rng() % 8), 1000));
+        high.push_back(base | (rng() % 4) << 56);
+    }
+    CheckDrawListSort(depths);
+    CheckDrawListSort(meshes);
+    CheckDrawListSort(high);
+    CheckDrawListSort(std::vector<uint64_t>(100, base));
+    CheckDrawListSort(std::vector<uint64_t>(1, base));
+    CheckDrawListSort(std::vector<uint64_t>());
+}
+
+TEST(DrawListTest, MakeKeyMasksEachField) {
+    // a value too wide for its field must not spill into the next one
+    const uint64_t pass = DrawList::MakeKey((1u << DrawList::PASS_BITS) | 1, 0, 0, 0, 0);
+    EXPECT_EQ(1ull << DrawList::PASS_SHIFT, pass);
+    const uint64_t shader = DrawList::MakeKey(0, (1u << DrawList::SHADER_BITS) | 2, 0, 0, 0);
+    EXPECT_EQ(2ull << DrawList::SHADER_SHIFT, shader);
+    const uint64_t texture = DrawList::MakeKey(0, 0, (1u << DrawList::TEXTURE_BITS) | 3, 0, 0);
+    EXPECT_EQ(3ull << DrawList::TEXTURE_SHIFT, texture);
+    const uint64_t mesh = DrawList::MakeKey(0, 0, 0, (1u << DrawList::MESH_BITS) | 4, 0);
+    EXPECT_EQ(4ull << DrawList::MESH_SHIFT, mesh);
+    const uint64_t depth = DrawList::MakeKey(0, 0, 0, 0, (1u << DrawList::DEPTH_BITS) | 5);
+    EXPECT_EQ(5ull << DrawList::DEPTH_SHIFT, depth);
+    // all the fields at their largest fill the 64 bits
+    EXPECT_EQ(~DrawList::LEVEL_MASK, DrawList::MakeKey(~0u, ~0u, ~0u, ~0u, ~0u));
+
+    DrawPacket packet = DrawListTestPacket(1, DrawList::MakeKey(1, 2, 3, 4, 0));
+    DrawList::SetDepth(packet, (1u << DrawList::DEPTH_BITS) | 6);
+    EXPECT_EQ(DrawList::MakeKey(1, 2, 3, 4, 6), packet.sort_key);
+    EXPECT_EQ((1u << DrawList::DEPTH_BITS) - 1, DrawList::QuantizeDepth(2000.0f, 1000.0f));
+    EXPECT_EQ(0u, DrawList::QuantizeDepth(-1.0f, 1000.0f));
+}
+
+TEST(DrawListTest, BatchesSplitOnWhatIsDrawn) {
+    // every packet has the same key, only what it draws tells them apart
+    const uint64_t key = DrawList::MakeKey(0, 1, 1, 1, 0);
+    std::vector<DrawPacket> packets(9, DrawListTestPacket(1, key));
+    packets[2].vao = 2;
+    packets[3].ibo = 2;
+    packets[4].ibo_first = 36;
+    packets[5].ibo_count = 12;
+    packets[6].material_index = 1;
+    packets[7].texture_set = 1;
+    DrawList list;
+    for(size_t i = 0; i < packets.size(); i++) {
+        packets[i].entity_id = static_cast<id_t>(i + 1);
+        packets[i].sort_key |= i;
+        list.Add(packets[i]);
+    }
+    list.Sort();
+    std::vector<uint8_t> visible(list.Size(), 1);
+    DrawPass pass;
+    const uint32_t instances = list.BuildBatches(visible.data(), 10, pass);
+
+    // only packets 0 and 1 share a batch, 8 matches them but comes after the others
+    ASSERT_EQ(8u, pass.batches.size());
+    EXPECT_EQ(0u, pass.batches[0].first_packet);
+    EXPECT_EQ(2u, pass.batches[0].packet_count);
+    EXPECT_EQ(10u, pass.batches[0].instance_offset);
+    for(size_t b = 1; b < pass.batches.size(); b++) {
+        EXPECT_EQ(b + 1, pass.batches[b].first_packet);
+        EXPECT_EQ(1u, pass.batches[b].packet_count);
+        EXPECT_EQ(12u, pass.batches[b].instance_offset);
+    }
+    EXPECT_EQ(2u, instances);
+
+    // the hidden packets are left out and do not split a batch
+    std::fill(visible.begin(), visible.end(), 0);
+    visible[0] = visible[1] = 1;
+    list.BuildBatches(visible.data(), 0, pass);
+    ASSERT_EQ(1u, pass.batches.size());
+    EXPECT_EQ(2u, pass.batches[0].packet_count);
+}
+
+TEST(DrawListTest, BatchesSplitOnKeyAndAnimation) {
+    DrawList list;
+    DrawPacket packet = DrawListTestPacket(1, DrawList::MakeKey(0, 1, 1, 1, 0));
+    list.Add(packet);
+    packet.entity_id = 2;
+    list.Add(packet);
+    // another mesh field, then an animated packet
+    packet.entity_id = 3;
+    packet.sort_key = DrawList::MakeKey(0, 1, 1, 2, 0);
+    list.Add(packet);
+    packet.entity_id = 4;
+    packet.sort_key = DrawList::MakeKey(0, 1, 1, 2, 1);
+    packet.animation = reinterpret_cast<Animation*>(&packet);
+    list.Add(packet);
+    list.Sort();
+    std::vector<uint8_t> visible(list.Size(), 1);
+    DrawPass pass;
+    EXPECT_EQ(2u, list.BuildBatches(visible.data(), 0, pass));
+    ASSERT_EQ(3u, pass.batches.size());
+    EXPECT_EQ(2u, pass.batches[0].packet_count);
+    EXPECT_EQ(1u, pass.batches[1].packet_count);
+    EXPECT_EQ(1u, pass.batches[2].packet_count);
+}
+
+TEST(DrawListTest, RemovalsAreDroppedTogether) {
+    DrawList list;
+    for(id_t entity_id = 1; entity_id <= 6; entity_id++) {
+        list.Add(DrawListTestPacket(entity_id, entity_id));
+        list.Add(DrawListTestPacket(entity_id, entity_id + 10));
+    }
+    list.Remove(2);
+    list.Remove(5);
+    list.Remove(2);
+    // an entity given new packets keeps them, only the ones it had go
+    list.Remove(4);
+    list.Add(DrawListTestPacket(4, 20));
+    list.Remove(7);
+    EXPECT_EQ(13u, list.Size());
+    EXPECT_EQ(6u, list.Compact());
+    EXPECT_EQ(0u, list.Compact());
+
+    const id_t expected[] = {1, 1, 3, 3, 6, 6, 4};
+    ASSERT_EQ(7u, list.Size());
+    for(size_t i = 0; i < list.Size(); i++) {
+        EXPECT_EQ(expected[i], list[i].entity_id) << "at " << i;
+    }
+    EXPECT_EQ(20u, list[6].sort_key);
+
+    // Sort drops them too
+    list.Remove(1);
+    list.Sort();
+    ASSERT_EQ(5u, list.Size());
+    EXPECT_EQ(3u, list[0].sort_key);
+    EXPECT_EQ(4u, list[4].entity_id);
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef JOB_FANOUT_TEST_HPP_INCLUDED
+#define JOB_FANOUT_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <vector>
+#include "graphics/job-fanout.hpp"
+
+namespace trillek {
+namespace graphics {
+
+static void JobTestCount(const void *context, size_t part) {
+    static_cast<std::atomic<size_t>*>(const_cast<void*>(context))[part]++;
+}
+
+TEST(JobFanoutTest, PoolRunsEveryPartOnce) {
+    for(size_t thread_count : {0, 1, 3}) {
+        JobPool pool(thread_count);
+        EXPECT_EQ(thread_count + 1, pool.Threads());
+        std::vector<std::atomic<size_t>> parts(37);
+        for(unsigned int call = 0; call < 20; call++) {
+            pool.Run(&JobTestCount, parts.data(), parts.size());
+        }
+        for(const auto &part : parts) {
+            EXPECT_EQ(20u, part.load());
+        }
+    }
+}
+
+TEST(JobFanoutTest, SizeIsFixedOnceStarted) {
+    JobPool::Get();
+    EXPECT_FALSE(JobPool::SetThreadCount(2));
+    EXPECT_FALSE(JobPool::ReserveThreads(2));
+
+    std::vector<size_t> seen(1000, 0);
+    JobFanout::ForRanges(seen.size(), 10, [&seen] (size_t first, size_t last) {
+        for(size_t i = first; i < last; i++) {
+            seen[i]++;
+        }
+    });
+    for(size_t count : seen) {
+        ASSERT_EQ(1u, count);
+    }
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef LIGHT_GRID_TEST_HPP_INCLUDED
+#define LIGHT_GRID_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <set>
+#include <vector>
+#include "graphics/light-grid.hpp"
+
+namespace trillek {
+namespace graphics {
+
+static GridLight GridTestLight(const glm::vec3 &position, float radius) {
+    GridLight light;
+    light.position = position;
+    light.radius = radius;
+    light.color = glm::vec3(1.0f);
+    light.direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    light.type = 0;
+    return light;
+}
+
+// the view space box of a cluster, from its 8 corners
+static void GridTestClusterBox(const glm::mat4 &projection, float near_plane, float far_plane,
+        uint32_t x, uint32_t y, uint32_t z, glm::vec3 &min, glm::vec3 &max) {
+    const float slices = static_cast<float>(LightGrid::CLUSTER_Z);
+    float depths[2] = {
+        near_plane * std::pow(far_plane / near_plane, z / slices),
+        near_plane * std::pow(far_plane / near_plane, (z + 1) / slices)
+    };
+    // the first and last slices also hold what is before and past them
+    if(z == 0) {
+        depths[0] = 0.0f;
+    }
+    if(z == LightGrid::CLUSTER_Z - 1) {
+        depths[1] = std::numeric_limits<float>::infinity();
+    }
+    const uint32_t tiles[2] = { LightGrid::CLUSTER_X, LightGrid::CLUSTER_Y };
+    const uint32_t cell[2] = { x, y };
+    for(unsigned int axis = 0; axis < 2; axis++) {
+        float ndc[2] = { 2.0f * cell[axis] / tiles[axis] - 1.0f, 2.0f * (cell[axis] + 1) / tiles[axis] - 1.0f };
+        // the tiles at the side also hold what is past the screen
+        if(cell[axis] == 0) {
+            ndc[0] = -std::numeric_limits<float>::infinity();
+        }
+        if(cell[axis] == tiles[axis] - 1) {
+            ndc[1] = std::numeric_limits<float>::infinity();
+        }
+        min[axis] = std::numeric_limits<float>::infinity();
+        max[axis] = -std::numeric_limits<float>::infinity();
+        for(float side : ndc) {
+            for(float depth : depths) {
+                // 0 times infinity, the corner at the eye
+                const float value = depth == 0.0f ? 0.0f : side * depth / projection[axis][axis];
+                min[axis] = std::min(min[axis], value);
+                max[axis] = std::max(max[axis], value);
+            }
+        }
+    }
+    min.z = -depths[1];
+    max.z = -depths[0];
+}
+
+static bool GridTestSphereInBox(const GridLight &light, const glm::vec3 &min, const glm::vec3 &max) {
+    float distance = 0.0f;
+    for(unsigned int axis = 0; axis < 3; axis++) {
+        const float nearest = std::min(std::max(light.position[axis], min[axis]), max[axis]);
+        distance += (nearest - light.position[axis]) * (nearest - light.position[axis]);
+    }
+    return distance <= light.radius * light.radius;
+}
+
+static bool GridTestListed(const LightGrid &grid, uint32_t x, uint32_t y, uint32_t z, uint32_t light) {
+    const uint32_t *cluster = grid.GetCluster(x, y, z);
+    for(uint32_t i = cluster[0]; i < cluster[0] + cluster[1]; i++) {
+        if(grid.GetLightIndex(i) == light) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TEST(LightGridTest, ClustersMatchBruteForce) {
+    const float near_plane = 0.1f, far_plane = 1000.0f;
+    const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, near_plane, far_plane);
+    std::vector<GridLight> lights;
+    lights.push_back(GridTestLight(glm::vec3(0.0f, 0.0f, -10.0f), 2.0f));
+    // straddling the near plane, partly behind the eye
+    lights.push_back(GridTestLight(glm::vec3(0.05f, 0.02f, -near_plane), 0.3f));
+    // partly past the right and top of the screen
+    lights.push_back(GridTestLight(glm::vec3(12.0f, 6.0f, -15.0f), 4.0f));
+    // behind the eye and past the far plane, left out
+    lights.push_back(GridTestLight(glm::vec3(0.0f, 0.0f, 5.0f), 1.0f));
+    lights.push_back(GridTestLight(glm::vec3(0.0f, 0.0f, -1100.0f), 10.0f));
+    lights.push_back(GridTestLight(glm::vec3(0.0f), std::numeric_limits<float>::infinity()));
+    // straddling the far plane
+    lights.push_back(GridTestLight(glm::vec3(-30.0f, 10.0f, -995.0f), 20.0f));
+    // the index of each light kept by the grid
+    const uint32_t kept[] = { 0, 1, 2, 5, 6 };
+    const size_t kept_count = sizeof(kept) / sizeof(kept[0]);
+
+    LightGrid grid;
+    grid.Build(lights, projection, near_plane, far_plane);
+    ASSERT_EQ(kept_count, grid.GetLightCount());
+
+    // the ranges follow each other through the index list
+    size_t next = 0;
+    for(uint32_t z = 0; z < LightGrid::CLUSTER_Z; z++) {
+        for(uint32_t y = 0; y < LightGrid::CLUSTER_Y; y++) {
+            for(uint32_t x = 0; x < LightGrid::CLUSTER_X; x++) {
+                const uint32_t *cluster = grid.GetCluster(x, y, z);
+                ASSERT_EQ(next, cluster[0]);
+                next += cluster[1];
+            }
+        }
+    }
+    ASSERT_EQ(next, grid.GetIndexCount());
+
+    // every point of a light in view reaches the cluster it falls in
+    const float depth_scale = LightGrid::CLUSTER_Z / std::log(far_plane / near_plane);
+    const int steps = 40;
+    for(uint32_t l = 0; l < kept_count; l++) {
+        const GridLight &light = lights[kept[l]];
+        if(!std::isfinite(light.radius)) {
+            for(uint32_t z = 0; z < LightGrid::CLUSTER_Z; z++) {
+                for(uint32_t y = 0; y < LightGrid::CLUSTER_Y; y++) {
+                    for(uint32_t x = 0; x < LightGrid::CLUSTER_X; x++) {
+                        EXPECT_TRUE(GridTestListed(grid, x, y, z, l));
+                    }
+                }
+            }
+            continue;
+        }
+        size_t visible = 0;
+        for(int i = 0; i <= steps; i++) {
+            for(int j = 0; j <= steps; j++) {
+                for(int k = 0; k <= steps; k++) {
+                    const glm::vec3 offset = (glm::vec3(i, j, k) * (2.0f / steps) - glm::vec3(1.0f)) * light.radius;
+                    if(glm::dot(offset, offset) > light.radius * light.radius) {
+                        continue;
+                    }
+                    const glm::vec3 point = light.position + offset;
+                    const float depth = -point.z;
+                    const float ndc_x = projection[0][0] * point.x / depth;
+                    const float ndc_y = projection[1][1] * point.y / depth;
+                    if(depth < near_plane || depth > far_plane || std::abs(ndc_x) > 1.0f || std::abs(ndc_y) > 1.0f) {
+                        continue;
+                    }
+                    visible++;
+                    const uint32_t x = std::min(static_cast<uint32_t>((ndc_x * 0.5f + 0.5f) * LightGrid::CLUSTER_X),
+                        LightGrid::CLUSTER_X - 1);
+                    const uint32_t y = std::min(static_cast<uint32_t>((ndc_y * 0.5f + 0.5f) * LightGrid::CLUSTER_Y),
+                        LightGrid::CLUSTER_Y - 1);
+                    const uint32_t z = std::min(static_cast<uint32_t>(std::log(depth / near_plane) * depth_scale),
+                        LightGrid::CLUSTER_Z - 1);
+                    ASSERT_TRUE(GridTestListed(grid, x, y, z, l)) << "light " << kept[l]
+                        << " missing from cluster " << x << ", " << y << ", " << z;
+                }
+            }
+        }
+        EXPECT_LT(0u, visible) << "light " << kept[l];
+    }
+
+    // A light is only listed by clusters whose box reaches its box. The
+    // tiles of each slice are a rectangle, only its corners may miss the sphere.
+    size_t finite_count = 0, corner_count = 0;
+    for(uint32_t z = 0; z < LightGrid::CLUSTER_Z; z++) {
+        for(uint32_t y = 0; y < LightGrid::CLUSTER_Y; y++) {
+            for(uint32_t x = 0; x < LightGrid::CLUSTER_X; x++) {
+                const uint32_t *cluster = grid.GetCluster(x, y, z);
+                std::set<uint32_t> listed;
+                for(uint32_t i = cluster[0]; i < cluster[0] + cluster[1]; i++) {
+                    ASSERT_GT(kept_count, grid.GetLightIndex(i));
+                    EXPECT_TRUE(listed.insert(grid.GetLightIndex(i)).second) << "a light listed twice";
+                }
+                glm::vec3 min, max;
+                GridTestClusterBox(projection, near_plane, far_plane, x, y, z, min, max);
+                for(uint32_t l : listed) {
+                    const GridLight &light = lights[kept[l]];
+                    if(!std::isfinite(light.radius)) {
+                        continue;
+                    }
+                    finite_count++;
+                    const glm::vec3 reach(light.radius);
+                    const bool boxes = light.position.x - reach.x <= max.x && min.x <= light.position.x + reach.x
+                        && light.position.y - reach.y <= max.y && min.y <= light.position.y + reach.y
+                        && light.position.z - reach.z <= max.z && min.z <= light.position.z + reach.z;
+                    EXPECT_TRUE(boxes) << "light " << kept[l] << " listed by cluster " << x << ", " << y << ", " << z;
+                    corner_count += !GridTestSphereInBox(light, min, max);
+                }
+            }
+        }
+    }
+    EXPECT_LT(0u, finite_count);
+    EXPECT_GE(finite_count / 20, corner_count);
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
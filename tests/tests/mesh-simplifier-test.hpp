@@ -0,0 +1,155 @@
+#ifndef MESH_SIMPLIFIER_TEST_HPP_INCLUDED
+#define MESH_SIMPLIFIER_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <utility>
+#include <vector>
+#include "graphics/mesh-simplifier.hpp"
+
+namespace trillek {
+namespace graphics {
+
+// a bumpy open grid of size x size vertices, two triangles per cell
+static void MeshTestGrid(size_t size, std::vector<glm::vec3> &positions, std::vector<unsigned int> &indices) {
+    positions.clear();
+    indices.clear();
+    for(size_t y = 0; y < size; y++) {
+        for(size_t x = 0; x < size; x++) {
+            const float fx = 8.0f * x / (size - 1), fy = 8.0f * y / (size - 1);
+            positions.push_back(glm::vec3(fx, fy, 0.3f * std::sin(fx) * std::cos(0.7f * fy)));
+        }
+    }
+    for(size_t y = 0; y + 1 < size; y++) {
+        for(size_t x = 0; x + 1 < size; x++) {
+            const unsigned int v = static_cast<unsigned int>(y * size + x);
+            const unsigned int s = static_cast<unsigned int>(size);
+            const unsigned int cell[6] = {v, v + 1, v + s + 1, v, v + s + 1, v + s};
+            indices.insert(indices.end(), cell, cell + 6);
+        }
+    }
+}
+
+// the edges used by a single triangle
+static std::set<std::pair<unsigned int, unsigned int>> MeshTestOpenEdges(const unsigned int *indices, size_t count) {
+    std::multiset<std::pair<unsigned int, unsigned int>> edges;
+    for(size_t t = 0; t < count; t += 3) {
+        for(unsigned int k = 0; k < 3; k++) {
+            const unsigned int a = indices[t + k], b = indices[t + (k + 1) % 3];
+            edges.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+        }
+    }
+    std::set<std::pair<unsigned int, unsigned int>> open;
+    for(const auto &edge : edges) {
+        if(edges.count(edge) == 1) {
+            open.insert(edge);
+        }
+    }
+    return open;
+}
+
+static float MeshTestSegmentDistance(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &b) {
+    const glm::vec3 ab = b - a;
+    const float t = std::min(1.0f, std::max(0.0f, glm::dot(p - a, ab) / glm::dot(ab, ab)));
+    return glm::length(p - (a + ab * t));
+}
+
+// the distance of a point to the nearest of the triangles, by projecting on each plane
+static float MeshTestSurfaceDistance(const glm::vec3 &p, const std::vector<glm::vec3> &positions,
+        const unsigned int *indices, size_t count) {
+    float nearest = INFINITY;
+    for(size_t t = 0; t < count; t += 3) {
+        const glm::vec3 &a = positions[indices[t]], &b = positions[indices[t + 1]], &c = positions[indices[t + 2]];
+        const glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+        const glm::vec3 projected = p - normal * glm::dot(p - a, normal);
+        const bool inside = glm::dot(glm::cross(b - a, projected - a), normal) >= 0.0f
+            && glm::dot(glm::cross(c - b, projected - b), normal) >= 0.0f
+            && glm::dot(glm::cross(a - c, projected - c), normal) >= 0.0f;
+        float distance = std::min(MeshTestSegmentDistance(p, a, b),
+            std::min(MeshTestSegmentDistance(p, b, c), MeshTestSegmentDistance(p, c, a)));
+        if(inside) {
+            distance = std::min(distance, glm::length(p - projected));
+        }
+        nearest = std::min(nearest, distance);
+    }
+    return nearest;
+}
+
+TEST(MeshSimplifierTest, LevelsFollowTheMesh) {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    MeshTestGrid(17, positions, indices);
+    const std::vector<unsigned int> full(indices);
+    const std::vector<MeshLevel> levels = MeshSimplifier::BuildLevels(positions, indices, 1.0f);
+    ASSERT_LE(2u, levels.size());
+    ASSERT_GE(MeshSimplifier::MAX_LEVELS, levels.size());
+
+    // the full mesh first, then each level right after the one before
+    EXPECT_EQ(0u, levels[0].first_index);
+    EXPECT_EQ(full.size(), levels[0].index_count);
+    EXPECT_EQ(0.0f, levels[0].error);
+    EXPECT_TRUE(std::equal(full.begin(), full.end(), indices.begin()));
+    for(size_t l = 1; l < levels.size(); l++) {
+        EXPECT_EQ(levels[l - 1].first_index + levels[l - 1].index_count, levels[l].first_index);
+        EXPECT_EQ(0u, levels[l].index_count % 3);
+        EXPECT_LT(levels[l].index_count, levels[l - 1].index_count);
+        EXPECT_LE(levels[l - 1].error, levels[l].error);
+    }
+    EXPECT_EQ(indices.size(), levels.back().first_index + levels.back().index_count);
+    for(unsigned int index : indices) {
+        ASSERT_GT(positions.size(), index);
+    }
+
+    // the chain only goes on from levels that are not too coarse
+    for(size_t l = 0; l + 1 < levels.size(); l++) {
+        EXPECT_LE(MeshSimplifier::LEVEL_MIN_TRIANGLES, levels[l].index_count / 3);
+    }
+    if(levels.size() < MeshSimplifier::MAX_LEVELS) {
+        EXPECT_GT(MeshSimplifier::LEVEL_MIN_TRIANGLES, levels.back().index_count / 3);
+    }
+
+    // no vertex of the full mesh is further from a level than its error says
+    for(size_t l = 1; l < levels.size(); l++) {
+        float worst = 0.0f;
+        for(const glm::vec3 &position : positions) {
+            worst = std::max(worst, MeshTestSurfaceDistance(position, positions,
+                &indices[levels[l].first_index], levels[l].index_count));
+        }
+        EXPECT_GT(worst, 0.0f);
+        EXPECT_LE(worst, levels[l].error * 1.0001f + 1e-6f) << "level " << l;
+    }
+}
+
+TEST(MeshSimplifierTest, OpenEdgesAreKept) {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    MeshTestGrid(17, positions, indices);
+    const std::set<std::pair<unsigned int, unsigned int>> outline =
+        MeshTestOpenEdges(indices.data(), indices.size());
+    ASSERT_EQ(MeshSimplifier::MAX_LEVELS * 16u, outline.size());
+    const std::vector<MeshLevel> levels = MeshSimplifier::BuildLevels(positions, indices, 1.0f);
+    ASSERT_LE(2u, levels.size());
+    for(size_t l = 1; l < levels.size(); l++) {
+        EXPECT_EQ(outline, MeshTestOpenEdges(&indices[levels[l].first_index], levels[l].index_count)) << "level " << l;
+    }
+}
+
+TEST(MeshSimplifierTest, SmallMeshesHaveOneLevel) {
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    // 3 x 3 cells, fewer triangles than a level may have
+    MeshTestGrid(4, positions, indices);
+    ASSERT_GT(MeshSimplifier::LEVEL_MIN_TRIANGLES, indices.size() / 3);
+    const std::vector<MeshLevel> levels = MeshSimplifier::BuildLevels(positions, indices, 1.0f);
+    ASSERT_EQ(1u, levels.size());
+    EXPECT_EQ(indices.size(), levels[0].index_count);
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
@@ -0,0 +1,173 @@
+#ifndef POSE_CACHE_TEST_HPP_INCLUDED
+#define POSE_CACHE_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include "graphics/animation-clip.hpp"
+#include "graphics/pose-cache.hpp"
+
+namespace trillek {
+namespace graphics {
+
+// bone_count matrices per frame, every bone turning at its own pace
+static std::vector<glm::mat4> PoseTestFrames(size_t bone_count, size_t frame_count, float scale) {
+    std::vector<glm::mat4> matrices;
+    for(size_t frame = 0; frame < frame_count; frame++) {
+        for(size_t bone = 0; bone < bone_count; bone++) {
+            matrices.push_back(glm::translate(glm::vec3(scale * bone, 1.0f * frame, 0.0f)) *
+                glm::mat4_cast(glm::angleAxis(0.1f * scale * frame * (bone + 1), glm::vec3(1.0f, 0.0f, 0.0f))));
+        }
+    }
+    return matrices;
+}
+
+static bool SamePose(const glm::mat4 *a, const glm::mat4 *b, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        for(unsigned int c = 0; c < 4; c++) {
+            for(unsigned int r = 0; r < 4; r++) {
+                if(a[i][c][r] != b[i][c][r]) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+TEST(PoseCacheTest, FreedClipAddressIsNotReused) {
+    // a clip built where a freed one was must not get the poses of the freed one
+    std::aligned_storage<sizeof(AnimationClip), alignof(AnimationClip)>::type storage;
+    PoseCache cache;
+    AnimationClip *freed = new(&storage) AnimationClip(2, 24.0f, PoseTestFrames(2, 3, 1.0f));
+    cache.Clear();
+    cache.Request(*freed, 0, 0.0f);
+    cache.Evaluate(1);
+    freed->~AnimationClip();
+
+    AnimationClip *clip = new(&storage) AnimationClip(5, 24.0f, PoseTestFrames(5, 3, 2.0f));
+    ASSERT_EQ(static_cast<void*>(freed), static_cast<void*>(clip));
+    cache.Clear();
+    const uint32_t request = cache.Request(*clip, 0, 0.0f);
+    cache.Evaluate(1);
+    const uint32_t pose = cache.GetPose(request);
+    ASSERT_EQ(5u, cache.GetBoneCount(pose));
+    std::vector<glm::mat4> expected(5);
+    clip->Sample(0, 1, 0.0f, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(pose), 5));
+    clip->~AnimationClip();
+}
+
+TEST(PoseCacheTest, SameRequestsShareAPose) {
+    const AnimationClip a(3, 24.0f, PoseTestFrames(3, 4, 1.0f));
+    const AnimationClip b(3, 24.0f, PoseTestFrames(3, 4, 1.5f));
+    PoseCache cache;
+    cache.Clear();
+    const uint32_t first = cache.Request(a, 1, 0.25f);
+    const uint32_t other_clip = cache.Request(b, 1, 0.25f);
+    const uint32_t same = cache.Request(a, 1, 0.25f);
+    // 0.26 of a frame rounds to the same step as 0.25
+    const uint32_t same_step = cache.Request(a, 1, 0.26f);
+    const uint32_t other_frame = cache.Request(a, 2, 0.25f);
+    const uint32_t other_step = cache.Request(a, 1, 0.5f);
+    cache.Evaluate(1);
+    ASSERT_EQ(6u, cache.GetRequestCount());
+    EXPECT_EQ(4u, cache.Size());
+
+    const uint32_t pose = cache.GetPose(first);
+    EXPECT_EQ(pose, cache.GetPose(same));
+    EXPECT_EQ(pose, cache.GetPose(same_step));
+    EXPECT_NE(pose, cache.GetPose(other_clip));
+    EXPECT_NE(pose, cache.GetPose(other_frame));
+    EXPECT_NE(pose, cache.GetPose(other_step));
+    EXPECT_EQ(PoseCache::NO_POSE, cache.GetPose(6));
+
+    std::vector<glm::mat4> expected(3);
+    a.Sample(1, 2, 0.25f, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(pose), 3));
+    b.Sample(1, 2, 0.25f, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(cache.GetPose(other_clip)), 3));
+    a.Sample(1, 2, 0.5f, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(cache.GetPose(other_step)), 3));
+}
+
+TEST(PoseCacheTest, LastStepRoundsToTheNextFrame) {
+    const AnimationClip clip(2, 24.0f, PoseTestFrames(2, 4, 1.0f));
+    PoseCache cache;
+    cache.Clear();
+    // 0.95 of a frame is step 8, the next frame, and from the last frame the first one
+    const uint32_t rounded = cache.Request(clip, 1, 0.95f);
+    const uint32_t next = cache.Request(clip, 2, 0.0f);
+    const uint32_t wrapped = cache.Request(clip, 3, 0.97f);
+    const uint32_t start = cache.Request(clip, 0, 0.0f);
+    // 0.93 stays on step 7 of its frame, and a negative blend is step 0
+    const uint32_t last_step = cache.Request(clip, 1, 0.93f);
+    const uint32_t negative = cache.Request(clip, 1, -0.2f);
+    const uint32_t frame = cache.Request(clip, 1, 0.0f);
+    cache.Evaluate(1);
+    EXPECT_EQ(cache.GetPose(next), cache.GetPose(rounded));
+    EXPECT_EQ(cache.GetPose(start), cache.GetPose(wrapped));
+    EXPECT_EQ(cache.GetPose(frame), cache.GetPose(negative));
+    EXPECT_NE(cache.GetPose(next), cache.GetPose(last_step));
+    EXPECT_NE(cache.GetPose(frame), cache.GetPose(last_step));
+    EXPECT_EQ(4u, cache.Size());
+
+    std::vector<glm::mat4> expected(2);
+    clip.Sample(0, 1, 0.0f, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(cache.GetPose(wrapped)), 2));
+    clip.Sample(1, 2, 7.0f / PoseCache::STEPS_PER_FRAME, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(cache.GetPose(last_step)), 2));
+}
+
+TEST(PoseCacheTest, PreviousPosesAreCopied) {
+    const AnimationClip clip(4, 24.0f, PoseTestFrames(4, 6, 1.0f));
+    const AnimationClip small(2, 24.0f, PoseTestFrames(2, 6, 2.0f));
+    PoseCache cache;
+    cache.Clear();
+    cache.Request(clip, 0, 0.0f);
+    cache.Request(small, 1, 0.5f);
+    cache.Request(clip, 2, 0.5f);
+    cache.Evaluate(1);
+    EXPECT_EQ(0u, cache.GetCopiedCount());
+
+    // two of the poses again, in another order and around a new one
+    cache.Clear();
+    const uint32_t fresh = cache.Request(clip, 1, 0.0f);
+    const uint32_t kept = cache.Request(clip, 2, 0.5f);
+    const uint32_t kept_small = cache.Request(small, 1, 0.5f);
+    cache.Evaluate(1);
+    EXPECT_EQ(3u, cache.Size());
+    EXPECT_EQ(2u, cache.GetCopiedCount());
+    std::vector<glm::mat4> expected(4);
+    clip.Sample(2, 3, 0.5f, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(cache.GetPose(kept)), 4));
+    small.Sample(1, 2, 0.5f, expected.data());
+    ASSERT_EQ(2u, cache.GetBoneCount(cache.GetPose(kept_small)));
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(cache.GetPose(kept_small)), 2));
+    clip.Sample(1, 2, 0.0f, expected.data());
+    EXPECT_TRUE(SamePose(expected.data(), cache.GetMatrices(cache.GetPose(fresh)), 4));
+
+    // the same frame again is copied whole, a frame with nothing does not keep the poses
+    cache.Clear();
+    cache.Request(clip, 1, 0.0f);
+    cache.Request(clip, 2, 0.5f);
+    cache.Request(small, 1, 0.5f);
+    cache.Evaluate(1);
+    EXPECT_EQ(3u, cache.GetCopiedCount());
+    cache.Clear();
+    cache.Evaluate(1);
+    EXPECT_EQ(0u, cache.Size());
+    cache.Clear();
+    cache.Request(clip, 1, 0.0f);
+    cache.Evaluate(1);
+    EXPECT_EQ(0u, cache.GetCopiedCount());
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif
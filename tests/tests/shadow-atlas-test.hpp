@@ -0,0 +1,116 @@
+#ifndef SHADOW_ATLAS_TEST_HPP_INCLUDED
+#define SHADOW_ATLAS_TEST_HPP_INCLUDED
+
+#include "gtest/gtest.h"
+
+#include <glm/glm.hpp>
+#include <random>
+#include <vector>
+#include "graphics/shadow-atlas.hpp"
+
+namespace trillek {
+namespace graphics {
+
+// the tiles stay inside the atlas, do not overlap, and a light never gets
+// a smaller tile than a less important one
+static void CheckAtlasTiles(const std::vector<float> &importance, const std::vector<glm::vec4> &tiles) {
+    ASSERT_EQ(importance.size(), tiles.size());
+    for(size_t i = 0; i < tiles.size(); i++) {
+        const glm::vec4 &a = tiles[i];
+        if(a.z == 0.0f) {
+            continue;
+        }
+        EXPECT_LE(0.0f, a.x);
+        EXPECT_LE(0.0f, a.y);
+        EXPECT_GE(1.0f, a.x + a.z) << "tile " << i;
+        EXPECT_GE(1.0f, a.y + a.z) << "tile " << i;
+        EXPECT_LE(1.0f / (1u << ShadowAtlas::MAX_LEVEL), a.z);
+        for(size_t j = 0; j < tiles.size(); j++) {
+            const glm::vec4 &b = tiles[j];
+            if(importance[j] < importance[i]) {
+                EXPECT_LE(b.z, a.z) << "tiles " << i << " and " << j;
+            }
+            if(j <= i || b.z == 0.0f) {
+                continue;
+            }
+            const bool apart = a.x + a.z <= b.x || b.x + b.z <= a.x || a.y + a.z <= b.y || b.y + b.z <= a.y;
+            EXPECT_TRUE(apart) << "tiles " << i << " and " << j;
+        }
+    }
+}
+
+TEST(ShadowAtlasTest, TilesFollowTheImportance) {
+    std::vector<glm::vec4> tiles;
+    ShadowAtlas::Allocate(std::vector<float>(1, 1.0f), tiles);
+    ASSERT_EQ(1u, tiles.size());
+    EXPECT_EQ(0.0f, tiles[0].x);
+    EXPECT_EQ(0.0f, tiles[0].y);
+    EXPECT_EQ(1.0f, tiles[0].z);
+
+    const std::vector<float> importance = {0.3f, 1.0f, 0.05f, 0.5f, 0.001f};
+    ShadowAtlas::Allocate(importance, tiles);
+    CheckAtlasTiles(importance, tiles);
+    // the whole atlas and two halves do not fit, so the largest is shrunk
+    EXPECT_EQ(0.5f, tiles[1].z);
+    EXPECT_EQ(0.5f, tiles[3].z);
+    EXPECT_EQ(0.5f, tiles[0].z);
+    EXPECT_EQ(1.0f / 16.0f, tiles[2].z);
+    EXPECT_EQ(1.0f / 16.0f, tiles[4].z);
+
+    ShadowAtlas::Allocate(std::vector<float>(), tiles);
+    EXPECT_TRUE(tiles.empty());
+}
+
+TEST(ShadowAtlasTest, TilesShrinkPastTheCapacity) {
+    std::vector<glm::vec4> tiles;
+    for(size_t count = 1; count <= 17; count++) {
+        const std::vector<float> importance(count, 1.0f);
+        ShadowAtlas::Allocate(importance, tiles);
+        CheckAtlasTiles(importance, tiles);
+        // the largest side that fits count tiles
+        float side = 1.0f;
+        while(count * side * side > 1.0f) {
+            side *= 0.5f;
+        }
+        for(const glm::vec4 &tile : tiles) {
+            EXPECT_EQ(side, tile.z) << count << " lights";
+        }
+    }
+
+    // past the smallest tiles the least important lights get none
+    const size_t capacity = 1u << (2 * ShadowAtlas::MAX_LEVEL);
+    std::vector<float> importance;
+    for(size_t i = 0; i < capacity + 10; i++) {
+        importance.push_back(1.0f - 0.001f * i);
+    }
+    ShadowAtlas::Allocate(importance, tiles);
+    CheckAtlasTiles(importance, tiles);
+    for(size_t i = 0; i < tiles.size(); i++) {
+        EXPECT_EQ(i < capacity ? 1.0f / (1u << ShadowAtlas::MAX_LEVEL) : 0.0f, tiles[i].z) << "light " << i;
+    }
+}
+
+TEST(ShadowAtlasTest, RandomLightsDoNotOverlap) {
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> value(0.0f, 1.0f);
+    std::uniform_int_distribution<size_t> count(1, 40);
+    std::vector<glm::vec4> tiles;
+    for(size_t run = 0; run < 200; run++) {
+        std::vector<float> importance(count(rng));
+        for(float &i : importance) {
+            // mostly small, some close to 1
+            i = value(rng);
+            i = i * i * i;
+        }
+        ShadowAtlas::Allocate(importance, tiles);
+        CheckAtlasTiles(importance, tiles);
+        for(const glm::vec4 &tile : tiles) {
+            ASSERT_LT(0.0f, tile.z);
+        }
+    }
+}
+
+} // namespace graphics
+} // namespace trillek
+
+#endif